@@ -1,28 +1,62 @@
-
 import os
+import subprocess
+import tempfile
+
+# Size the distance fields are made at. The UI scales them to whatever size it
+# needs at runtime, a bigger bake only keeps sharper corners
+FONT_SIZE = 32
+ICONS = ["play", "pause", "back", "forward", "repeat", "repeat_one", "delete", "go_back"]
 
 output_file = """
 // Created with bundle.py"""
 
-def replace_all(string, allowed, replacement):
-    res = ""
-    for i in string:
-        if i in allowed: res += i
-        else: res += replacement
-    return res
+# Octal escapes, as short as they get. Every byte is escaped so a digit never runs into the previous one
+def c_string(data, line_length=4096):
+    lines = []
+    for i in range(0, len(data), line_length):
+        lines.append('"' + "".join(f"\\{b:o}" for b in data[i:i + line_length]) + '"')
+    return "\n".join(lines)
+
+def bake(cc, output):
+    icons = [f"assets/{i}.png" for i in ICONS]
+    with tempfile.TemporaryDirectory() as tmp:
+        baker = os.path.join(tmp, "bake")
+        subprocess.run([cc, "-O2", "-std=gnu99", "-I./raylib/src", "src/bake.c", "-lm", "-o", baker], check=True)
+        meta = subprocess.run([baker, str(FONT_SIZE), output, "assets/font.ttf", "assets/icon.png"] + icons, check=True, capture_output=True, text=True).stdout
+    return [line.split() for line in meta.splitlines()]
 
 if __name__ == "__main__":
     if not os.path.isdir("assets"): exit(1)
-    files = os.listdir("assets")
-    output_file += "\n// Bundled files: " + ", ".join(files) + "\n\n"
-    for i in files:
-        print(f"Bundling {i}")
-        name = replace_all(i.upper(), "ABCDEFGHIJKLMNOPQRSTUVWXYZ", "_")
-        f = open(f"assets/{i}", "rb").read()
-        output_file += f"const unsigned long _{name}_LENGTH = {len(f)};\n"
-        output_file += f"char _{name}[] = " + "{ "
-        for b in f:
-            output_file += f"0x{hex(b)[2:].upper():0>2}, "
-        output_file += "};\n\n"
+    with tempfile.TemporaryDirectory() as tmp:
+        blob_path = os.path.join(tmp, "assets.bin")
+        print(f"Baking the distance field atlas at {FONT_SIZE}px")
+        meta = bake(os.environ.get("CC", "gcc"), blob_path)
+        blob = open(blob_path, "rb").read()
+
+    atlas = [int(i) for i in meta[0][1:]]
+    glyphs = [line[1:] for line in meta if line[0] == "glyph"]
+    icons = [line[1:] for line in meta if line[0] == "icon"]
+
+    output_file += "\n// Baked from: " + ", ".join(sorted(os.listdir("assets"))) + "\n\n"
+    output_file += f"#define ASSETS_FONT_SIZE {FONT_SIZE}\n"
+    output_file += f"#define ASSETS_ATLAS_WIDTH {atlas[0]}\n"
+    output_file += f"#define ASSETS_ATLAS_HEIGHT {atlas[1]}\n"
+    output_file += f"#define ASSETS_GLYPH_PADDING {atlas[2]}\n"
+    output_file += f"#define ASSETS_GLYPH_COUNT {len(glyphs)}\n"
+    output_file += "#define ASSETS_WINDOW_ICON_SIZE 64\n\n"
+
+    output_file += "// codepoint, offset x, offset y, advance x, then the rect in the atlas\n"
+    output_file += "const int _ASSETS_GLYPHS[ASSETS_GLYPH_COUNT][8] = {\n"
+    for g in glyphs:
+        output_file += "    { " + ", ".join(g) + " },\n"
+    output_file += "};\n\n"
+
+    output_file += "// x, y and size in the atlas\n"
+    for name, icon in zip(ICONS, icons):
+        output_file += f"const int _ASSETS_ICON_{name.upper()}[3] = {{ {', '.join(icon)} }};\n"
+
+    output_file += "\n// The single channel distance field atlas, followed by the RGBA window icon\n"
+    output_file += f"const unsigned long _ASSETS_DATA_LENGTH = {len(blob)};\n"
+    output_file += "const unsigned char _ASSETS_DATA[] =\n" + c_string(blob) + ";\n"
 
     open("src/assets.h", "w").write(output_file)
@@ -0,0 +1,427 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+/**
+ * Generates a reproducible corpus of mp3 files with varied ID3v2 tags to
+ * benchmark the parser against. The same seed always produces the same bytes.
+ *
+ * Usage: gen_corpus <output dir> [-n files] [-s seed]
+ *
+ * Every tag gets a random mix of:
+ *   - ID3v2.3 or ID3v2.4
+ *   - Latin-1 and UTF-16 (with BOM) text frames
+ *   - a handful to a few hundred frames (TXXX, COMM and PRIV like taggers write them)
+ *   - no cover, or an APIC frame from a few KB up to a couple MB
+ *   - an extended header
+ *   - padding
+ *   - unsynchronisation (the whole tag in v2.3, every frame in v2.4)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define ENCODING_LATIN1 0
+#define ENCODING_UTF16 1
+
+typedef struct
+{
+    unsigned char* data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+static uint64_t rng_state;
+
+static uint64_t rng_next()
+{
+    // splitmix64
+    uint64_t z = (rng_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static int rng_range(const int min, const int max)
+{
+    return min + (int) (rng_next() % (uint64_t) (max - min + 1));
+}
+
+static int rng_chance(const int percent)
+{
+    return rng_range(0, 99) < percent;
+}
+
+static void buffer_reserve(Buffer* buffer, const size_t size)
+{
+    if (buffer->size + size <= buffer->capacity) return;
+    while (buffer->size + size > buffer->capacity)
+    {
+        buffer->capacity = buffer->capacity == 0 ? 4096 : buffer->capacity * 2;
+    }
+    buffer->data = (unsigned char*) realloc(buffer->data, buffer->capacity);
+}
+
+static void buffer_write(Buffer* buffer, const void* data, const size_t size)
+{
+    buffer_reserve(buffer, size);
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+static void buffer_putc(Buffer* buffer, const unsigned char c)
+{
+    buffer_write(buffer, &c, 1);
+}
+
+static void buffer_write_random(Buffer* buffer, const size_t size)
+{
+    buffer_reserve(buffer, size);
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer->data[buffer->size++] = (unsigned char) rng_next();
+    }
+}
+
+static void write_be32(unsigned char* dest, const uint32_t value)
+{
+    dest[0] = (value >> 24) & 0xFF;
+    dest[1] = (value >> 16) & 0xFF;
+    dest[2] = (value >> 8) & 0xFF;
+    dest[3] = value & 0xFF;
+}
+
+static void write_syncsafe(unsigned char* dest, const uint32_t value)
+{
+    dest[0] = (value >> 21) & 0x7F;
+    dest[1] = (value >> 14) & 0x7F;
+    dest[2] = (value >> 7) & 0x7F;
+    dest[3] = value & 0x7F;
+}
+
+/**
+ * Inserts a zero byte after every 0xFF that is followed by 0x00 or a byte
+ * looking like the start of an mpeg sync (0xE0 and up), or ends the data.
+ */
+static Buffer unsynchronise(const unsigned char* data, const size_t size)
+{
+    Buffer result = {0};
+    buffer_reserve(&result, size + size / 64 + 1);
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer_putc(&result, data[i]);
+        if (data[i] == 0xFF && (i + 1 == size || data[i + 1] == 0x00 || data[i + 1] >= 0xE0))
+        {
+            buffer_putc(&result, 0x00);
+        }
+    }
+    return result;
+}
+
+static void write_random_text(Buffer* buffer, const int encoding, const int length)
+{
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 -_.,'&()";
+
+    if (encoding == ENCODING_LATIN1)
+    {
+        for (int i = 0; i < length; i++)
+        {
+            // mostly ascii with the occasional accented latin-1 character
+            unsigned char c = rng_chance(90) ? alphabet[rng_range(0, sizeof(alphabet) - 2)]
+                                             : (unsigned char) rng_range(0xC0, 0xFF);
+            buffer_putc(buffer, c);
+        }
+        return;
+    }
+
+    buffer_putc(buffer, 0xFF);
+    buffer_putc(buffer, 0xFE);
+    for (int i = 0; i < length; i++)
+    {
+        // ascii mixed with cyrillic and cjk code points
+        uint16_t c;
+        int kind = rng_range(0, 9);
+        if (kind < 6) c = alphabet[rng_range(0, sizeof(alphabet) - 2)];
+        else if (kind < 9) c = (uint16_t) rng_range(0x410, 0x44F);
+        else c = (uint16_t) rng_range(0x4E00, 0x9FFF);
+        buffer_putc(buffer, c & 0xFF);
+        buffer_putc(buffer, c >> 8);
+    }
+}
+
+static void write_terminator(Buffer* buffer, const int encoding)
+{
+    buffer_putc(buffer, 0x00);
+    if (encoding == ENCODING_UTF16) buffer_putc(buffer, 0x00);
+}
+
+static int random_encoding()
+{
+    return rng_chance(50) ? ENCODING_UTF16 : ENCODING_LATIN1;
+}
+
+static void write_frame(
+    Buffer* tag,
+    const int version,
+    const int unsync,
+    const char* id,
+    const Buffer* payload
+)
+{
+    unsigned char header[10];
+    Buffer unsynced = {0};
+    const unsigned char* data = payload->data;
+    size_t size = payload->size;
+
+    if (version == 4 && unsync)
+    {
+        unsynced = unsynchronise(payload->data, payload->size);
+        data = unsynced.data;
+        size = unsynced.size;
+    }
+
+    memcpy(header, id, 4);
+    if (version == 4) write_syncsafe(header + 4, size);
+    else write_be32(header + 4, size);
+    header[8] = 0x00;
+    header[9] = version == 4 && unsync ? 0x02 : 0x00;
+
+    buffer_write(tag, header, sizeof(header));
+    buffer_write(tag, data, size);
+    free(unsynced.data);
+}
+
+static void write_text_frame(Buffer* tag, const int version, const int unsync, const char* id)
+{
+    Buffer payload = {0};
+    int encoding = random_encoding();
+    buffer_putc(&payload, encoding);
+    write_random_text(&payload, encoding, rng_range(1, 48));
+    if (rng_chance(70)) write_terminator(&payload, encoding);
+    write_frame(tag, version, unsync, id, &payload);
+    free(payload.data);
+}
+
+static void write_number_frame(
+    Buffer* tag,
+    const int version,
+    const int unsync,
+    const char* id,
+    const int number
+)
+{
+    Buffer payload = {0};
+    char text[16];
+    snprintf(text, sizeof(text), "%d", number);
+    buffer_putc(&payload, ENCODING_LATIN1);
+    buffer_write(&payload, text, strlen(text));
+    write_frame(tag, version, unsync, id, &payload);
+    free(payload.data);
+}
+
+static void write_txxx_frame(Buffer* tag, const int version, const int unsync)
+{
+    Buffer payload = {0};
+    int encoding = random_encoding();
+    buffer_putc(&payload, encoding);
+    write_random_text(&payload, encoding, rng_range(4, 24));
+    write_terminator(&payload, encoding);
+    write_random_text(&payload, encoding, rng_range(1, 64));
+    write_frame(tag, version, unsync, "TXXX", &payload);
+    free(payload.data);
+}
+
+static void write_comm_frame(Buffer* tag, const int version, const int unsync)
+{
+    Buffer payload = {0};
+    int encoding = random_encoding();
+    buffer_putc(&payload, encoding);
+    buffer_write(&payload, "eng", 3);
+    write_random_text(&payload, encoding, rng_range(0, 12));
+    write_terminator(&payload, encoding);
+    write_random_text(&payload, encoding, rng_range(1, 200));
+    write_frame(tag, version, unsync, "COMM", &payload);
+    free(payload.data);
+}
+
+static void write_priv_frame(Buffer* tag, const int version, const int unsync)
+{
+    static const char* owners[] = {"WM/MediaClassPrimaryID", "WM/Provider", "PeakValue", "AverageLevel"};
+    Buffer payload = {0};
+    const char* owner = owners[rng_range(0, 3)];
+    buffer_write(&payload, owner, strlen(owner) + 1);
+    buffer_write_random(&payload, rng_range(4, 512));
+    write_frame(tag, version, unsync, "PRIV", &payload);
+    free(payload.data);
+}
+
+static void write_apic_frame(Buffer* tag, const int version, const int unsync, const size_t size)
+{
+    static const unsigned char jpeg_start[] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F'};
+    Buffer payload = {0};
+    buffer_putc(&payload, ENCODING_LATIN1);
+    buffer_write(&payload, "image/jpeg", strlen("image/jpeg") + 1);
+    buffer_putc(&payload, 0x03); // front cover
+    buffer_putc(&payload, 0x00); // empty description
+    buffer_write(&payload, jpeg_start, sizeof(jpeg_start));
+    buffer_write_random(&payload, size);
+    write_frame(tag, version, unsync, "APIC", &payload);
+    free(payload.data);
+}
+
+static size_t random_cover_size()
+{
+    int kind = rng_range(0, 99);
+    if (kind < 25) return 0;
+    if (kind < 60) return rng_range(8, 64) * 1024;
+    if (kind < 90) return rng_range(128, 512) * 1024;
+    return rng_range(1024, 3072) * 1024;
+}
+
+static Buffer generate_file(const int index)
+{
+    const int version = rng_chance(50) ? 4 : 3;
+    const int unsync = rng_chance(15);
+    const int extended_header = rng_chance(15);
+    const int padding = rng_chance(70) ? rng_range(0, 8192) : 0;
+
+    Buffer body = {0};
+
+    if (extended_header)
+    {
+        unsigned char eh[10] = {0};
+        if (version == 4)
+        {
+            write_syncsafe(eh, 6); // size includes itself, one flag byte, no flags set
+            eh[4] = 0x01;
+            buffer_write(&body, eh, 6);
+        }
+        else
+        {
+            write_be32(eh, 6); // size excludes itself: flags and padding size follow
+            write_be32(eh + 6, padding);
+            buffer_write(&body, eh, 10);
+        }
+    }
+
+    write_text_frame(&body, version, unsync, "TIT2");
+    write_text_frame(&body, version, unsync, "TPE1");
+    write_text_frame(&body, version, unsync, "TALB");
+    if (rng_chance(60)) write_text_frame(&body, version, unsync, "TPE2");
+    if (rng_chance(80)) write_text_frame(&body, version, unsync, "TCON");
+    write_number_frame(&body, version, unsync, "TRCK", index % 20 + 1);
+    write_number_frame(&body, version, unsync, version == 4 ? "TDRC" : "TYER", rng_range(1960, 2024));
+    if (rng_chance(30)) write_number_frame(&body, version, unsync, "TPOS", rng_range(1, 4));
+
+    // Some taggers leave hundreds of these behind
+    int extra = rng_chance(20) ? rng_range(50, 400) : rng_range(0, 12);
+    for (int i = 0; i < extra; i++)
+    {
+        switch (rng_range(0, 2))
+        {
+            case 0:
+                write_txxx_frame(&body, version, unsync);
+                break;
+            case 1:
+                write_comm_frame(&body, version, unsync);
+                break;
+            default:
+                write_priv_frame(&body, version, unsync);
+                break;
+        }
+    }
+
+    size_t cover_size = random_cover_size();
+    if (cover_size > 0) write_apic_frame(&body, version, unsync, cover_size);
+
+    if (version == 3 && unsync)
+    {
+        Buffer unsynced = unsynchronise(body.data, body.size);
+        free(body.data);
+        body = unsynced;
+    }
+
+    buffer_reserve(&body, padding);
+    memset(body.data + body.size, 0, padding);
+    body.size += padding;
+
+    unsigned char header[10] = {'I', 'D', '3', version, 0, 0};
+    header[5] = (unsync ? 0x80 : 0x00) | (extended_header ? 0x40 : 0x00);
+    write_syncsafe(header + 6, body.size);
+
+    Buffer file = {0};
+    buffer_write(&file, header, sizeof(header));
+    buffer_write(&file, body.data, body.size);
+    free(body.data);
+
+    // A few silent mpeg frames so players and sniffers accept the file
+    static const unsigned char mpeg_frame_header[] = {0xFF, 0xFB, 0x90, 0x64};
+    for (int i = 0; i < 8; i++)
+    {
+        buffer_write(&file, mpeg_frame_header, sizeof(mpeg_frame_header));
+        buffer_reserve(&file, 413);
+        memset(file.data + file.size, 0, 413);
+        file.size += 413;
+    }
+
+    return file;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* dir = NULL;
+    int count = 1000;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+        else dir = argv[i];
+    }
+
+    if (dir == NULL || count < 1)
+    {
+        fprintf(stderr, "Usage: %s <output dir> [-n files] [-s seed]\n", argv[0]);
+        return 1;
+    }
+
+    mkdir(dir, 0755);
+    rng_state = seed;
+
+    size_t total = 0;
+    char path[4096];
+
+    for (int i = 0; i < count; i++)
+    {
+        Buffer file = generate_file(i);
+        snprintf(path, sizeof(path), "%s/%05d.mp3", dir, i);
+
+        FILE* fp = fopen(path, "wb");
+        if (fp == NULL)
+        {
+            perror(path);
+            free(file.data);
+            return 1;
+        }
+        fwrite(file.data, 1, file.size, fp);
+        fclose(fp);
+
+        total += file.size;
+        free(file.data);
+    }
+
+    fprintf(stderr, "Generated %d files (%.1f MB) in %s\n", count, total / (1024.0 * 1024.0), dir);
+    return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+/**
+ * Measures tag parsing over a folder of mp3 files (see gen_corpus.c) and
+ * prints the results as JSON on stdout:
+ *   - read_tag: ID3v2_read_tag on every file, includes the file I/O
+ *   - read_tag_from_buffer: ID3v2_read_tag_from_buffer on tags already in memory
+ *   - read_tag_view: ID3v2_read_tag_view on every file, includes the file I/O
+ *   - read_tag_view_from_buffer: ID3v2_read_tag_view_from_buffer on tags already in memory
+ *
+ * For each it reports files/s, MB/s of tag data, parse latency percentiles and
+ * the number of allocations and bytes allocated per tag. Allocations are
+ * counted by linking with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see
+ * the bench target in the Makefile), so allocations done inside libc itself,
+ * like the FILE buffers of fopen, are not included.
+ *
+ * Usage: tag_bench <corpus dir> [-n iterations]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "id3v2lib.h"
+
+typedef struct
+{
+    char* path;
+    char* tag;       // the whole tag, header included
+    size_t tag_size; // 0 if the file has no tag
+} CorpusFile;
+
+typedef struct
+{
+    double* samples;
+    size_t count;
+    double total;
+    size_t allocations;
+    size_t allocated_bytes;
+    size_t frames;
+} BenchResult;
+
+/**
+ * Allocation counters
+ */
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static int counting = 0;
+static size_t allocations = 0;
+static size_t allocated_bytes = 0;
+
+void* __wrap_malloc(size_t size)
+{
+    if (counting)
+    {
+        allocations++;
+        allocated_bytes += size;
+    }
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    if (counting)
+    {
+        allocations++;
+        allocated_bytes += count * size;
+    }
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    if (counting)
+    {
+        allocations++;
+        allocated_bytes += size;
+    }
+    return __real_realloc(ptr, size);
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_paths(const void* a, const void* b)
+{
+    return strcmp(((const CorpusFile*) a)->path, ((const CorpusFile*) b)->path);
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static int is_mp3(const char* name)
+{
+    size_t length = strlen(name);
+    return length > 4 && strcmp(name + length - 4, ".mp3") == 0;
+}
+
+static char* read_tag_bytes(const char* path, size_t* size)
+{
+    *size = 0;
+
+    ID3v2_TagHeader* header = ID3v2_read_tag_header(path);
+    if (header == NULL) return NULL;
+    size_t tag_size = header->tag_size + ID3v2_TAG_HEADER_LENGTH;
+    ID3v2_TagHeader_free(header);
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+
+    char* tag = (char*) malloc(tag_size);
+    if (fread(tag, 1, tag_size, file) != tag_size)
+    {
+        free(tag);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+
+    *size = tag_size;
+    return tag;
+}
+
+static CorpusFile* load_corpus(const char* dir, size_t* count)
+{
+    DIR* d = opendir(dir);
+    if (d == NULL) return NULL;
+
+    size_t capacity = 256;
+    CorpusFile* files = (CorpusFile*) malloc(capacity * sizeof(CorpusFile));
+    *count = 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        if (!is_mp3(entry->d_name)) continue;
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            files = (CorpusFile*) realloc(files, capacity * sizeof(CorpusFile));
+        }
+
+        CorpusFile* file = &files[(*count)++];
+        file->path = (char*) malloc(strlen(dir) + strlen(entry->d_name) + 2);
+        sprintf(file->path, "%s/%s", dir, entry->d_name);
+        file->tag = read_tag_bytes(file->path, &file->tag_size);
+    }
+    closedir(d);
+
+    // Same order on every run, whatever readdir returns
+    qsort(files, *count, sizeof(CorpusFile), compare_paths);
+    return files;
+}
+
+#define READ_TAG 0
+#define READ_TAG_FROM_BUFFER 1
+#define READ_TAG_VIEW 2
+#define READ_TAG_VIEW_FROM_BUFFER 3
+
+static BenchResult run(CorpusFile* files, const size_t count, const int iterations, const int reader)
+{
+    BenchResult result = {0};
+    result.samples = (double*) malloc(count * iterations * sizeof(double));
+
+    for (int i = 0; i < iterations; i++)
+    {
+        for (size_t j = 0; j < count; j++)
+        {
+            if (files[j].tag == NULL) continue;
+
+            allocations = allocated_bytes = 0;
+            counting = 1;
+            double start = now();
+            ID3v2_Tag* tag = NULL;
+            ID3v2_TagView* view = NULL;
+            switch (reader)
+            {
+                case READ_TAG:
+                    tag = ID3v2_read_tag(files[j].path);
+                    break;
+                case READ_TAG_FROM_BUFFER:
+                    tag = ID3v2_read_tag_from_buffer(files[j].tag, files[j].tag_size);
+                    break;
+                case READ_TAG_VIEW:
+                    view = ID3v2_read_tag_view(files[j].path);
+                    break;
+                default:
+                    view = ID3v2_read_tag_view_from_buffer(files[j].tag, files[j].tag_size);
+                    break;
+            }
+            double elapsed = now() - start;
+            counting = 0;
+
+            result.samples[result.count++] = elapsed;
+            result.total += elapsed;
+            result.allocations += allocations;
+            result.allocated_bytes += allocated_bytes;
+
+            if (tag != NULL)
+            {
+                if (i == 0) result.frames += tag->frames->count;
+                ID3v2_Tag_free(tag);
+            }
+
+            if (view != NULL)
+            {
+                if (i == 0) result.frames += view->frame_count;
+                ID3v2_TagView_free(view);
+            }
+        }
+    }
+
+    qsort(result.samples, result.count, sizeof(double), compare_doubles);
+    return result;
+}
+
+static double percentile(BenchResult* result, const double p)
+{
+    if (result->count == 0) return 0;
+    return result->samples[(size_t) (p * (result->count - 1) + 0.5)];
+}
+
+static void print_result(const char* name, BenchResult* result, const size_t bytes, const int iterations, const int last)
+{
+    double seconds = result->total;
+    size_t parses = result->count > 0 ? result->count : 1;
+
+    printf("  \"%s\": {\n", name);
+    printf("    \"seconds\": %.6f,\n", seconds / iterations);
+    printf("    \"files_per_sec\": %.1f,\n", seconds > 0 ? result->count / seconds : 0);
+    printf("    \"mb_per_sec\": %.3f,\n", seconds > 0 ? (double) bytes * iterations / seconds / (1024.0 * 1024.0) : 0);
+    printf("    \"frames\": %zu,\n", result->frames);
+    printf("    \"allocations_per_tag\": %.2f,\n", (double) result->allocations / parses);
+    printf("    \"allocated_bytes_per_tag\": %.0f,\n", (double) result->allocated_bytes / parses);
+    printf("    \"latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}\n",
+           seconds / parses * 1e6, percentile(result, 0.50) * 1e6, percentile(result, 0.90) * 1e6,
+           percentile(result, 0.99) * 1e6, percentile(result, 1.00) * 1e6);
+    printf("  }%s\n", last ? "" : ",");
+
+    free(result->samples);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* dir = NULL;
+    int iterations = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else dir = argv[i];
+    }
+
+    if (dir == NULL || iterations < 1)
+    {
+        fprintf(stderr, "Usage: %s <corpus dir> [-n iterations]\n", argv[0]);
+        return 1;
+    }
+
+    size_t count = 0;
+    CorpusFile* files = load_corpus(dir, &count);
+    if (files == NULL || count == 0)
+    {
+        fprintf(stderr, "No mp3 files in %s\n", dir);
+        free(files);
+        return 1;
+    }
+
+    size_t tags = 0, bytes = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (files[i].tag == NULL) continue;
+        tags++;
+        bytes += files[i].tag_size;
+    }
+
+    // One untimed pass so both runs start with a warm page cache
+    BenchResult warmup = run(files, count, 1, READ_TAG);
+    free(warmup.samples);
+
+    BenchResult from_file = run(files, count, iterations, READ_TAG);
+    BenchResult from_buffer = run(files, count, iterations, READ_TAG_FROM_BUFFER);
+    BenchResult view_from_file = run(files, count, iterations, READ_TAG_VIEW);
+    BenchResult view_from_buffer = run(files, count, iterations, READ_TAG_VIEW_FROM_BUFFER);
+
+    printf("{\n");
+    printf("  \"corpus\": \"%s\",\n", dir);
+    printf("  \"files\": %zu,\n", count);
+    printf("  \"tags\": %zu,\n", tags);
+    printf("  \"tag_bytes\": %zu,\n", bytes);
+    printf("  \"iterations\": %d,\n", iterations);
+    print_result("read_tag", &from_file, bytes, iterations, 0);
+    print_result("read_tag_from_buffer", &from_buffer, bytes, iterations, 0);
+    print_result("read_tag_view", &view_from_file, bytes, iterations, 0);
+    print_result("read_tag_view_from_buffer", &view_from_buffer, bytes, iterations, 1);
+    printf("}\n");
+
+    for (size_t i = 0; i < count; i++)
+    {
+        free(files[i].path);
+        free(files[i].tag);
+    }
+    free(files);
+
+    return 0;
+}
@@ -25,6 +25,7 @@ extern "C" {
 #include "modules/picture_types.h"
 #include "modules/tag_header.h"
 #include "modules/tag.h"
+#include "modules/tag_view.h"
 #include "modules/utils.h"
 
 ID3v2_TagHeader* ID3v2_read_tag_header(const char* file_name);
@@ -33,9 +34,20 @@ ID3v2_TagHeader* ID3v2_read_tag_header_from_buffer(const char* buffer);
 ID3v2_Tag* ID3v2_read_tag(const char* file_name);
 ID3v2_Tag* ID3v2_read_tag_from_buffer(const char* tag_buffer, const int buffer_size);
 
-void ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag);
+/**
+ * Reads the tag without copying frame payloads, see modules/tag_view.h. The
+ * file is opened once and big tags are mapped instead of read. A view read
+ * from a buffer points into it, so the buffer has to outlive the view.
+ */
+ID3v2_TagView* ID3v2_read_tag_view(const char* file_name);
+ID3v2_TagView* ID3v2_read_tag_view_from_buffer(const char* tag_buffer, const int buffer_size);
+
+/**
+ * Both return 0 on success and -1 if the file could not be written.
+ */
+int ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag);
 
-void ID3v2_delete_tag(const char* file_name);
+int ID3v2_delete_tag(const char* file_name);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -12,20 +12,46 @@
 
 typedef struct _ID3v2_Frame ID3v2_Frame;
 
+/**
+ * Frames in tag order, stored contiguously: frames[0] to frames[count - 1].
+ *
+ * Next to the frames the list keeps their ids packed into an unsigned int and
+ * a small hash index over them, so finding the first frame with a given id
+ * doesn't walk the list. The index is maintained by the library, only read
+ * frames and count.
+ */
 typedef struct _ID3v2_FrameList
 {
-    ID3v2_Frame* frame;
-    struct _ID3v2_FrameList* start;
-    struct _ID3v2_FrameList* next;
+    ID3v2_Frame** frames;
+    int count;
+    int capacity;
+
+    // Index, bucket_count is a power of two and never less than capacity
+    unsigned int* ids;
+    int* next;
+    int* bucket_heads;
+    int* bucket_tails;
+    int bucket_count;
 } ID3v2_FrameList;
 
 /**
- * Frees list nodes and the frames within.
+ * Returns the next frame matching frame_id after *position without
+ * allocating anything, NULL when there are no more. Start with *position set
+ * to -1, it is updated to the index of the returned frame.
+ */
+ID3v2_Frame* ID3v2_FrameList_next_by_id(
+    const ID3v2_FrameList* list,
+    const char* frame_id,
+    int* position
+);
+
+/**
+ * Frees the list and the frames within.
  */
 void ID3v2_FrameList_free(ID3v2_FrameList* list);
 
 /**
- * This only frees the list nodes leaving freeing the frames
+ * This only frees the list leaving freeing the frames
  * to the calling routine.
  */
 void ID3v2_FrameList_unlink(ID3v2_FrameList* list);
@@ -0,0 +1,73 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_view_h
+#define id3v2lib_tag_view_h
+
+#include "modules/frame_header.h"
+#include "modules/tag_header.h"
+
+typedef struct _ID3v2_TextFrame ID3v2_TextFrame;
+typedef struct _ID3v2_CommentFrame ID3v2_CommentFrame;
+typedef struct _ID3v2_ApicFrame ID3v2_ApicFrame;
+
+/**
+ * A read only look at a frame. data points straight into the tag bytes held
+ * by the ID3v2_TagView it came from (unsynchronisation already undone) and is
+ * only valid for as long as that view is alive. It is not null terminated.
+ */
+typedef struct _ID3v2_FrameView
+{
+    char id[ID3v2_FRAME_HEADER_ID_LENGTH];
+    char flags[ID3v2_FRAME_HEADER_FLAGS_LENGTH];
+    int size;
+    const char* data;
+} ID3v2_FrameView;
+
+/**
+ * A tag read without copying any frame payload. Reading one costs a fixed
+ * handful of allocations no matter how many frames or how big the pictures
+ * are, frames are only turned into ID3v2_TextFrame and friends on request.
+ */
+typedef struct _ID3v2_TagView
+{
+    ID3v2_TagHeader header;
+    ID3v2_FrameView* frames;
+    int frame_count;
+    int padding_size;
+
+    // The tag bytes, either mapped from the file or owned by the view
+    char* buffer;
+    int buffer_size;
+    int buffer_kind;
+} ID3v2_TagView;
+
+void ID3v2_TagView_free(ID3v2_TagView* view);
+
+/**
+ * Returns the first frame with the provided id, NULL if there is none.
+ */
+const ID3v2_FrameView* ID3v2_TagView_get_frame(const ID3v2_TagView* view, const char* frame_id);
+
+/**
+ * These copy the frame out of the tag. The result has to be freed with
+ * ID3v2_Frame_free and outlives the view. They return NULL if the frame is
+ * not of the requested kind.
+ */
+ID3v2_TextFrame* ID3v2_FrameView_to_text_frame(const ID3v2_FrameView* frame);
+ID3v2_CommentFrame* ID3v2_FrameView_to_comment_frame(const ID3v2_FrameView* frame);
+ID3v2_ApicFrame* ID3v2_FrameView_to_apic_frame(const ID3v2_FrameView* frame);
+
+/**
+ * Returns the picture bytes of an APIC frame without copying them, NULL if
+ * the frame is not an APIC frame.
+ */
+const char* ID3v2_FrameView_get_picture(const ID3v2_FrameView* frame, int* picture_size);
+
+#endif
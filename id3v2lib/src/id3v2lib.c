@@ -7,18 +7,36 @@
  * file that was distributed with this source code.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE // copy_file_range
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "modules/char_stream.private.h"
 #include "modules/frame.private.h"
 #include "modules/frame_list.private.h"
 #include "modules/tag.private.h"
 #include "modules/tag_header.private.h"
+#include "modules/tag_view.private.h"
 #include "modules/utils.private.h"
 
 #include "id3v2lib.h"
 
+#define COPY_BUFFER_LENGTH (1024 * 1024)
+
 ID3v2_TagHeader* ID3v2_read_tag_header(const char* file_name)
 {
     FILE* fp = fopen(file_name, "rb");
@@ -44,122 +62,338 @@ ID3v2_TagHeader* ID3v2_read_tag_header_from_buffer(const char* buffer)
 
 ID3v2_Tag* ID3v2_read_tag(const char* file_name)
 {
-    ID3v2_TagHeader* tag_header = ID3v2_read_tag_header(file_name);
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL) return NULL;
 
-    if (tag_header == NULL) return NULL;
+    char tag_header_buffer[ID3v2_TAG_HEADER_LENGTH];
+    const int bytes_read = fread(tag_header_buffer, sizeof(char), ID3v2_TAG_HEADER_LENGTH, file);
+    ID3v2_TagHeader* tag_header =
+        bytes_read == ID3v2_TAG_HEADER_LENGTH ? ID3v2_read_tag_header_from_buffer(tag_header_buffer) : NULL;
 
-    FILE* file = fopen(file_name, "rb");
+    if (tag_header == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    // Read the rest of the tag through the same handle, right after the header
     int buffer_length = tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH;
     char* tag_buffer = (char*) malloc((buffer_length) * sizeof(char));
+    ID3v2_TagHeader_free(tag_header);
 
     if (tag_buffer == NULL)
     {
         perror("Could not allocate buffer.");
         fclose(file);
-        ID3v2_TagHeader_free(tag_header);
         return NULL;
     }
 
-    fread(tag_buffer, buffer_length, 1, file);
+    memcpy(tag_buffer, tag_header_buffer, ID3v2_TAG_HEADER_LENGTH);
+    buffer_length = ID3v2_TAG_HEADER_LENGTH +
+                    fread(tag_buffer + ID3v2_TAG_HEADER_LENGTH, sizeof(char), buffer_length - ID3v2_TAG_HEADER_LENGTH, file);
     fclose(file);
 
     ID3v2_Tag* tag = ID3v2_read_tag_from_buffer(tag_buffer, buffer_length);
 
     free(tag_buffer);
-    ID3v2_TagHeader_free(tag_header);
 
     return tag;
 }
 
 ID3v2_Tag* ID3v2_read_tag_from_buffer(const char* tag_buffer, const int buffer_length)
 {
-    CharStream* tag_cs = CharStream_from_buffer(tag_buffer, buffer_length);
-    ID3v2_Tag* tag = Tag_parse(tag_cs);
-    CharStream_free(tag_cs);
-    return tag;
+    // Frames copy what they need, so the buffer can be parsed where it is
+    CharStream tag_cs = {.cursor = 0, .size = buffer_length, .stream = (char*) tag_buffer};
+    return Tag_parse(&tag_cs);
 }
 
-void ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag)
+ID3v2_TagView* ID3v2_read_tag_view(const char* file_name)
 {
-    if (tag == NULL) return;
-
-    ID3v2_TagHeader* existing_tag_header = ID3v2_read_tag_header(file_name);
-    const int original_size =
-        existing_tag_header != NULL ? existing_tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH : 0;
-    free(existing_tag_header);
-
-    const int extra_padding_length = clamp_int(
-        ID3v2_TAG_DEFAULT_PADDING_LENGTH - tag->padding_size,
-        0,
-        ID3v2_TAG_DEFAULT_PADDING_LENGTH
-    );
-    tag->padding_size += extra_padding_length;
-    CharStream* tag_cs = Tag_to_char_stream(tag);
+#ifdef _WIN32
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL) return NULL;
+
+    char header[ID3v2_TAG_HEADER_LENGTH];
+    if (fread(header, sizeof(char), ID3v2_TAG_HEADER_LENGTH, file) != ID3v2_TAG_HEADER_LENGTH ||
+        memcmp(header, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    int size = ID3v2_TAG_HEADER_LENGTH + syncint_decode(btoi(header + 6, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH));
+    char* buffer = (char*) malloc(size * sizeof(char));
+    memcpy(buffer, header, ID3v2_TAG_HEADER_LENGTH);
+    size = ID3v2_TAG_HEADER_LENGTH +
+           fread(buffer + ID3v2_TAG_HEADER_LENGTH, sizeof(char), size - ID3v2_TAG_HEADER_LENGTH, file);
+    fclose(file);
 
-    // Perform operations on a temp file in case things go wrong
-    FILE* temp_fp = tmpfile();
+    const int buffer_kind = TAG_VIEW_BUFFER_OWNED;
+#else
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0) return NULL;
 
-    // First write the tag to the temp file
-    fwrite(tag_cs->stream, sizeof(char), tag_cs->size, temp_fp);
+    char header[ID3v2_TAG_HEADER_LENGTH];
+    struct stat st;
+    if (pread(fd, header, ID3v2_TAG_HEADER_LENGTH, 0) != ID3v2_TAG_HEADER_LENGTH ||
+        memcmp(header, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0 || fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
 
-    // And then, read the original audio data and copy it to
-    // the temp file so it's located after the tag
-    FILE* dest_fp = fopen(file_name, "r+b");
-    fseek(dest_fp, original_size, SEEK_SET); // move to the end of the original tag
+    // Never map past the end of the file, touching those pages would SIGBUS
+    long long size = ID3v2_TAG_HEADER_LENGTH + syncint_decode(btoi(header + 6, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH));
+    if (size > st.st_size) size = st.st_size;
 
-    int c = 0;
+    char* buffer = NULL;
+    int buffer_kind = TAG_VIEW_BUFFER_OWNED;
 
-    while ((c = getc(dest_fp)) != EOF)
+    if (size >= TAG_VIEW_MMAP_THRESHOLD)
     {
-        putc(c, temp_fp);
+        // Private mapping, so undoing unsynchronisation in place never reaches the file
+        buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (buffer == MAP_FAILED) buffer = NULL;
+        else buffer_kind = TAG_VIEW_BUFFER_MAPPED;
     }
 
-    // Finally copy the temp file back into the destination file
-    fclose(dest_fp);
-    dest_fp = fopen(file_name, "w+b");
-    fseek(temp_fp, 0L, SEEK_SET);
+    if (buffer == NULL)
+    {
+        buffer = (char*) malloc(size * sizeof(char));
+        memcpy(buffer, header, ID3v2_TAG_HEADER_LENGTH);
+        long long done = ID3v2_TAG_HEADER_LENGTH;
+        while (done < size)
+        {
+            const ssize_t n = pread(fd, buffer + done, size - done, done);
+            if (n <= 0) break;
+            done += n;
+        }
+        size = done;
+    }
+
+    close(fd);
+#endif
+
+    ID3v2_TagView* view = TagView_parse(buffer, size, buffer_kind);
+    if (view == NULL) TagView_release_buffer(buffer, size, buffer_kind);
+    return view;
+}
 
-    while ((c = getc(temp_fp)) != EOF)
+ID3v2_TagView* ID3v2_read_tag_view_from_buffer(const char* tag_buffer, const int buffer_length)
+{
+    return TagView_parse((char*) tag_buffer, buffer_length, TAG_VIEW_BUFFER_BORROWED);
+}
+
+/**
+ * Size the tag at the start of the file takes on disk, header and footer
+ * included, 0 if the file doesn't have one.
+ */
+static int read_existing_tag_size(const char* file_name)
+{
+    ID3v2_TagHeader* header = ID3v2_read_tag_header(file_name);
+    if (header == NULL) return 0;
+
+    int size = ID3v2_TAG_HEADER_LENGTH + header->tag_size;
+    if (header->major_version == 4 && (header->flags & TAG_HEADER_FLAG_FOOTER)) size += TAG_FOOTER_LENGTH;
+
+    ID3v2_TagHeader_free(header);
+    return size;
+}
+
+#ifdef _WIN32
+/**
+ * Writes head followed by everything in the file after skip to a temp file
+ * next to it, then swaps the temp file in.
+ */
+static int replace_file(const char* file_name, const char* head, const int head_size, const long skip)
+{
+    FILE* in = fopen(file_name, "rb");
+    if (in == NULL) return -1;
+
+    char* temp_name = (char*) malloc(strlen(file_name) + sizeof(".id3tmp"));
+    sprintf(temp_name, "%s.id3tmp", file_name);
+    FILE* out = fopen(temp_name, "wb");
+    char* buffer = (char*) malloc(COPY_BUFFER_LENGTH * sizeof(char));
+
+    int ok = out != NULL && buffer != NULL && fseek(in, skip, SEEK_SET) == 0 &&
+             fwrite(head, sizeof(char), head_size, out) == (size_t) head_size;
+
+    while (ok)
     {
-        putc(c, dest_fp);
+        const size_t n = fread(buffer, sizeof(char), COPY_BUFFER_LENGTH, in);
+        if (n == 0)
+        {
+            ok = !ferror(in);
+            break;
+        }
+        ok = fwrite(buffer, sizeof(char), n, out) == n;
     }
 
-    fclose(temp_fp);
-    fclose(dest_fp);
+    free(buffer);
+    fclose(in);
+    if (out != NULL && fclose(out) != 0) ok = 0;
 
-    CharStream_free(tag_cs);
+    // rename doesn't replace an existing file on Windows
+    if (ok) ok = remove(file_name) == 0 && rename(temp_name, file_name) == 0;
+    if (!ok && out != NULL) remove(temp_name);
+
+    free(temp_name);
+    return ok ? 0 : -1;
+}
+#else
+static int write_all(int fd, const char* data, size_t size)
+{
+    while (size > 0)
+    {
+        const ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        data += n;
+        size -= n;
+    }
+
+    return 0;
 }
 
-void ID3v2_delete_tag(const char* file_name)
+/**
+ * Appends everything in `in` from offset on to `out`. The kernel does the
+ * copy when it can, otherwise it goes through a large buffer.
+ */
+static int copy_rest(int in, off_t offset, int out)
 {
-    ID3v2_TagHeader* tag_header = ID3v2_read_tag_header(file_name);
+#ifdef __linux__
+    for (;;)
+    {
+        loff_t in_offset = offset;
+        const ssize_t n = copy_file_range(in, &in_offset, out, NULL, 1 << 30, 0);
+        if (n == 0) return 0;
+        if (n > 0)
+        {
+            offset = in_offset;
+            continue;
+        }
+        if (errno == EINTR) continue;
+        break; // not supported for these files, fall back to copying ourselves
+    }
+#endif
 
-    if (tag_header == NULL) return;
+    char* buffer = (char*) malloc(COPY_BUFFER_LENGTH * sizeof(char));
+    if (buffer == NULL) return -1;
 
-    FILE* file_fp = fopen(file_name, "rb");
-    FILE* temp_fp = tmpfile();
+    int result = 0;
+    for (;;)
+    {
+        const ssize_t n = pread(in, buffer, COPY_BUFFER_LENGTH, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0)
+        {
+            result = n < 0 ? -1 : 0;
+            break;
+        }
+        if (write_all(out, buffer, n) != 0)
+        {
+            result = -1;
+            break;
+        }
+        offset += n;
+    }
 
-    fseek(file_fp, tag_header->tag_size + ID3v2_TAG_HEADER_LENGTH, SEEK_SET);
+    free(buffer);
+    return result;
+}
 
-    int c = 0;
+/**
+ * Writes head followed by everything in the file after skip to a temp file
+ * next to it, then renames the temp file over the original. Either the old
+ * or the new file is there at any point, never half of one.
+ */
+static int replace_file(const char* file_name, const char* head, const int head_size, const off_t skip)
+{
+    // Resolve symlinks so the link itself isn't replaced by a regular file
+    char* path = realpath(file_name, NULL);
+    if (path == NULL) return -1;
 
-    while ((c = getc(file_fp)) != EOF)
+    struct stat st;
+    const int in = open(path, O_RDONLY);
+    if (in < 0 || fstat(in, &st) != 0)
     {
-        putc(c, temp_fp);
+        if (in >= 0) close(in);
+        free(path);
+        return -1;
     }
 
-    // Finally copy the temp file back into the destination file
-    fclose(file_fp);
-    file_fp = fopen(file_name, "w+b");
-    fseek(temp_fp, 0L, SEEK_SET);
+    // Same directory, so the rename never crosses filesystems
+    char* temp_path = (char*) malloc(strlen(path) + sizeof(".XXXXXX"));
+    sprintf(temp_path, "%s.XXXXXX", path);
+    const int out = mkstemp(temp_path);
+
+    int ok = out >= 0 && fchmod(out, st.st_mode & 07777) == 0 && write_all(out, head, head_size) == 0 &&
+             copy_rest(in, skip, out) == 0 && fsync(out) == 0;
+
+    if (out >= 0 && close(out) != 0) ok = 0;
+    close(in);
 
-    while ((c = getc(temp_fp)) != EOF)
+    if (ok) ok = rename(temp_path, path) == 0;
+    if (!ok && out >= 0) unlink(temp_path);
+
+    free(temp_path);
+    free(path);
+    return ok ? 0 : -1;
+}
+#endif
+
+int ID3v2_write_tag(const char* file_name, ID3v2_Tag* tag)
+{
+    if (tag == NULL) return -1;
+
+    const int original_size = read_existing_tag_size(file_name);
+    const int content_size = ID3v2_TAG_HEADER_LENGTH + Tag_get_frames_size(tag);
+
+    if (original_size > 0 && content_size <= original_size)
     {
-        putc(c, file_fp);
+        // The new tag fits where the old one was, padding included. Overwrite
+        // it and leave the audio alone.
+        tag->padding_size = original_size - content_size;
+        CharStream* tag_cs = Tag_to_char_stream(tag);
+
+        int result = 0;
+        FILE* fp = fopen(file_name, "r+b");
+        if (fp == NULL || fwrite(tag_cs->stream, sizeof(char), tag_cs->size, fp) != (size_t) tag_cs->size)
+        {
+            perror("Could not write tag.");
+            result = -1;
+        }
+        if (fp != NULL && fclose(fp) != 0) result = -1;
+
+        CharStream_free(tag_cs);
+        return result;
     }
 
-    ID3v2_TagHeader_free(tag_header);
+    // The audio has to move, leave room for the next edits while at it
+    if (tag->padding_size < ID3v2_TAG_DEFAULT_PADDING_LENGTH) tag->padding_size = ID3v2_TAG_DEFAULT_PADDING_LENGTH;
+    CharStream* tag_cs = Tag_to_char_stream(tag);
+
+    const int result = replace_file(file_name, tag_cs->stream, tag_cs->size, original_size);
+    if (result != 0)
+    {
+        perror("Could not write tag.");
+    }
+
+    CharStream_free(tag_cs);
+    return result;
+}
+
+int ID3v2_delete_tag(const char* file_name)
+{
+    const int tag_size = read_existing_tag_size(file_name);
+
+    if (tag_size == 0) return 0;
+
+    const int result = replace_file(file_name, NULL, 0, tag_size);
+    if (result != 0)
+    {
+        perror("Could not delete tag.");
+    }
 
-    fclose(temp_fp);
-    fclose(file_fp);
+    return result;
 }
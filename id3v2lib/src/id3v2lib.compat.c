@@ -163,14 +163,12 @@ ID3v2_tag* load_tag_with_buffer(const char* buffer, int length)
     compat_tag->tag_header->extended_header_size = tag->header->extended_header_size;
 
     // Frames
-    ID3v2_FrameList* head = tag->frames;
     ID3v2_frame_list* compat_frames = new_frame_list();
 
-    while (head != NULL)
+    for (int i = 0; i < tag->frames->count; i++)
     {
-        ID3v2_frame* compat_frame = frame_to_compat_frame(head->frame);
+        ID3v2_frame* compat_frame = frame_to_compat_frame(tag->frames->frames[i]);
         add_to_list(compat_frames, compat_frame);
-        head = head->next;
     }
 
     compat_tag->frames = compat_frames;
@@ -47,7 +47,9 @@ ID3v2_Frame* Frame_parse(CharStream* frame_cs, int id3_major_version)
         return (ID3v2_Frame*) ApicFrame_parse(frame_cs, id3_major_version);
     }
 
-    // Unknown frame type, simply copy the raw data into the data property
+    // Unknown frame type, simply copy the raw data into the data property,
+    // never more than what is left of the tag
+    header->size = clamp_int(header->size, 0, frame_cs->size - frame_cs->cursor);
     ID3v2_Frame* frame = (ID3v2_Frame*) malloc(sizeof(ID3v2_Frame));
     frame->header = header;
     frame->data = (char*) malloc(header->size * sizeof(char));
@@ -104,5 +106,6 @@ void ID3v2_Frame_free(ID3v2_Frame* frame)
         // Unknown frame id, naively try our best to free it
         free(frame->header);
         free(frame->data);
+        free(frame);
     }
 }
@@ -13,45 +13,131 @@
 #include "modules/frame.private.h"
 #include "modules/frame_header.private.h"
 #include "modules/frame_list.private.h"
+#include "modules/utils.private.h"
 
 #include "frame_list.private.h"
 
-ID3v2_FrameList* FrameList_new()
+#define FRAME_LIST_INITIAL_CAPACITY 16
+
+/**
+ * The index chains every frame to the next one that landed in the same
+ * bucket, in tag order. Frame ids in a tag are few and mostly distinct, so a
+ * chain is nearly always the frames sharing one id and the first frame with
+ * an id is the head of its bucket.
+ */
+static int bucket_of(const ID3v2_FrameList* list, const unsigned int id)
+{
+    const unsigned int hash = id * 2654435761u;
+    return (int) ((hash ^ (hash >> 16)) & (unsigned int) (list->bucket_count - 1));
+}
+
+static void index_frame(ID3v2_FrameList* list, const int position)
 {
-    ID3v2_FrameList* list = (ID3v2_FrameList*) malloc(sizeof(ID3v2_FrameList));
+    const int bucket = bucket_of(list, list->ids[position]);
+    list->next[position] = -1;
 
-    if (list != NULL)
+    if (list->bucket_heads[bucket] == -1)
+    {
+        list->bucket_heads[bucket] = position;
+    }
+    else
     {
-        list->frame = NULL;
-        list->next = NULL;
-        list->start = NULL;
+        list->next[list->bucket_tails[bucket]] = position;
     }
 
-    return list;
+    list->bucket_tails[bucket] = position;
 }
 
-void FrameList_add_frame(ID3v2_FrameList* list, ID3v2_Frame* frame)
+static void rebuild_index(ID3v2_FrameList* list)
 {
-    // If the list is empty
-    if (list->start == NULL)
+    for (int i = 0; i < list->bucket_count; i++)
     {
-        list->start = list;
-        list->frame = frame;
+        list->bucket_heads[i] = -1;
     }
-    else
+
+    for (int i = 0; i < list->count; i++)
     {
-        ID3v2_FrameList* current = FrameList_new();
-        current->frame = frame;
-        current->start = list->start;
+        index_frame(list, i);
+    }
+}
 
-        ID3v2_FrameList* last = list;
-        while (last->next != NULL)
-        {
-            last = last->next;
-        }
+static void grow(ID3v2_FrameList* list)
+{
+    list->capacity = list->capacity == 0 ? FRAME_LIST_INITIAL_CAPACITY : list->capacity * 2;
+    list->frames = (ID3v2_Frame**) realloc(list->frames, list->capacity * sizeof(ID3v2_Frame*));
+    list->ids = (unsigned int*) realloc(list->ids, list->capacity * sizeof(unsigned int));
+    list->next = (int*) realloc(list->next, list->capacity * sizeof(int));
+
+    list->bucket_count = list->capacity;
+    list->bucket_heads = (int*) realloc(list->bucket_heads, list->bucket_count * sizeof(int));
+    list->bucket_tails = (int*) realloc(list->bucket_tails, list->bucket_count * sizeof(int));
+    rebuild_index(list);
+}
+
+/**
+ * Returns the position of the first frame with the packed id, -1 if none.
+ */
+static int find_first(const ID3v2_FrameList* list, const unsigned int id)
+{
+    if (list == NULL || list->count == 0) return -1;
 
-        last->next = current;
+    for (int i = list->bucket_heads[bucket_of(list, id)]; i != -1; i = list->next[i])
+    {
+        if (list->ids[i] == id) return i;
     }
+
+    return -1;
+}
+
+/**
+ * Returns the position of the frame, -1 if it isn't in the list.
+ */
+static int find_frame(const ID3v2_FrameList* list, const ID3v2_Frame* frame)
+{
+    if (list == NULL || frame == NULL || list->count == 0) return -1;
+
+    const unsigned int id = FrameList_pack_id(frame->header->id);
+    for (int i = list->bucket_heads[bucket_of(list, id)]; i != -1; i = list->next[i])
+    {
+        if (list->frames[i] == frame) return i;
+    }
+
+    return -1;
+}
+
+static ID3v2_Frame* remove_at(ID3v2_FrameList* list, const int position)
+{
+    ID3v2_Frame* removed = list->frames[position];
+    const int after = list->count - position - 1;
+
+    memmove(list->frames + position, list->frames + position + 1, after * sizeof(ID3v2_Frame*));
+    memmove(list->ids + position, list->ids + position + 1, after * sizeof(unsigned int));
+    list->count--;
+
+    // Every position after the removed frame moved, cheaper to start over
+    rebuild_index(list);
+
+    return removed;
+}
+
+unsigned int FrameList_pack_id(const char* frame_id)
+{
+    return btoi(frame_id, ID3v2_FRAME_HEADER_ID_LENGTH);
+}
+
+ID3v2_FrameList* FrameList_new()
+{
+    return (ID3v2_FrameList*) calloc(1, sizeof(ID3v2_FrameList));
+}
+
+void FrameList_add_frame(ID3v2_FrameList* list, ID3v2_Frame* frame)
+{
+    if (list->count == list->capacity) grow(list);
+
+    list->frames[list->count] = frame;
+    list->ids[list->count] = FrameList_pack_id(frame->header->id);
+    index_frame(list, list->count);
+    list->count++;
 }
 
 /**
@@ -59,16 +145,31 @@ void FrameList_add_frame(ID3v2_FrameList* list, ID3v2_Frame* frame)
  */
 ID3v2_Frame* FrameList_get_frame_by_id(ID3v2_FrameList* list, const char* frame_id)
 {
-    while (list != NULL && list->frame != NULL)
+    const int position = find_first(list, FrameList_pack_id(frame_id));
+    return position == -1 ? NULL : list->frames[position];
+}
+
+ID3v2_Frame* ID3v2_FrameList_next_by_id(
+    const ID3v2_FrameList* list,
+    const char* frame_id,
+    int* position
+)
+{
+    if (list == NULL || list->count == 0 || *position >= list->count) return NULL;
+
+    const unsigned int id = FrameList_pack_id(frame_id);
+    int i = *position < 0 ? list->bucket_heads[bucket_of(list, id)] : list->next[*position];
+
+    for (; i != -1; i = list->next[i])
     {
-        if (strncmp(list->frame->header->id, frame_id, 4) == 0)
+        if (list->ids[i] == id)
         {
-            return list->frame;
+            *position = i;
+            return list->frames[i];
         }
-
-        list = list->next;
     }
 
+    *position = list->count;
     return NULL;
 }
 
@@ -79,14 +180,11 @@ ID3v2_FrameList* FrameList_get_frames_by_id(ID3v2_FrameList* list, const char* f
 {
     ID3v2_FrameList* sublist = FrameList_new();
 
-    while (list != NULL && list->frame != NULL)
+    int position = -1;
+    ID3v2_Frame* frame;
+    while ((frame = ID3v2_FrameList_next_by_id(list, frame_id, &position)) != NULL)
     {
-        if (strncmp(list->frame->header->id, frame_id, 4) == 0)
-        {
-            FrameList_add_frame(sublist, list->frame);
-        }
-
-        list = list->next;
+        FrameList_add_frame(sublist, frame);
     }
 
     return sublist;
@@ -94,64 +192,38 @@ ID3v2_FrameList* FrameList_get_frames_by_id(ID3v2_FrameList* list, const char* f
 
 void ID3v2_FrameList_free(ID3v2_FrameList* list)
 {
-    while (list != NULL)
+    if (list == NULL) return;
+
+    for (int i = 0; i < list->count; i++)
     {
-        ID3v2_Frame_free(list->frame);
-        ID3v2_FrameList* next_head = list->next;
-        free(list);
-        list = next_head;
+        ID3v2_Frame_free(list->frames[i]);
     }
+
+    ID3v2_FrameList_unlink(list);
 }
 
 void ID3v2_FrameList_unlink(ID3v2_FrameList* list)
 {
-    while (list != NULL)
-    {
-        ID3v2_FrameList* next_head = list->next;
-        free(list);
-        list = next_head;
-    }
+    if (list == NULL) return;
+
+    free(list->frames);
+    free(list->ids);
+    free(list->next);
+    free(list->bucket_heads);
+    free(list->bucket_tails);
+    free(list);
 }
 
 ID3v2_Frame* FrameList_remove_frame_by_id(ID3v2_FrameList* list, const char* frame_id)
 {
-    if (list == NULL) return NULL;
-
-    while (list != NULL)
-    {
-        if (strncmp(list->frame->header->id, frame_id, 4) == 0)
-        {
-            ID3v2_Frame* removed = list->frame;
-            ID3v2_FrameList* new_head_old_ptr = list->next != NULL ? list->next : FrameList_new();
-            *list = *new_head_old_ptr;
-            free(new_head_old_ptr);
-            return removed;
-        }
-
-        list = list->next;
-    }
-
-    return NULL;
+    const int position = find_first(list, FrameList_pack_id(frame_id));
+    return position == -1 ? NULL : remove_at(list, position);
 }
 
 ID3v2_Frame* FrameList_remove_frame(ID3v2_FrameList* list, ID3v2_Frame* to_remove)
 {
-    if (list == NULL) return NULL;
-
-    while (list != NULL)
-    {
-        if (list->frame == to_remove)
-        {
-            ID3v2_FrameList* new_head_old_ptr = list->next != NULL ? list->next : FrameList_new();
-            *list = *new_head_old_ptr;
-            free(new_head_old_ptr);
-            return to_remove;
-        }
-
-        list = list->next;
-    }
-
-    return NULL;
+    const int position = find_frame(list, to_remove);
+    return position == -1 ? NULL : remove_at(list, position);
 }
 
 /**
@@ -160,16 +232,15 @@ ID3v2_Frame* FrameList_remove_frame(ID3v2_FrameList* list, ID3v2_Frame* to_remov
  */
 void FrameList_replace_frame(ID3v2_FrameList* list, ID3v2_Frame* old_frame, ID3v2_Frame* new_frame)
 {
-    if (list == NULL) return;
+    const int position = find_frame(list, old_frame);
+    if (position == -1) return;
 
-    while (list != NULL)
-    {
-        if (list->frame == old_frame)
-        {
-            list->frame = new_frame;
-            return;
-        }
+    list->frames[position] = new_frame;
 
-        list = list->next;
+    const unsigned int id = FrameList_pack_id(new_frame->header->id);
+    if (id != list->ids[position])
+    {
+        list->ids[position] = id;
+        rebuild_index(list);
     }
 }
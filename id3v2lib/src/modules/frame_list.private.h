@@ -12,6 +12,11 @@
 
 #include "modules/frame_list.h"
 
+/**
+ * Frame ids are compared as the 4 id bytes read as a big endian integer.
+ */
+unsigned int FrameList_pack_id(const char* frame_id);
+
 ID3v2_FrameList* FrameList_new();
 
 void FrameList_add_frame(ID3v2_FrameList* list, ID3v2_Frame* frame);
@@ -48,31 +48,52 @@ ID3v2_ApicFrame* ApicFrame_parse(CharStream* frame_cs, const int id3_major_versi
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    const int payload_size = clamp_int(header->size, 0, frame_cs->size - frame_cs->cursor);
+    ID3v2_ApicFrame* frame =
+        ApicFrame_from_payload(header->flags, CharStream_get_cur(frame_cs), payload_size);
+    CharStream_seek(frame_cs, payload_size, SEEK_CUR);
 
-    const int mime_type_size = ID3v2_strlent(CharStream_get_cur(frame_cs));
-    char* mime_type = malloc(mime_type_size * sizeof(char));
-    CharStream_read(frame_cs, mime_type, mime_type_size);
+    FrameHeader_free(header); // we only needed the header to parse the data
 
-    const char picture_type = CharStream_getc(frame_cs);
+    return frame;
+}
 
-    const int description_size = ID3v2_strlent(CharStream_get_cur(frame_cs));
-    char* description = malloc(description_size * sizeof(char));
-    CharStream_read(frame_cs, description, description_size);
+/**
+ * Builds a picture frame out of the raw frame payload. The picture itself is
+ * copied straight from the payload, only the short strings go through a
+ * temporary copy.
+ */
+ID3v2_ApicFrame* ApicFrame_from_payload(
+    const char* flags,
+    const char* payload,
+    const int payload_size
+)
+{
+    const char encoding = payload_size > 0 ? payload[0] : ID3v2_ENCODING_ISO;
+    int cursor = clamp_int(ID3v2_FRAME_ENCODING_LENGTH, 0, payload_size);
 
-    const int pic_size = header->size - ID3v2_FRAME_ENCODING_LENGTH - mime_type_size -
-                         ID3v2_APIC_FRAME_PICTURE_TYPE_LENGTH - description_size;
-    char* pic_data = malloc(pic_size * sizeof(char));
-    CharStream_read(frame_cs, pic_data, pic_size);
+    const int mime_type_size = strnlent(payload + cursor, payload_size - cursor, ID3v2_ENCODING_ISO);
+    char* mime_type = string_copy_terminated(payload + cursor, mime_type_size);
+    cursor += mime_type_size;
 
-    ID3v2_ApicFrame* frame =
-        ApicFrame_new(header->flags, description, picture_type, mime_type, pic_size, pic_data);
+    const char picture_type = cursor < payload_size ? payload[cursor] : ID3v2_PIC_TYPE_OTHER;
+    cursor = clamp_int(cursor + ID3v2_APIC_FRAME_PICTURE_TYPE_LENGTH, 0, payload_size);
 
-    FrameHeader_free(header); // we only needed the header to parse the data
+    const int description_size = strnlent(payload + cursor, payload_size - cursor, encoding);
+    char* description = string_copy_terminated(payload + cursor, description_size);
+    cursor += description_size;
+
+    ID3v2_ApicFrame* frame = ApicFrame_new(
+        flags,
+        description,
+        picture_type,
+        mime_type,
+        payload_size - cursor,
+        payload + cursor
+    );
 
     free(mime_type);
     free(description);
-    free(pic_data);
     return frame;
 }
 
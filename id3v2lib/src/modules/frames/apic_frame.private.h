@@ -23,6 +23,11 @@ ID3v2_ApicFrame* ApicFrame_new(
     const char* data
 );
 ID3v2_ApicFrame* ApicFrame_parse(CharStream* frame_cs, const int id3_major_version);
+ID3v2_ApicFrame* ApicFrame_from_payload(
+    const char* flags,
+    const char* payload,
+    const int payload_size
+);
 CharStream* ApicFrame_to_char_stream(ID3v2_ApicFrame* frame);
 
 void ApicFrame_free(ID3v2_ApicFrame* frame);
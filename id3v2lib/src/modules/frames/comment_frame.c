@@ -43,22 +43,41 @@ ID3v2_CommentFrame* CommentFrame_parse(CharStream* frame_cs, const int id3_major
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    const int payload_size = clamp_int(header->size, 0, frame_cs->size - frame_cs->cursor);
+    ID3v2_CommentFrame* frame =
+        CommentFrame_from_payload(header->flags, CharStream_get_cur(frame_cs), payload_size);
+    CharStream_seek(frame_cs, payload_size, SEEK_CUR);
 
-    char lang[ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH];
-    CharStream_read(frame_cs, lang, ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH);
+    FrameHeader_free(header); // we only needed the header to parse the data
+
+    return frame;
+}
+
+/**
+ * Builds a comment frame out of the raw frame payload. Strings are never read
+ * past the end of the payload, even when they are not terminated.
+ */
+ID3v2_CommentFrame* CommentFrame_from_payload(
+    const char* flags,
+    const char* payload,
+    const int payload_size
+)
+{
+    const char encoding = payload_size > 0 ? payload[0] : ID3v2_ENCODING_ISO;
+    int cursor = clamp_int(ID3v2_FRAME_ENCODING_LENGTH, 0, payload_size);
 
-    const int short_desc_size = ID3v2_strlent(CharStream_get_cur(frame_cs));
-    char* short_desc = malloc(short_desc_size * sizeof (char));
-    CharStream_read(frame_cs, short_desc, short_desc_size);
+    char lang[ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH] = {0};
+    const int lang_size = clamp_int(payload_size - cursor, 0, ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH);
+    memcpy(lang, payload + cursor, lang_size);
+    cursor += lang_size;
 
-    const int comment_size = ID3v2_strlent(CharStream_get_cur(frame_cs));
-    char* comment = malloc(comment_size * sizeof(char));
-    CharStream_read(frame_cs, comment, comment_size);
+    const int short_desc_size = strnlent(payload + cursor, payload_size - cursor, encoding);
+    char* short_desc = string_copy_terminated(payload + cursor, short_desc_size);
+    cursor += short_desc_size;
 
-    ID3v2_CommentFrame* frame = CommentFrame_new(header->flags, lang, short_desc, comment);
+    char* comment = string_copy_terminated(payload + cursor, payload_size - cursor);
 
-    FrameHeader_free(header); // we only needed the header to parse the data
+    ID3v2_CommentFrame* frame = CommentFrame_new(flags, lang, short_desc, comment);
 
     free(comment);
     free(short_desc);
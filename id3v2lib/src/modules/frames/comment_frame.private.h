@@ -21,6 +21,11 @@ ID3v2_CommentFrame* CommentFrame_new(
     const char* comment
 );
 ID3v2_CommentFrame* CommentFrame_parse(CharStream* frame_cs, const int id3_major_version);
+ID3v2_CommentFrame* CommentFrame_from_payload(
+    const char* flags,
+    const char* payload,
+    const int payload_size
+);
 CharStream* CommentFrame_to_char_stream(ID3v2_CommentFrame* frame);
 
 void CommentFrame_free(ID3v2_CommentFrame* frame);
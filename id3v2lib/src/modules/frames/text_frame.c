@@ -34,22 +34,43 @@ ID3v2_TextFrame* TextFrame_parse(CharStream* frame_cs, const int id3_major_versi
 {
     ID3v2_FrameHeader* header = FrameHeader_parse(frame_cs, id3_major_version);
 
-    CharStream_seek(frame_cs, ID3v2_FRAME_ENCODING_LENGTH, SEEK_CUR); // skip encoding
+    const int payload_size = clamp_int(header->size, 0, frame_cs->size - frame_cs->cursor);
+    ID3v2_TextFrame* frame =
+        TextFrame_from_payload(header->id, header->flags, CharStream_get_cur(frame_cs), payload_size);
+    CharStream_seek(frame_cs, payload_size, SEEK_CUR);
 
-    const int text_size = header->size - ID3v2_FRAME_ENCODING_LENGTH;
-    const size_t string_termination_bytes = 2;
-    char* text = malloc((string_termination_bytes + text_size) * sizeof(char));
-    CharStream_read(frame_cs, text, text_size);
+    FrameHeader_free(header); // we only needed the header to parse the data
+
+    return frame;
+}
+
+/**
+ * Builds a text frame out of the raw frame payload (encoding byte and text),
+ * copying the text only once.
+ */
+ID3v2_TextFrame* TextFrame_from_payload(
+    const char* id,
+    const char* flags,
+    const char* payload,
+    const int payload_size
+)
+{
+    const int text_size = payload_size > ID3v2_FRAME_ENCODING_LENGTH
+                              ? payload_size - ID3v2_FRAME_ENCODING_LENGTH
+                              : 0;
 
     // Adding string termination bytes in case the stored string doesn't have those
-    for (int i = 0; i < string_termination_bytes; ++i)
-        text[text_size + i] = 0x00;
+    char* text = string_copy_terminated(payload + ID3v2_FRAME_ENCODING_LENGTH, text_size);
 
-    ID3v2_TextFrame* frame = TextFrame_new(header->id, header->flags, text);
+    ID3v2_TextFrameData* data = (ID3v2_TextFrameData*) malloc(sizeof(ID3v2_TextFrameData));
+    data->encoding = string_has_bom(text) ? ID3v2_ENCODING_UNICODE : ID3v2_ENCODING_ISO;
+    data->size = ID3v2_strlen(text) + (data->encoding == ID3v2_ENCODING_ISO ? 1 : 2);
+    data->text = text;
 
-    FrameHeader_free(header); // we only needed the header to parse the data
+    ID3v2_TextFrame* frame = (ID3v2_TextFrame*) malloc(sizeof(ID3v2_TextFrame));
+    frame->data = data;
+    frame->header = FrameHeader_new(id, flags, ID3v2_FRAME_ENCODING_LENGTH + data->size);
 
-    free(text);
     return frame;
 }
 
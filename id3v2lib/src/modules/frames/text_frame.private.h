@@ -16,6 +16,12 @@ typedef struct _CharStream CharStream;
 
 ID3v2_TextFrame* TextFrame_new(const char* id, const char* flags, const char* text);
 ID3v2_TextFrame* TextFrame_parse(CharStream* frame_cs, const int id3_major_version);
+ID3v2_TextFrame* TextFrame_from_payload(
+    const char* id,
+    const char* flags,
+    const char* payload,
+    const int payload_size
+);
 CharStream* TextFrame_to_char_stream(ID3v2_TextFrame* frame);
 
 void TextFrame_free(ID3v2_TextFrame* frame);
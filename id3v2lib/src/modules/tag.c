@@ -50,8 +50,14 @@ ID3v2_Tag* Tag_parse(CharStream* tag_cs)
 
     if (header->extended_header_size > 0)
     {
-        // An extended header exists, skip it
-        CharStream_seek(tag_cs, header->extended_header_size, SEEK_SET);
+        // An extended header exists, skip it. Its size doesn't count the size
+        // bytes themselves in v2.3, in v2.4 it does.
+        const int size_length = header->major_version == 3 ? ID3v2_EXTENDED_HEADER_SIZE_LENGTH : 0;
+        CharStream_seek(
+            tag_cs,
+            ID3v2_TAG_HEADER_LENGTH + size_length + header->extended_header_size,
+            SEEK_SET
+        );
     }
 
     ID3v2_Frame* current_frame;
@@ -67,8 +73,28 @@ ID3v2_Tag* Tag_parse(CharStream* tag_cs)
     return tag;
 }
 
+int Tag_get_frames_size(ID3v2_Tag* tag)
+{
+    int size = 0;
+
+    for (int i = 0; i < tag->frames->count; i++)
+    {
+        size += ID3v2_FRAME_HEADER_LENGTH + tag->frames->frames[i]->header->size;
+    }
+
+    return size;
+}
+
 CharStream* Tag_to_char_stream(ID3v2_Tag* tag)
 {
+    // The size kept up to date by the setters is only an estimate, the tag
+    // written is exactly its frames followed by the padding
+    tag->header->tag_size = Tag_get_frames_size(tag) + tag->padding_size;
+
+    // Neither of these are written back
+    tag->header->flags &= ~(TAG_HEADER_FLAG_UNSYNCHRONISATION | TAG_HEADER_FLAG_EXTENDED_HEADER | TAG_HEADER_FLAG_FOOTER);
+    tag->header->extended_header_size = 0;
+
     CharStream* tag_cs = CharStream_new(tag->header->tag_size + ID3v2_TAG_HEADER_LENGTH);
 
     // Write header
@@ -84,22 +110,22 @@ CharStream* Tag_to_char_stream(ID3v2_Tag* tag)
     // Write frames
     ID3v2_FrameList* frames = tag->frames;
 
-    if (frames->frame == NULL)
+    for (int i = 0; i < frames->count; i++)
     {
-        // The tag doesn't have any frames
-        return tag_cs;
-    }
-
-    while (frames != NULL)
-    {
-        CharStream* frame_cs = Frame_to_char_stream(frames->frame);
+        CharStream* frame_cs = Frame_to_char_stream(frames->frames[i]);
 
         if (frame_cs == NULL) exit(1);
 
+        if (tag->header->major_version == 4)
+        {
+            // Frame sizes are sync safe integers in v2.4
+            char* frame_size_bytes = itob(syncint_encode(frames->frames[i]->header->size));
+            memcpy(frame_cs->stream + ID3v2_FRAME_HEADER_ID_LENGTH, frame_size_bytes, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+            free(frame_size_bytes);
+        }
+
         CharStream_write(tag_cs, frame_cs->stream, frame_cs->size);
         CharStream_free(frame_cs);
-
-        frames = frames->next;
     }
 
     return tag_cs;
@@ -509,24 +535,20 @@ void ID3v2_Tag_delete_composer(ID3v2_Tag* tag)
 void ID3v2_Tag_delete_comment_frame(ID3v2_Tag* tag, const int index)
 {
     int i = 0;
-    ID3v2_FrameList* head = ID3v2_Tag_get_comment_frames(tag);
+    int position = -1;
+    ID3v2_Frame* to_delete;
 
-    while (head != NULL)
+    while ((to_delete = ID3v2_FrameList_next_by_id(tag->frames, ID3v2_COMMENT_FRAME_ID, &position)) != NULL)
     {
-        ID3v2_CommentFrame* to_delete = (ID3v2_CommentFrame*) head->frame;
-
         if (i == index)
         {
-            FrameList_remove_frame(tag->frames, (ID3v2_Frame*) to_delete);
-            ID3v2_Frame_free((ID3v2_Frame*) to_delete);
+            FrameList_remove_frame(tag->frames, to_delete);
+            ID3v2_Frame_free(to_delete);
             break;
         }
 
         i++;
-        head = head->next;
     }
-
-    ID3v2_FrameList_unlink(head);
 }
 
 void ID3v2_Tag_delete_comment(ID3v2_Tag* tag)
@@ -537,24 +559,20 @@ void ID3v2_Tag_delete_comment(ID3v2_Tag* tag)
 void ID3v2_Tag_delete_apic_frame(ID3v2_Tag* tag, const int index)
 {
     int i = 0;
-    ID3v2_FrameList* head = ID3v2_Tag_get_apic_frames(tag);
+    int position = -1;
+    ID3v2_Frame* to_delete;
 
-    while (head != NULL)
+    while ((to_delete = ID3v2_FrameList_next_by_id(tag->frames, ID3v2_ALBUM_COVER_FRAME_ID, &position)) != NULL)
     {
-        ID3v2_ApicFrame* to_delete = (ID3v2_ApicFrame*) head->frame;
-
         if (i == index)
         {
-            FrameList_remove_frame(tag->frames, (ID3v2_Frame*) to_delete);
-            ID3v2_Frame_free((ID3v2_Frame*) to_delete);
+            FrameList_remove_frame(tag->frames, to_delete);
+            ID3v2_Frame_free(to_delete);
             break;
         }
 
         i++;
-        head = head->next;
     }
-
-    ID3v2_FrameList_unlink(head);
 }
 
 void ID3v2_Tag_delete_album_cover(ID3v2_Tag* tag)
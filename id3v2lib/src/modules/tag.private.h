@@ -17,4 +17,9 @@ typedef struct _CharStream CharStream;
 ID3v2_Tag* Tag_parse(CharStream* tag_cs);
 CharStream* Tag_to_char_stream(ID3v2_Tag* tag);
 
+/**
+ * Size of the frames once written, frame headers included.
+ */
+int Tag_get_frames_size(ID3v2_Tag* tag);
+
 #endif
@@ -12,6 +12,12 @@
 
 #include "modules/tag_header.h"
 
+#define TAG_HEADER_FLAG_UNSYNCHRONISATION 0x80
+#define TAG_HEADER_FLAG_EXTENDED_HEADER 0x40
+#define TAG_HEADER_FLAG_FOOTER 0x10
+
+#define TAG_FOOTER_LENGTH 10
+
 typedef struct _CharStream CharStream;
 
 ID3v2_TagHeader* TagHeader_new(
@@ -0,0 +1,246 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+#include "frames/apic_frame.private.h"
+#include "frames/comment_frame.private.h"
+#include "frames/text_frame.private.h"
+#include "modules/frame.h"
+#include "modules/frame_ids.h"
+#include "modules/picture_types.h"
+#include "modules/tag_header.private.h"
+#include "modules/utils.private.h"
+
+#include "tag_view.private.h"
+
+#define FRAME_FLAG_V4_UNSYNCHRONISATION 0x02
+#define FRAME_FLAG_V4_DATA_LENGTH_INDICATOR 0x01
+
+#define DATA_LENGTH_INDICATOR_LENGTH 4
+
+static bool is_frame_id(const char* id)
+{
+    for (int i = 0; i < ID3v2_FRAME_HEADER_ID_LENGTH; i++)
+    {
+        if (!((id[i] >= 'A' && id[i] <= 'Z') || (id[i] >= '0' && id[i] <= '9'))) return false;
+    }
+
+    return true;
+}
+
+/**
+ * Unsynchronisation has to be undone in place, so a borrowed buffer gets
+ * copied the first time that happens. Frames parsed before keep pointing into
+ * the borrowed buffer, which is fine, it outlives the view.
+ */
+static char* make_writable(ID3v2_TagView* view)
+{
+    if (view->buffer_kind != TAG_VIEW_BUFFER_BORROWED) return view->buffer;
+
+    char* copy = (char*) malloc(view->buffer_size * sizeof(char));
+    memcpy(copy, view->buffer, view->buffer_size);
+    view->buffer = copy;
+    view->buffer_kind = TAG_VIEW_BUFFER_OWNED;
+    return copy;
+}
+
+static void add_frame(ID3v2_TagView* view, ID3v2_FrameView* frame, int* capacity)
+{
+    if (view->frame_count == *capacity)
+    {
+        *capacity = *capacity == 0 ? 16 : *capacity * 2;
+        view->frames = (ID3v2_FrameView*) realloc(view->frames, *capacity * sizeof(ID3v2_FrameView));
+    }
+
+    view->frames[view->frame_count++] = *frame;
+}
+
+ID3v2_TagView* TagView_parse(char* buffer, const int buffer_size, const int buffer_kind)
+{
+    if (buffer_size < ID3v2_TAG_HEADER_LENGTH) return NULL;
+    if (memcmp(buffer, "ID3", ID3v2_TAG_HEADER_IDENTIFIER_LENGTH) != 0) return NULL;
+
+    const int major_version = buffer[3];
+    if (major_version != 3 && major_version != 4) return NULL; // No supported id3 tag found
+
+    ID3v2_TagView* view = (ID3v2_TagView*) calloc(1, sizeof(ID3v2_TagView));
+    view->buffer = buffer;
+    view->buffer_size = buffer_size;
+    view->buffer_kind = buffer_kind;
+
+    ID3v2_TagHeader* header = &view->header;
+    memcpy(header->identifier, buffer, ID3v2_TAG_HEADER_IDENTIFIER_LENGTH);
+    header->major_version = major_version;
+    header->minor_version = buffer[4];
+    header->flags = buffer[5];
+    header->tag_size = syncint_decode(btoi(buffer + 6, ID3v2_TAG_HEADER_TAG_SIZE_LENGTH));
+
+    int end = ID3v2_TAG_HEADER_LENGTH + clamp_int(header->tag_size, 0, buffer_size - ID3v2_TAG_HEADER_LENGTH);
+    int cursor = ID3v2_TAG_HEADER_LENGTH;
+
+    const bool unsynchronised = (header->flags & TAG_HEADER_FLAG_UNSYNCHRONISATION) != 0;
+
+    if (unsynchronised && major_version == 3)
+    {
+        // In v2.3 the whole tag after the header is unsynchronised, extended header included
+        char* writable = make_writable(view);
+        end = cursor + unsync_decode(writable + cursor, end - cursor);
+    }
+
+    char* data = view->buffer;
+
+    if ((header->flags & TAG_HEADER_FLAG_EXTENDED_HEADER) && cursor + ID3v2_EXTENDED_HEADER_SIZE_LENGTH <= end)
+    {
+        // v2.3 doesn't count the size bytes themselves, v2.4 does (and uses a sync safe integer)
+        const unsigned int size = btoi(data + cursor, ID3v2_EXTENDED_HEADER_SIZE_LENGTH);
+        header->extended_header_size = major_version == 3
+                                           ? size + ID3v2_EXTENDED_HEADER_SIZE_LENGTH
+                                           : syncint_decode(size);
+        cursor = clamp_int(cursor + header->extended_header_size, cursor, end);
+    }
+
+    int capacity = 0;
+
+    while (cursor + ID3v2_FRAME_HEADER_LENGTH <= end)
+    {
+        const char* frame_header = data + cursor;
+
+        // Anything that doesn't look like a frame id is the start of the padding
+        if (!is_frame_id(frame_header)) break;
+
+        const unsigned int raw_size = btoi(frame_header + ID3v2_FRAME_HEADER_ID_LENGTH, ID3v2_FRAME_HEADER_SIZE_LENGTH);
+        const unsigned int size = major_version == 4 ? syncint_decode(raw_size) : raw_size;
+        if (size > (unsigned int) (end - cursor - ID3v2_FRAME_HEADER_LENGTH)) break;
+
+        ID3v2_FrameView frame;
+        memcpy(frame.id, frame_header, ID3v2_FRAME_HEADER_ID_LENGTH);
+        memcpy(frame.flags, frame_header + ID3v2_FRAME_HEADER_ID_LENGTH + ID3v2_FRAME_HEADER_SIZE_LENGTH, ID3v2_FRAME_HEADER_FLAGS_LENGTH);
+        frame.data = frame_header + ID3v2_FRAME_HEADER_LENGTH;
+        frame.size = size;
+
+        if (major_version == 4)
+        {
+            if (frame.flags[1] & FRAME_FLAG_V4_DATA_LENGTH_INDICATOR && frame.size >= DATA_LENGTH_INDICATOR_LENGTH)
+            {
+                frame.data += DATA_LENGTH_INDICATOR_LENGTH;
+                frame.size -= DATA_LENGTH_INDICATOR_LENGTH;
+            }
+
+            if (frame.flags[1] & FRAME_FLAG_V4_UNSYNCHRONISATION || unsynchronised)
+            {
+                const int offset = frame.data - data;
+                data = make_writable(view);
+                frame.data = data + offset;
+                frame.size = unsync_decode(data + offset, frame.size);
+            }
+
+            // The payload is plain bytes now, so the flags shouldn't claim otherwise
+            frame.flags[1] &= ~(FRAME_FLAG_V4_UNSYNCHRONISATION | FRAME_FLAG_V4_DATA_LENGTH_INDICATOR);
+        }
+
+        add_frame(view, &frame, &capacity);
+        cursor += ID3v2_FRAME_HEADER_LENGTH + size;
+    }
+
+    view->padding_size = end - cursor;
+
+    return view;
+}
+
+void TagView_release_buffer(char* buffer, const int buffer_size, const int buffer_kind)
+{
+    if (buffer_kind == TAG_VIEW_BUFFER_OWNED)
+    {
+        free(buffer);
+    }
+#ifndef _WIN32
+    else if (buffer_kind == TAG_VIEW_BUFFER_MAPPED)
+    {
+        munmap(buffer, buffer_size);
+    }
+#endif
+}
+
+void ID3v2_TagView_free(ID3v2_TagView* view)
+{
+    if (view == NULL) return;
+
+    TagView_release_buffer(view->buffer, view->buffer_size, view->buffer_kind);
+    free(view->frames);
+    free(view);
+}
+
+const ID3v2_FrameView* ID3v2_TagView_get_frame(const ID3v2_TagView* view, const char* frame_id)
+{
+    if (view == NULL) return NULL;
+
+    for (int i = 0; i < view->frame_count; i++)
+    {
+        if (memcmp(view->frames[i].id, frame_id, ID3v2_FRAME_HEADER_ID_LENGTH) == 0)
+        {
+            return &view->frames[i];
+        }
+    }
+
+    return NULL;
+}
+
+ID3v2_TextFrame* ID3v2_FrameView_to_text_frame(const ID3v2_FrameView* frame)
+{
+    if (frame == NULL || frame->id[0] != 'T') return NULL;
+    return TextFrame_from_payload(frame->id, frame->flags, frame->data, frame->size);
+}
+
+ID3v2_CommentFrame* ID3v2_FrameView_to_comment_frame(const ID3v2_FrameView* frame)
+{
+    if (frame == NULL || memcmp(frame->id, ID3v2_COMMENT_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) != 0)
+    {
+        return NULL;
+    }
+
+    return CommentFrame_from_payload(frame->flags, frame->data, frame->size);
+}
+
+ID3v2_ApicFrame* ID3v2_FrameView_to_apic_frame(const ID3v2_FrameView* frame)
+{
+    if (frame == NULL || memcmp(frame->id, ID3v2_ALBUM_COVER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) != 0)
+    {
+        return NULL;
+    }
+
+    return ApicFrame_from_payload(frame->flags, frame->data, frame->size);
+}
+
+const char* ID3v2_FrameView_get_picture(const ID3v2_FrameView* frame, int* picture_size)
+{
+    *picture_size = 0;
+
+    if (frame == NULL || memcmp(frame->id, ID3v2_ALBUM_COVER_FRAME_ID, ID3v2_FRAME_HEADER_ID_LENGTH) != 0)
+    {
+        return NULL;
+    }
+
+    // encoding, mime type, picture type, description, picture
+    const char encoding = frame->size > 0 ? frame->data[0] : ID3v2_ENCODING_ISO;
+    int cursor = clamp_int(ID3v2_FRAME_ENCODING_LENGTH, 0, frame->size);
+    cursor += strnlent(frame->data + cursor, frame->size - cursor, ID3v2_ENCODING_ISO);
+    cursor = clamp_int(cursor + ID3v2_APIC_FRAME_PICTURE_TYPE_LENGTH, 0, frame->size);
+    cursor += strnlent(frame->data + cursor, frame->size - cursor, encoding);
+
+    *picture_size = frame->size - cursor;
+    return frame->data + cursor;
+}
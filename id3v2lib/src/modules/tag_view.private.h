@@ -0,0 +1,26 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#ifndef id3v2lib_tag_view_private_h
+#define id3v2lib_tag_view_private_h
+
+#include "modules/tag_view.h"
+
+// Who the bytes behind a view belong to
+#define TAG_VIEW_BUFFER_BORROWED 0 // the caller's, never written to
+#define TAG_VIEW_BUFFER_OWNED 1    // malloc'd by the library
+#define TAG_VIEW_BUFFER_MAPPED 2   // a private (copy on write) file mapping
+
+// Tags at least this big are mapped instead of read
+#define TAG_VIEW_MMAP_THRESHOLD (64 * 1024)
+
+ID3v2_TagView* TagView_parse(char* buffer, const int buffer_size, const int buffer_kind);
+void TagView_release_buffer(char* buffer, const int buffer_size, const int buffer_kind);
+
+#endif
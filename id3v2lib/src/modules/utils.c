@@ -110,18 +110,18 @@ char* itob(int integer)
 
 int syncint_encode(int value)
 {
-    int out, mask = 0x7F;
+    unsigned int in = value, out = 0, mask = 0x7F;
 
     while (mask ^ 0x7FFFFFFF)
     {
-        out = value & ~mask;
+        out = in & ~mask;
         out <<= 1;
-        out |= value & mask;
+        out |= in & mask;
         mask = ((mask + 1) << 8) - 1;
-        value = out;
+        in = out;
     }
 
-    return out;
+    return (int) out;
 }
 
 unsigned int syncint_decode(int value)
@@ -152,10 +152,76 @@ bool string_has_bom(const char* string)
         return false;
     }
 
-    if (memcmp("\xFF\xFE", string, 2) == 0 || memcmp("\xFE\xFF", string, 2) == 0)
+    // Byte by byte so an empty string (a single termination byte) is never read past
+    const unsigned char* bytes = (const unsigned char*) string;
+    if ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF))
     {
         return true;
     }
 
     return false;
 }
+
+/**
+ * Like ID3v2_strlent but never looks further than max_size bytes. If no
+ * termination character is found the string takes up all of max_size.
+ * Strings in one of the utf-16 encodings are terminated by two zero bytes,
+ * even when they don't start with a BOM.
+ */
+int strnlent(const char* string, const int max_size, const char encoding)
+{
+    if (max_size <= 0) return 0;
+
+    const bool has_bom = max_size >= BOM_LENGTH && string_has_bom(string);
+
+    if (has_bom || encoding == 1 || encoding == 2)
+    {
+        for (int i = has_bom ? BOM_LENGTH : 0; i + 1 < max_size; i += 2)
+        {
+            if (string[i] == 0x00 && string[i + 1] == 0x00) return i + 2;
+        }
+
+        return max_size;
+    }
+
+    const char* end = memchr(string, 0x00, max_size);
+    return end == NULL ? max_size : end - string + 1;
+}
+
+/**
+ * Copies size bytes of string and appends enough zero bytes to terminate it
+ * both as an iso and as an utf-16 string, whatever the source looked like.
+ */
+char* string_copy_terminated(const char* string, const int size)
+{
+    const int termination_bytes = 3; // one more than needed, for odd sized utf-16 strings
+    char* result = (char*) malloc((size + termination_bytes) * sizeof(char));
+    memcpy(result, string, size);
+    memset(result + size, 0x00, termination_bytes);
+    return result;
+}
+
+/**
+ * Undoes the unsynchronisation scheme (every 0xFF 0x00 becomes 0xFF) in place
+ * and returns the new size.
+ */
+int unsync_decode(char* data, const int size)
+{
+    int out = 0;
+    int i = 0;
+
+    while (i < size)
+    {
+        // Move everything up to and including the next 0xFF in one go
+        const char* ff = (const char*) memchr(data + i, 0xFF, size - i);
+        const int chunk = (ff == NULL ? size : ff - data + 1) - i;
+        if (out != i) memmove(data + out, data + i, chunk);
+        out += chunk;
+        i += chunk;
+
+        // and drop the 0x00 that was inserted after it
+        if (ff != NULL && i < size && data[i] == 0x00) i++;
+    }
+
+    return out;
+}
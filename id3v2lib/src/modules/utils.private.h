@@ -20,5 +20,8 @@ int syncint_encode(int value);
 unsigned int syncint_decode(int value);
 int clamp_int(const int value, const int min, const int max);
 bool string_has_bom(const char* string);
+int strnlent(const char* string, const int max_size, const char encoding);
+char* string_copy_terminated(const char* string, const int size);
+int unsync_decode(char* data, const int size);
 
 #endif
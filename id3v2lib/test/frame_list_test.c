@@ -0,0 +1,114 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+
+#define COMMENT_COUNT 300
+
+static void add_comments(ID3v2_Tag* tag)
+{
+    char comment[16];
+
+    for (int i = 0; i < COMMENT_COUNT; i++)
+    {
+        sprintf(comment, "c%d", i);
+        ID3v2_Tag_add_comment_frame(
+            tag,
+            &(ID3v2_CommentFrameInput){
+                .flags = "\0\0",
+                .language = "eng",
+                .short_description = "",
+                .comment = comment,
+            }
+        );
+    }
+}
+
+static void assert_comment(ID3v2_Frame* frame, const int number)
+{
+    char comment[16];
+    sprintf(comment, "c%d", number);
+    assert(frame != NULL);
+    assert(strcmp(((ID3v2_CommentFrame*) frame)->data->comment, comment) == 0);
+}
+
+void frame_list_test_many_frames()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "Title");
+    add_comments(tag);
+    ID3v2_Tag_set_artist(tag, "Artist");
+
+    assert(tag->frames->count == COMMENT_COUNT + 2);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "Title") == 0);
+    assert(strcmp(ID3v2_Tag_get_artist_frame(tag)->data->text, "Artist") == 0);
+    assert(ID3v2_Tag_get_album_frame(tag) == NULL);
+    assert_comment((ID3v2_Frame*) ID3v2_Tag_get_comment_frame(tag), 0);
+
+    // Frames with the same id come back in tag order
+    int position = -1;
+    for (int i = 0; i < COMMENT_COUNT; i++)
+    {
+        assert_comment(ID3v2_FrameList_next_by_id(tag->frames, ID3v2_COMMENT_FRAME_ID, &position), i);
+    }
+    assert(ID3v2_FrameList_next_by_id(tag->frames, ID3v2_COMMENT_FRAME_ID, &position) == NULL);
+
+    ID3v2_FrameList* comments = ID3v2_Tag_get_comment_frames(tag);
+    assert(comments->count == COMMENT_COUNT);
+    assert_comment(comments->frames[COMMENT_COUNT - 1], COMMENT_COUNT - 1);
+    ID3v2_FrameList_unlink(comments);
+
+    ID3v2_Tag_free(tag);
+
+    printf("FRAME LIST TEST MANY FRAMES: OK\n");
+}
+
+void frame_list_test_edit()
+{
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    add_comments(tag);
+    ID3v2_Tag_set_title(tag, "Title");
+
+    // Deleting keeps the order and the index of everything after it
+    ID3v2_Tag_delete_comment_frame(tag, 10);
+    assert(tag->frames->count == COMMENT_COUNT);
+    assert_comment(tag->frames->frames[10], 11);
+
+    int position = 9;
+    assert_comment(ID3v2_FrameList_next_by_id(tag->frames, ID3v2_COMMENT_FRAME_ID, &position), 11);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "Title") == 0);
+
+    // Replacing keeps the frame where it was
+    ID3v2_Tag_set_title(tag, "Other title");
+    assert(tag->frames->count == COMMENT_COUNT);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "Other title") == 0);
+    assert(ID3v2_Tag_get_title_frame(tag) == (ID3v2_TextFrame*) tag->frames->frames[COMMENT_COUNT - 1]);
+
+    ID3v2_Tag_delete_comment(tag);
+    assert_comment((ID3v2_Frame*) ID3v2_Tag_get_comment_frame(tag), 1);
+
+    ID3v2_Tag_delete_title(tag);
+    assert(ID3v2_Tag_get_title_frame(tag) == NULL);
+    assert(tag->frames->count == COMMENT_COUNT - 2);
+
+    ID3v2_Tag_free(tag);
+
+    printf("FRAME LIST TEST EDIT: OK\n");
+}
+
+void frame_list_test_main()
+{
+    frame_list_test_many_frames();
+    frame_list_test_edit();
+}
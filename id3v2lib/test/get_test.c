@@ -127,7 +127,7 @@ void get_test_existing()
 
     ID3v2_FrameList* comments = ID3v2_Tag_get_comment_frames(tag);
     assert_comment_frame(
-        (ID3v2_CommentFrame*) comments->frame,
+        (ID3v2_CommentFrame*) comments->frames[0],
         &(ID3v2_CommentFrameInput){
             .flags = "\0\0",
             .comment = comment,
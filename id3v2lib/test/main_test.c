@@ -11,8 +11,11 @@
 
 #include "compat_test.h"
 #include "delete_test.h"
+#include "frame_list_test.h"
 #include "get_test.h"
 #include "set_test.h"
+#include "view_test.h"
+#include "write_test.h"
 
 int main()
 {
@@ -20,4 +23,7 @@ int main()
     set_test_main();
     delete_test_main();
     compat_test_main();
+    view_test_main();
+    frame_list_test_main();
+    write_test_main();
 }
@@ -197,7 +197,7 @@ void edit_test()
 
     ID3v2_FrameList* comments = ID3v2_Tag_get_comment_frames(edited_tag);
     assert_comment_frame(
-        (ID3v2_CommentFrame*) comments->next->frame,
+        (ID3v2_CommentFrame*) comments->frames[1],
         &(ID3v2_CommentFrameInput){
             .flags = "\0\0",
             .language = "eng",
@@ -223,7 +223,7 @@ void edit_test()
 
     ID3v2_FrameList* apics = ID3v2_Tag_get_apic_frames(edited_tag);
     assert_apic_frame(
-        (ID3v2_ApicFrame*) apics->next->frame,
+        (ID3v2_ApicFrame*) apics->frames[1],
         &(ID3v2_ApicFrameInput){
             .flags = "\0\0",
             .mime_type = ID3v2_MIME_TYPE_PNG,
@@ -122,11 +122,10 @@ void print_comment_frames(ID3v2_FrameList* frames)
         return;
     }
 
-    while (frames != NULL)
+    for (int i = 0; i < frames->count; i++)
     {
-        ID3v2_CommentFrame* comment = (ID3v2_CommentFrame*) frames->frame;
+        ID3v2_CommentFrame* comment = (ID3v2_CommentFrame*) frames->frames[i];
         print_comment_frame(comment);
-        frames = frames->next;
     }
 }
 
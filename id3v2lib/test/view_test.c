@@ -0,0 +1,164 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+
+void view_test_existing()
+{
+    ID3v2_Tag* tag = ID3v2_read_tag("./extra/file.mp3");
+    ID3v2_TagView* view = ID3v2_read_tag_view("./extra/file.mp3");
+    assert(tag != NULL);
+    assert(view != NULL);
+
+    assert(view->header.major_version == tag->header->major_version);
+    assert(view->header.tag_size == tag->header->tag_size);
+
+    ID3v2_TextFrame* title = ID3v2_Tag_get_title_frame(tag);
+    ID3v2_TextFrame* view_title = ID3v2_FrameView_to_text_frame(ID3v2_TagView_get_frame(view, ID3v2_TITLE_FRAME_ID));
+    assert(view_title != NULL);
+    assert(view_title->header->size == title->header->size);
+    assert(view_title->data->encoding == title->data->encoding);
+    assert(view_title->data->size == title->data->size);
+    assert(memcmp(view_title->data->text, title->data->text, title->data->size) == 0);
+    ID3v2_Frame_free((ID3v2_Frame*) view_title);
+
+    ID3v2_CommentFrame* comment = ID3v2_Tag_get_comment_frame(tag);
+    ID3v2_CommentFrame* view_comment =
+        ID3v2_FrameView_to_comment_frame(ID3v2_TagView_get_frame(view, ID3v2_COMMENT_FRAME_ID));
+    assert(view_comment != NULL);
+    assert(memcmp(view_comment->data->language, comment->data->language, ID3v2_COMMENT_FRAME_LANGUAGE_LENGTH) == 0);
+    assert(memcmp(view_comment->data->comment, comment->data->comment, ID3v2_strlen(comment->data->comment)) == 0);
+    ID3v2_Frame_free((ID3v2_Frame*) view_comment);
+
+    ID3v2_ApicFrame* cover = ID3v2_Tag_get_album_cover_frame(tag);
+    int picture_size = 0;
+    const char* picture =
+        ID3v2_FrameView_get_picture(ID3v2_TagView_get_frame(view, ID3v2_ALBUM_COVER_FRAME_ID), &picture_size);
+    assert(picture_size == cover->data->picture_size);
+    assert(memcmp(picture, cover->data->data, picture_size) == 0);
+
+    assert(ID3v2_TagView_get_frame(view, "XXXX") == NULL);
+    assert(ID3v2_FrameView_to_comment_frame(ID3v2_TagView_get_frame(view, ID3v2_TITLE_FRAME_ID)) == NULL);
+
+    ID3v2_TagView_free(view);
+    ID3v2_Tag_free(tag);
+
+    printf("VIEW TEST EXISTING: OK\n");
+}
+
+void view_test_empty()
+{
+    assert(ID3v2_read_tag_view("./extra/no_tag.mp3") == NULL);
+    assert(ID3v2_read_tag_view("./extra/empty.mp3") == NULL);
+    assert(ID3v2_read_tag_view("./extra/does_not_exist.mp3") == NULL);
+
+    printf("VIEW TEST EMPTY: OK\n");
+}
+
+void view_test_unsynchronised_v3()
+{
+    // Whole tag unsynchronised: the 0xFF 0xE0 in the title is stored as 0xFF 0x00 0xE0
+    const char bytes[] = "ID3\x03\x00\x80\x00\x00\x00\x13"
+                         "TIT2\x00\x00\x00\x04\x00\x00"
+                         "\x00"
+                         "A\xFF\x00\xE0"
+                         "\x00\x00\x00\x00";
+
+    ID3v2_TagView* view = ID3v2_read_tag_view_from_buffer(bytes, sizeof(bytes) - 1);
+    assert(view != NULL);
+    assert(view->frame_count == 1);
+    assert(view->padding_size == 4);
+
+    const ID3v2_FrameView* title = ID3v2_TagView_get_frame(view, ID3v2_TITLE_FRAME_ID);
+    assert(title->size == 4);
+    assert(memcmp(title->data, "\x00" "A\xFF\xE0", 4) == 0);
+
+    // The caller's buffer is left as it was
+    assert(memcmp(bytes + 21, "A\xFF\x00\xE0", 4) == 0);
+
+    ID3v2_TagView_free(view);
+
+    printf("VIEW TEST UNSYNCHRONISED V3: OK\n");
+}
+
+void view_test_extended_header_v4()
+{
+    // 6 byte extended header, then a frame with a data length indicator and unsynchronisation
+    const char bytes[] = "ID3\x04\x00\x40\x00\x00\x00\x25"
+                         "\x00\x00\x00\x06\x01\x00"
+                         "TALB\x00\x00\x00\x09\x00\x03"
+                         "\x00\x00\x00\x04"
+                         "\x00"
+                         "B\xFF\x00\xF0"
+                         "TIT2\x00\x00\x00\x02\x00\x00"
+                         "\x00"
+                         "C";
+
+    ID3v2_TagView* view = ID3v2_read_tag_view_from_buffer(bytes, sizeof(bytes) - 1);
+    assert(view != NULL);
+    assert(view->header.extended_header_size == 6);
+    assert(view->frame_count == 2);
+    assert(view->padding_size == 0);
+
+    const ID3v2_FrameView* album = ID3v2_TagView_get_frame(view, ID3v2_ALBUM_FRAME_ID);
+    assert(album->size == 4);
+    assert(album->flags[1] == 0);
+    assert(memcmp(album->data, "\x00" "B\xFF\xF0", 4) == 0);
+
+    ID3v2_TextFrame* title = ID3v2_FrameView_to_text_frame(ID3v2_TagView_get_frame(view, ID3v2_TITLE_FRAME_ID));
+    assert(title->data->encoding == ID3v2_ENCODING_ISO);
+    assert(strcmp(title->data->text, "C") == 0);
+    ID3v2_Frame_free((ID3v2_Frame*) title);
+
+    ID3v2_TagView_free(view);
+
+    printf("VIEW TEST EXTENDED HEADER V4: OK\n");
+}
+
+void view_test_long_text_frame()
+{
+    // A 1500 byte title, longer than what mus copies out of a frame
+    char bytes[10 + 10 + 1500];
+    memcpy(bytes, "ID3\x03\x00\x00\x00\x00\x0B\x66", 10);
+    memcpy(bytes + 10, "TIT2\x00\x00\x05\xDC\x00\x00", 10);
+    bytes[20] = ID3v2_ENCODING_ISO;
+    memset(bytes + 21, 'x', 1499);
+
+    ID3v2_TagView* view = ID3v2_read_tag_view_from_buffer(bytes, sizeof(bytes));
+    assert(view != NULL);
+    assert(view->frame_count == 1);
+
+    const ID3v2_FrameView* title = ID3v2_TagView_get_frame(view, ID3v2_TITLE_FRAME_ID);
+    assert(title->size == 1500);
+    assert(title->data[0] == ID3v2_ENCODING_ISO);
+    assert(title->data[1] == 'x' && title->data[1499] == 'x');
+
+    ID3v2_TextFrame* text = ID3v2_FrameView_to_text_frame(title);
+    assert(text != NULL);
+    assert(strlen(text->data->text) == 1499);
+    ID3v2_Frame_free((ID3v2_Frame*) text);
+
+    ID3v2_TagView_free(view);
+
+    printf("VIEW TEST LONG TEXT FRAME: OK\n");
+}
+
+void view_test_main()
+{
+    view_test_existing();
+    view_test_empty();
+    view_test_unsynchronised_v3();
+    view_test_extended_header_v4();
+    view_test_long_text_frame();
+}
@@ -0,0 +1,141 @@
+/*
+ * This file is part of id3v2lib library
+ *
+ * Copyright (c) Lars Ruiz
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "id3v2lib.h"
+
+#include "write_test.h"
+
+#define WRITE_FILE "extra/write_test.mp3"
+#define AUDIO_LENGTH (300 * 1024)
+
+static char* read_file(const char* file_name, long* size)
+{
+    FILE* fp = fopen(file_name, "rb");
+    assert(fp != NULL);
+    fseek(fp, 0L, SEEK_END);
+    *size = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    char* data = (char*) malloc(*size);
+    assert(fread(data, 1, *size, fp) == (size_t) *size);
+    fclose(fp);
+    return data;
+}
+
+/**
+ * Checks the file is a tag of tag_size bytes followed by the untouched audio.
+ */
+static void assert_audio_after_tag(const char* audio, const long tag_size)
+{
+    long size = 0;
+    char* data = read_file(WRITE_FILE, &size);
+    assert(size == tag_size + AUDIO_LENGTH);
+    assert(memcmp(data + tag_size, audio, AUDIO_LENGTH) == 0);
+    free(data);
+}
+
+static long tag_size_on_disk()
+{
+    ID3v2_TagHeader* header = ID3v2_read_tag_header(WRITE_FILE);
+    if (header == NULL) return 0;
+    const long size = header->tag_size + ID3v2_TAG_HEADER_LENGTH;
+    ID3v2_TagHeader_free(header);
+    return size;
+}
+
+void write_test_main()
+{
+    // Something that looks like mpeg frames, with a byte pattern that shows any shift
+    char* audio = (char*) malloc(AUDIO_LENGTH);
+    for (int i = 0; i < AUDIO_LENGTH; i++)
+    {
+        audio[i] = (char) (i % 251);
+    }
+    audio[0] = (char) 0xFF;
+    audio[1] = (char) 0xFB;
+
+    FILE* fp = fopen(WRITE_FILE, "wb");
+    fwrite(audio, 1, AUDIO_LENGTH, fp);
+    fclose(fp);
+
+    // No tag yet, the audio has to move and padding is added
+    ID3v2_Tag* tag = ID3v2_Tag_new_empty();
+    ID3v2_Tag_set_title(tag, "A title");
+    assert(ID3v2_write_tag(WRITE_FILE, tag) == 0);
+    ID3v2_Tag_free(tag);
+
+    const long first_size = tag_size_on_disk();
+    assert(first_size > ID3v2_TAG_DEFAULT_PADDING_LENGTH);
+    assert_audio_after_tag(audio, first_size);
+
+    // Small edits fit in the padding and are written in place
+    tag = ID3v2_read_tag(WRITE_FILE);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "A title") == 0);
+    ID3v2_Tag_set_title(tag, "A longer title than before");
+    ID3v2_Tag_set_artist(tag, "Artist");
+    assert(ID3v2_write_tag(WRITE_FILE, tag) == 0);
+    ID3v2_Tag_free(tag);
+
+    assert(tag_size_on_disk() == first_size);
+    assert_audio_after_tag(audio, first_size);
+
+    tag = ID3v2_read_tag(WRITE_FILE);
+    assert(strcmp(ID3v2_Tag_get_title_frame(tag)->data->text, "A longer title than before") == 0);
+    assert(strcmp(ID3v2_Tag_get_artist_frame(tag)->data->text, "Artist") == 0);
+    assert(tag->padding_size > 0);
+
+    // A cover bigger than the padding doesn't fit, the file is rewritten
+    char* cover = (char*) calloc(8 * 1024, 1);
+    ID3v2_Tag_set_album_cover(tag, ID3v2_MIME_TYPE_PNG, 8 * 1024, cover);
+    assert(ID3v2_write_tag(WRITE_FILE, tag) == 0);
+    ID3v2_Tag_free(tag);
+    free(cover);
+
+    const long second_size = tag_size_on_disk();
+    assert(second_size > first_size);
+    assert_audio_after_tag(audio, second_size);
+
+    tag = ID3v2_read_tag(WRITE_FILE);
+    assert(ID3v2_Tag_get_album_cover_frame(tag)->data->picture_size == 8 * 1024);
+    assert(strcmp(ID3v2_Tag_get_artist_frame(tag)->data->text, "Artist") == 0);
+
+    // v2.4 frame sizes are sync safe, the cover is big enough for that to matter
+    tag->header->major_version = 4;
+    assert(ID3v2_write_tag(WRITE_FILE, tag) == 0);
+    ID3v2_Tag_free(tag);
+
+    tag = ID3v2_read_tag(WRITE_FILE);
+    assert(tag->header->major_version == 4);
+    assert(ID3v2_Tag_get_album_cover_frame(tag)->data->picture_size == 8 * 1024);
+    assert(strcmp(ID3v2_Tag_get_artist_frame(tag)->data->text, "Artist") == 0);
+
+    ID3v2_TagView* view = ID3v2_read_tag_view(WRITE_FILE);
+    int picture_size = 0;
+    ID3v2_FrameView_get_picture(ID3v2_TagView_get_frame(view, ID3v2_ALBUM_COVER_FRAME_ID), &picture_size);
+    assert(picture_size == 8 * 1024);
+    ID3v2_TagView_free(view);
+
+    // Nothing to write to
+    assert(ID3v2_write_tag("extra/no_such_dir/write_test.mp3", tag) == -1);
+    ID3v2_Tag_free(tag);
+
+    // Deleting leaves only the audio
+    assert(ID3v2_delete_tag(WRITE_FILE) == 0);
+    assert(ID3v2_read_tag(WRITE_FILE) == NULL);
+    assert_audio_after_tag(audio, 0);
+
+    remove(WRITE_FILE);
+    free(audio);
+
+    printf("WRITE TEST: OK\n");
+}
@@ -184,6 +184,21 @@ typedef struct tagBITMAPINFOHEADER {
 #include <stdio.h>                      // Required for: FILE, fopen(), fclose(), fread()
 #include <string.h>                     // Required for: strcmp() [Used in IsFileExtension(), LoadWaveFromMemory(), LoadMusicStreamFromMemory()]
 
+// Mixing and sample conversion kernels use SIMD when the target has it, define RAUDIO_NO_SIMD to use the scalar loops
+#if !defined(RAUDIO_NO_SIMD)
+    #if defined(__AVX2__)
+        #define RAUDIO_AVX2
+        #include <immintrin.h>              // Required for: AVX2 intrinsics [Used in MixFramesStereo(), ConvertFramesS16ToF32()]
+    #endif
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+        #define RAUDIO_SSE2
+        #include <emmintrin.h>              // Required for: SSE2 intrinsics
+    #elif defined(__ARM_NEON) || defined(_M_ARM64)
+        #define RAUDIO_NEON
+        #include <arm_neon.h>               // Required for: NEON intrinsics
+    #endif
+#endif
+
 #if defined(RAUDIO_STANDALONE)
     #ifndef TRACELOG
         #define TRACELOG(level, ...)    printf(__VA_ARGS__)
@@ -298,6 +313,15 @@ typedef struct tagBITMAPINFOHEADER {
 #ifndef MAX_AUDIO_BUFFER_POOL_CHANNELS
     #define MAX_AUDIO_BUFFER_POOL_CHANNELS    16    // Audio pool channels
 #endif
+#ifndef AUDIO_CACHE_SEGMENT_FRAMES
+    #define AUDIO_CACHE_SEGMENT_FRAMES     16384    // Decoded music frames per cache segment
+#endif
+#ifndef AUDIO_CACHE_BUCKETS
+    #define AUDIO_CACHE_BUCKETS              256    // Hash buckets of the decoded music cache
+#endif
+#ifndef AUDIO_FADE_STEP_FRAMES
+    #define AUDIO_FADE_STEP_FRAMES            64    // Frames mixed at most with one linear gain ramp while a crossfade runs
+#endif
 
 //----------------------------------------------------------------------------------
 // Types and Structures Definition
@@ -338,6 +362,13 @@ typedef enum {
     AUDIO_BUFFER_USAGE_STREAM
 } AudioBufferUsage;
 
+// Part an audio buffer plays in a crossfade, see CrossfadeMusicStream()
+typedef enum {
+    AUDIO_FADE_NONE = 0,
+    AUDIO_FADE_IN,                  // Waits for fadeStart, then rises to full level over fadeLength
+    AUDIO_FADE_OUT                  // Falls to silence over fadeLength from fadeStart, then stops
+} AudioFadeRole;
+
 // Audio buffer struct
 struct rAudioBuffer {
     ma_data_converter converter;    // Audio data converter
@@ -348,16 +379,28 @@ struct rAudioBuffer {
     float volume;                   // Audio buffer volume
     float pitch;                    // Audio buffer pitch
     float pan;                      // Audio buffer pan (0.0f to 1.0f)
+    float mixLevels[2];             // Channel levels of the last mix, volume and pan changes ramp from them
 
     bool playing;                   // Audio buffer state: AUDIO_PLAYING
     bool paused;                    // Audio buffer state: AUDIO_PAUSED
     bool looping;                   // Audio buffer looping, default to true for AudioStreams
+    bool draining;                  // Stream got its last frames, stops once they are played
+    unsigned int drainEnd;          // Frame position right after the last frame of a draining stream
+    int fade;                       // Crossfade role: AUDIO_FADE_NONE, AUDIO_FADE_IN or AUDIO_FADE_OUT
+    ma_uint64 fadeStart;            // Device frame (see frameClock) the crossfade starts at
+    ma_uint32 fadeLength;           // Crossfade length in device frames, 0 for a gapless switch
     int usage;                      // Audio buffer usage mode: STATIC or STREAM
 
     bool isSubBufferProcessed[2];   // SubBuffer processed (virtual double buffer)
     unsigned int sizeInFrames;      // Total buffer size in frames
     unsigned int frameCursorPos;    // Frame cursor position
     unsigned int framesProcessed;   // Total frames processed in this buffer (required for play timing)
+    unsigned long long cacheKey;    // Music streams: track its decoded frames are cached under, 0 for none
+    unsigned int decoderPosition;   // Music streams: next frame the decoder reads, behind framesProcessed while frames come from the cache
+
+    // Snapshots for other threads, written with the mutex locked and read without it (see PublishAudioBufferInLockedState())
+    ma_uint32 publishedPosition;    // Frames played: framesProcessed less the queued frames, as an int (may be negative or past the end)
+    ma_uint32 publishedPlaying;     // Audio buffer state: playing and not paused
 
     unsigned char *data;            // Data buffer, on music stream keeps filling
 
@@ -375,6 +418,22 @@ struct rAudioProcessor {
 
 #define AudioBuffer rAudioBuffer    // HACK: To avoid CoreAudio (macOS) symbol collision
 
+// Decoded music cache segment
+// NOTE: Holds frames [index*AUDIO_CACHE_SEGMENT_FRAMES, index*AUDIO_CACHE_SEGMENT_FRAMES + frames) of a track
+typedef struct rMusicCacheSegment rMusicCacheSegment;
+struct rMusicCacheSegment {
+    unsigned long long key;         // Track, see SetMusicStreamCacheKey()
+    unsigned int index;             // Segment of the track
+    unsigned int frames;            // Frames held, from the start of the segment
+    ma_format format;               // ma_format_s16 or ma_format_f32
+    unsigned int channels;          // Channels of the frames
+    void *data;                     // Room for AUDIO_CACHE_SEGMENT_FRAMES frames
+
+    rMusicCacheSegment *hashNext;   // Next segment in the same hash bucket
+    rMusicCacheSegment *next;       // Less recently used segment
+    rMusicCacheSegment *prev;       // More recently used segment
+};
+
 // Audio data context
 typedef struct AudioData {
     struct {
@@ -382,14 +441,30 @@ typedef struct AudioData {
         ma_device device;           // miniaudio device
         ma_mutex lock;              // miniaudio mutex lock
         bool isReady;               // Check if audio device is ready
+        ma_uint32 requestedSampleRate; // Sample rate the device was opened with, 0 for its default
+        ma_uint32 requestedPeriodSize; // Period size the device was opened with, 0 for its default
+        ma_uint64 frameClock;       // Frames sent to the device so far, crossfades are scheduled on it
         size_t pcmBufferSize;       // Pre-allocated buffer size
         void *pcmBuffer;            // Pre-allocated buffer to read audio data from file/memory
     } System;
+    struct {
+        ma_timer timer;             // Started with the device, times the callbacks
+        double lastCallback;        // Time of the previous callback, 0 when there is none on this device
+        AudioStats counters;        // Counters returned by GetAudioDeviceStats()
+    } Stats;
     struct {
         AudioBuffer *first;         // Pointer to first AudioBuffer in the list
         AudioBuffer *last;          // Pointer to last AudioBuffer in the list
         int defaultSize;            // Default audio buffer size for audio streams
     } Buffer;
+    struct {
+        unsigned int sizeLimit;     // Bytes of decoded frames kept at most, 0 disables the cache
+        unsigned int size;          // Bytes of decoded frames kept
+        bool compact;               // Float frames are kept as 16 bit
+        rMusicCacheSegment *buckets[AUDIO_CACHE_BUCKETS];
+        rMusicCacheSegment *first;  // Most recently used segment
+        rMusicCacheSegment *last;   // Least recently used segment, the first one evicted
+    } Cache;
     rAudioProcessor *mixedProcessor;
 } AudioData;
 
@@ -410,18 +485,43 @@ static AudioData AUDIO = {          // Global AUDIO context
 // Module specific Functions Declaration
 //----------------------------------------------------------------------------------
 static void OnLog(void *pUserData, ma_uint32 level, const char *pMessage);
+static ma_result InitPlaybackDevice(ma_uint32 sampleRate, ma_uint32 periodSize);
+static void ReopenPlaybackDevice(ma_uint32 sampleRate, ma_uint32 periodSize);
 
 // Reads audio data from an AudioBuffer object in internal/device formats
 static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer, void *framesOut, ma_uint32 frameCount);
 static ma_uint32 ReadAudioBufferFramesInMixingFormat(AudioBuffer *audioBuffer, float *framesOut, ma_uint32 frameCount);
 
 static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const void *pFramesInput, ma_uint32 frameCount);
-static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, AudioBuffer *buffer);
+static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, AudioBuffer *buffer, ma_uint64 position);
+static float GetAudioBufferFadeGain(AudioBuffer *buffer, ma_uint64 position);
+static void MixFramesStereo(float *framesOut, const float *framesIn, ma_uint32 frameCount, const float *levelsFrom, const float *levelsTo);
+static void MixSamples(float *samplesOut, const float *samplesIn, ma_uint32 sampleCount, float volume);
+static void ConvertSamplesS16ToF32(float *samplesOut, const short *samplesIn, ma_uint32 sampleCount);
 
 static bool IsAudioBufferPlayingInLockedState(AudioBuffer *buffer);
+static int GetAudioBufferPositionInLockedState(AudioBuffer *buffer);
+static void PublishAudioBufferInLockedState(AudioBuffer *buffer);
 static void StopAudioBufferInLockedState(AudioBuffer *buffer);
 static void UpdateAudioStreamInLockedState(AudioStream stream, const void *data, int frameCount);
 
+// Decoding music streams, and the cache of decoded frames kept for replays and seeks back
+static void ReadMusicStreamDecoder(Music music, void *framesOut, unsigned int frameCount);
+static unsigned int SeekMusicStreamDecoder(Music music, unsigned int positionInFrames);
+#if defined(SUPPORT_FILEFORMAT_MP3)
+static bool MoveMp3DecoderToMemory(drmp3 *mp3, const unsigned char *data, int dataSize);
+#endif
+static bool IsMusicStreamCacheable(Music music);
+static void ReadMusicStreamFrames(Music music, void *framesOut, unsigned int position, unsigned int frameCount);
+static unsigned int ReadMusicCacheInLockedState(Music music, void *framesOut, unsigned int position, unsigned int frameCount);
+static void WriteMusicCacheInLockedState(Music music, const void *framesIn, unsigned int position, unsigned int frameCount);
+static rMusicCacheSegment **GetMusicCacheBucket(unsigned long long key, unsigned int index);
+static rMusicCacheSegment *FindMusicCacheSegment(unsigned long long key, unsigned int index);
+static rMusicCacheSegment *LoadMusicCacheSegment(unsigned long long key, unsigned int index, ma_format format, unsigned int channels);
+static void UnloadMusicCacheSegment(rMusicCacheSegment *segment);
+static void TouchMusicCacheSegment(rMusicCacheSegment *segment);
+static void TrimMusicCache(unsigned int size);
+
 #if defined(RAUDIO_STANDALONE)
 static bool IsFileExtension(const char *fileName, const char *ext); // Check file extension
 static const char *GetFileExtension(const char *fileName);          // Get pointer to extension for a filename string (includes the dot: .png)
@@ -470,19 +570,7 @@ void InitAudioDevice(void)
     }
 
     // Init audio device
-    // NOTE: Using the default device. Format is floating point because it simplifies mixing
-    ma_device_config config = ma_device_config_init(ma_device_type_playback);
-    config.playback.pDeviceID = NULL;  // NULL for the default playback AUDIO.System.device
-    config.playback.format = AUDIO_DEVICE_FORMAT;
-    config.playback.channels = AUDIO_DEVICE_CHANNELS;
-    config.capture.pDeviceID = NULL;  // NULL for the default capture AUDIO.System.device
-    config.capture.format = ma_format_s16;
-    config.capture.channels = 1;
-    config.sampleRate = AUDIO_DEVICE_SAMPLE_RATE;
-    config.dataCallback = OnSendAudioDataToDevice;
-    config.pUserData = NULL;
-
-    result = ma_device_init(&AUDIO.System.context, &config, &AUDIO.System.device);
+    result = InitPlaybackDevice(AUDIO_DEVICE_SAMPLE_RATE, 0);
     if (result != MA_SUCCESS)
     {
         TRACELOG(LOG_WARNING, "AUDIO: Failed to initialize playback device");
@@ -502,6 +590,8 @@ void InitAudioDevice(void)
 
     // Keep the device running the whole time. May want to consider doing something a bit smarter and only have the device running
     // while there's at least one sound being played
+    ma_timer_init(&AUDIO.Stats.timer);
+
     result = ma_device_start(&AUDIO.System.device);
     if (result != MA_SUCCESS)
     {
@@ -526,6 +616,7 @@ void CloseAudioDevice(void)
 {
     if (AUDIO.System.isReady)
     {
+        TrimMusicCache(0);
         ma_mutex_uninit(&AUDIO.System.lock);
         ma_device_uninit(&AUDIO.System.device);
         ma_context_uninit(&AUDIO.System.context);
@@ -546,6 +637,45 @@ bool IsAudioDeviceReady(void)
     return AUDIO.System.isReady;
 }
 
+// Reopen audio device at a different sample rate, 0 for the device default
+// NOTE: Playing buffers keep playing, their converters are rebuilt for the new rate,
+// so a stream at the device rate skips resampling altogether
+void SetAudioDeviceSampleRate(unsigned int sampleRate)
+{
+    if (!AUDIO.System.isReady) return;
+
+    // A request for the default rate only reopens when the current rate was requested explicitly
+    if ((sampleRate != 0) && (sampleRate == AUDIO.System.device.sampleRate)) return;
+    if ((sampleRate == 0) && (AUDIO.System.requestedSampleRate == 0)) return;
+
+    ReopenPlaybackDevice(sampleRate, AUDIO.System.requestedPeriodSize);
+}
+
+// Reopen audio device with a different period size in frames, 0 for the device default
+// NOTE: Larger periods wake the device less often, smaller ones answer sooner
+void SetAudioDevicePeriodSize(unsigned int frames)
+{
+    if (!AUDIO.System.isReady || (frames == AUDIO.System.requestedPeriodSize)) return;
+
+    ReopenPlaybackDevice(AUDIO.System.requestedSampleRate, frames);
+}
+
+// Get audio device sample rate, the one buffers are converted to
+unsigned int GetAudioDeviceSampleRate(void)
+{
+    return AUDIO.System.device.sampleRate;
+}
+
+// Get audio device playback counters
+AudioStats GetAudioDeviceStats(void)
+{
+    ma_mutex_lock(&AUDIO.System.lock);
+    AudioStats stats = AUDIO.Stats.counters;
+    ma_mutex_unlock(&AUDIO.System.lock);
+
+    return stats;
+}
+
 // Set master volume (listener)
 void SetMasterVolume(float volume)
 {
@@ -594,6 +724,8 @@ AudioBuffer *LoadAudioBuffer(ma_format format, ma_uint32 channels, ma_uint32 sam
     audioBuffer->volume = 1.0f;
     audioBuffer->pitch = 1.0f;
     audioBuffer->pan = 0.5f;
+    audioBuffer->mixLevels[0] = -1.0f;  // Nothing mixed yet, the first mix starts at its own levels
+    audioBuffer->mixLevels[1] = -1.0f;
 
     audioBuffer->callback = NULL;
     audioBuffer->processor = NULL;
@@ -630,12 +762,11 @@ void UnloadAudioBuffer(AudioBuffer *buffer)
 }
 
 // Check if an audio buffer is playing from a program state without lock
+// NOTE: Reads the published state, so polling it every frame never waits on the audio thread
 bool IsAudioBufferPlaying(AudioBuffer *buffer)
 {
     bool result = false;
-    ma_mutex_lock(&AUDIO.System.lock);
-    result = IsAudioBufferPlayingInLockedState(buffer);
-    ma_mutex_unlock(&AUDIO.System.lock);
+    if (buffer != NULL) result = ma_atomic_load_explicit_32(&buffer->publishedPlaying, ma_atomic_memory_order_acquire);
     return result;
 }
 
@@ -650,6 +781,8 @@ void PlayAudioBuffer(AudioBuffer *buffer)
         buffer->playing = true;
         buffer->paused = false;
         buffer->frameCursorPos = 0;
+        buffer->fade = AUDIO_FADE_NONE;
+        PublishAudioBufferInLockedState(buffer);
         ma_mutex_unlock(&AUDIO.System.lock);
     }
 }
@@ -669,6 +802,7 @@ void PauseAudioBuffer(AudioBuffer *buffer)
     {
         ma_mutex_lock(&AUDIO.System.lock);
         buffer->paused = true;
+        PublishAudioBufferInLockedState(buffer);
         ma_mutex_unlock(&AUDIO.System.lock);
     }
 }
@@ -680,6 +814,7 @@ void ResumeAudioBuffer(AudioBuffer *buffer)
     {
         ma_mutex_lock(&AUDIO.System.lock);
         buffer->paused = false;
+        PublishAudioBufferInLockedState(buffer);
         ma_mutex_unlock(&AUDIO.System.lock);
     }
 }
@@ -1745,7 +1880,7 @@ void UnloadMusicStream(Music music)
     {
         if (false) { }
 #if defined(SUPPORT_FILEFORMAT_WAV)
-        else if (music.ctxType == MUSIC_AUDIO_WAV) drwav_uninit((drwav *)music.ctxData);
+        else if (music.ctxType == MUSIC_AUDIO_WAV) { drwav_uninit((drwav *)music.ctxData); RL_FREE(music.ctxData); }
 #endif
 #if defined(SUPPORT_FILEFORMAT_OGG)
         else if (music.ctxType == MUSIC_AUDIO_OGG) stb_vorbis_close((stb_vorbis *)music.ctxData);
@@ -1816,6 +1951,8 @@ void StopMusicStream(Music music)
 #endif
         default: break;
     }
+
+    if (music.stream.buffer != NULL) music.stream.buffer->decoderPosition = 0;
 }
 
 // Seek music to a certain position (in seconds)
@@ -1826,46 +1963,136 @@ void SeekMusicStream(Music music, float position)
 
     unsigned int positionInFrames = (unsigned int)(position*music.stream.sampleRate);
 
-    switch (music.ctxType)
-    {
-#if defined(SUPPORT_FILEFORMAT_WAV)
-        case MUSIC_AUDIO_WAV: drwav_seek_to_pcm_frame((drwav *)music.ctxData, positionInFrames); break;
-#endif
-#if defined(SUPPORT_FILEFORMAT_OGG)
-        case MUSIC_AUDIO_OGG: stb_vorbis_seek_frame((stb_vorbis *)music.ctxData, positionInFrames); break;
-#endif
-#if defined(SUPPORT_FILEFORMAT_MP3)
-        case MUSIC_AUDIO_MP3: drmp3_seek_to_pcm_frame((drmp3 *)music.ctxData, positionInFrames); break;
-#endif
-#if defined(SUPPORT_FILEFORMAT_QOA)
-        case MUSIC_AUDIO_QOA:
-        {
-            int qoaFrame = positionInFrames/QOA_FRAME_LEN;
-            qoaplay_seek_frame((qoaplay_desc *)music.ctxData, qoaFrame); // Seeks to QOA frame, not PCM frame
+    // Cached frames play without moving the decoder, UpdateMusicStream() moves it once they run out
+    ma_mutex_lock(&AUDIO.System.lock);
+    bool cached = IsMusicStreamCacheable(music) && (ReadMusicCacheInLockedState(music, NULL, positionInFrames, 1) > 0);
+    ma_mutex_unlock(&AUDIO.System.lock);
 
-            // We need to compute QOA frame number and update positionInFrames
-            positionInFrames = ((qoaplay_desc *)music.ctxData)->sample_position;
-        } break;
-#endif
-#if defined(SUPPORT_FILEFORMAT_FLAC)
-        case MUSIC_AUDIO_FLAC: drflac_seek_to_pcm_frame((drflac *)music.ctxData, positionInFrames); break;
-#endif
-        default: break;
-    }
+    if (!cached) positionInFrames = SeekMusicStreamDecoder(music, positionInFrames);
 
     ma_mutex_lock(&AUDIO.System.lock);
     music.stream.buffer->framesProcessed = positionInFrames;
     music.stream.buffer->isSubBufferProcessed[0] = true;
     music.stream.buffer->isSubBufferProcessed[1] = true;
+    music.stream.buffer->draining = false;
+    PublishAudioBufferInLockedState(music.stream.buffer);
     ma_mutex_unlock(&AUDIO.System.lock);
 }
 
-// Update (re-fill) music buffers if data already processed
-void UpdateMusicStream(Music music)
+// Crossfade from a playing music stream into another one, filled and not yet playing
+// NOTE: to starts on the exact device frame where from has seconds left, whenever the program comes around next,
+// the two crossfading with equal power; with 0 seconds to starts right after the last frame of from (gapless)
+void CrossfadeMusicStream(Music from, Music to, float seconds)
+{
+    if ((from.stream.buffer == NULL) || (to.stream.buffer == NULL) || (from.frameCount == 0)) return;
+
+    ma_mutex_lock(&AUDIO.System.lock);
+
+    // Frames from has left to play, as device frames: the converter changes its rate (and pitch)
+    int framesPlayed = GetAudioBufferPositionInLockedState(from.stream.buffer)%(int)from.frameCount;
+    if (framesPlayed < 0) framesPlayed += from.frameCount;
+    ma_uint64 framesLeft = (ma_uint64)(from.frameCount - framesPlayed)*from.stream.buffer->converter.sampleRateOut/from.stream.buffer->converter.sampleRateIn;
+    if (!from.stream.buffer->playing) framesLeft = 0;
+
+    ma_uint64 fadeLength = (ma_uint64)(seconds*AUDIO.System.device.sampleRate);
+    if (fadeLength > framesLeft) fadeLength = framesLeft;
+
+    from.stream.buffer->fade = AUDIO_FADE_OUT;
+    from.stream.buffer->fadeStart = AUDIO.System.frameClock + framesLeft - fadeLength;
+    from.stream.buffer->fadeLength = (ma_uint32)fadeLength;
+
+    to.stream.buffer->fade = AUDIO_FADE_IN;
+    to.stream.buffer->fadeStart = from.stream.buffer->fadeStart;
+    to.stream.buffer->fadeLength = (ma_uint32)fadeLength;
+    to.stream.buffer->playing = true;
+    to.stream.buffer->paused = false;
+
+    PublishAudioBufferInLockedState(from.stream.buffer);
+    PublishAudioBufferInLockedState(to.stream.buffer);
+    ma_mutex_unlock(&AUDIO.System.lock);
+}
+
+// Cancel the crossfade of a music stream: fading out, it plays on at its own volume
+// NOTE: A stream still waiting to fade in should be stopped instead
+void CancelMusicStreamCrossfade(Music music)
+{
+    if (music.stream.buffer == NULL) return;
+
+    ma_mutex_lock(&AUDIO.System.lock);
+    music.stream.buffer->fade = AUDIO_FADE_NONE;
+    ma_mutex_unlock(&AUDIO.System.lock);
+}
+
+// Set the track a music stream plays: its frames are cached under key once decoded, and the frames
+// of earlier streams with the same key play from the cache instead of being decoded again
+// NOTE: The key must change whenever the data does, 0 leaves the stream out of the cache
+void SetMusicStreamCacheKey(Music music, unsigned long long key)
 {
     if (music.stream.buffer == NULL) return;
 
     ma_mutex_lock(&AUDIO.System.lock);
+    music.stream.buffer->cacheKey = key;
+    ma_mutex_unlock(&AUDIO.System.lock);
+}
+
+// Set the bytes of decoded music kept for replays and seeks back, 0 (the default) disables the cache
+// NOTE: The least recently played frames go first, compact keeps float data as 16 bit, which holds twice as much
+void SetMusicCacheSize(unsigned int size, bool compact)
+{
+    ma_mutex_lock(&AUDIO.System.lock);
+    AUDIO.Cache.sizeLimit = size;
+    AUDIO.Cache.compact = compact;
+    TrimMusicCache(size);
+    ma_mutex_unlock(&AUDIO.System.lock);
+}
+
+// Move a music stream onto data holding the same track (the file it streams read into memory, for example)
+// NOTE: Only the decoder is replaced, at the frame the old one was at: the frames already queued play on
+// and the next UpdateMusicStream() reads from data, which has to outlive the stream; false leaves it as it was
+// NOTE: An MP3 decoder has no seek table, it would decode everything up to that frame again, so a streamed
+// one reads on from data at the byte it got to instead; the other formats seek without decoding much
+bool SetMusicStreamData(Music *music, const char *fileType, const unsigned char *data, int dataSize)
+{
+    if ((music == NULL) || (music->stream.buffer == NULL)) return false;
+
+#if defined(SUPPORT_FILEFORMAT_MP3)
+    if (music->ctxType == MUSIC_AUDIO_MP3)
+    {
+        if ((strcmp(fileType, ".mp3") != 0) && (strcmp(fileType, ".MP3") != 0)) return false;
+        return MoveMp3DecoderToMemory((drmp3 *)music->ctxData, data, dataSize);
+    }
+#endif
+
+    // Only formats that seek to exact frames continue seamlessly
+    if ((music->ctxType != MUSIC_AUDIO_WAV) && (music->ctxType != MUSIC_AUDIO_OGG) && (music->ctxType != MUSIC_AUDIO_MP3) && (music->ctxType != MUSIC_AUDIO_FLAC)) return false;
+
+    Music loaded = LoadMusicStreamFromMemory(fileType, data, dataSize);
+    if (loaded.ctxData == NULL) return false;
+
+    bool same = (loaded.ctxType == music->ctxType) && (loaded.frameCount == music->frameCount) &&
+        (loaded.stream.sampleRate == music->stream.sampleRate) && (loaded.stream.sampleSize == music->stream.sampleSize) &&
+        (loaded.stream.channels == music->stream.channels);
+
+    if (same)
+    {
+        // The old decoder goes with the stream loaded for the new one
+        void *ctxData = music->ctxData;
+        music->ctxData = loaded.ctxData;
+        loaded.ctxData = ctxData;
+        SeekMusicStreamDecoder(*music, music->stream.buffer->decoderPosition);
+    }
+
+    UnloadMusicStream(loaded);
+
+    return same;
+}
+
+// Update (re-fill) music buffers if data already processed
+// NOTE: Frames are decoded without the audio system mutex, the device plays the other sub-buffer meanwhile;
+// the decoder is only ever moved by the thread updating the stream, see SeekMusicStream()
+void UpdateMusicStream(Music music)
+{
+    if (music.stream.buffer == NULL) return;
 
     unsigned int subBufferSizeInFrames = music.stream.buffer->sizeInFrames/2;
 
@@ -1883,142 +2110,50 @@ void UpdateMusicStream(Music music)
     // Check both sub-buffers to check if they require refilling
     for (int i = 0; i < 2; i++)
     {
-        if (!music.stream.buffer->isSubBufferProcessed[i]) continue; // No refilling required, move to next sub-buffer
+        ma_mutex_lock(&AUDIO.System.lock);
+        bool processed = music.stream.buffer->isSubBufferProcessed[i];
+        bool draining = music.stream.buffer->draining;
+        unsigned int framesProcessed = music.stream.buffer->framesProcessed;
+        ma_mutex_unlock(&AUDIO.System.lock);
 
-        unsigned int framesLeft = music.frameCount - music.stream.buffer->framesProcessed;  // Frames left to be processed
+        if (draining) break;            // The last frames are already queued
+        if (!processed) continue;       // No refilling required, move to next sub-buffer
+
+        unsigned int framesLeft = music.frameCount - framesProcessed;  // Frames left to be processed
         unsigned int framesToStream = 0;                 // Total frames to be streamed
 
         if ((framesLeft >= subBufferSizeInFrames) || music.looping) framesToStream = subBufferSizeInFrames;
         else framesToStream = framesLeft;
 
-        int frameCountStillNeeded = framesToStream;
-        int frameCountReadTotal = 0;
-
-        switch (music.ctxType)
+        if (IsMusicStreamCacheable(music)) ReadMusicStreamFrames(music, AUDIO.System.pcmBuffer, framesProcessed, framesToStream);
+        else
         {
-        #if defined(SUPPORT_FILEFORMAT_WAV)
-            case MUSIC_AUDIO_WAV:
-            {
-                if (music.stream.sampleSize == 16)
-                {
-                    while (true)
-                    {
-                        int frameCountRead = (int)drwav_read_pcm_frames_s16((drwav *)music.ctxData, frameCountStillNeeded, (short *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize));
-                        frameCountReadTotal += frameCountRead;
-                        frameCountStillNeeded -= frameCountRead;
-                        if (frameCountStillNeeded == 0) break;
-                        else drwav_seek_to_first_pcm_frame((drwav *)music.ctxData);
-                    }
-                }
-                else if (music.stream.sampleSize == 32)
-                {
-                    while (true)
-                    {
-                        int frameCountRead = (int)drwav_read_pcm_frames_f32((drwav *)music.ctxData, frameCountStillNeeded, (float *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize));
-                        frameCountReadTotal += frameCountRead;
-                        frameCountStillNeeded -= frameCountRead;
-                        if (frameCountStillNeeded == 0) break;
-                        else drwav_seek_to_first_pcm_frame((drwav *)music.ctxData);
-                    }
-                }
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_OGG)
-            case MUSIC_AUDIO_OGG:
-            {
-                while (true)
-                {
-                    int frameCountRead = stb_vorbis_get_samples_short_interleaved((stb_vorbis *)music.ctxData, music.stream.channels, (short *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize), frameCountStillNeeded*music.stream.channels);
-                    frameCountReadTotal += frameCountRead;
-                    frameCountStillNeeded -= frameCountRead;
-                    if (frameCountStillNeeded == 0) break;
-                    else stb_vorbis_seek_start((stb_vorbis *)music.ctxData);
-                }
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_MP3)
-            case MUSIC_AUDIO_MP3:
-            {
-                while (true)
-                {
-                    int frameCountRead = (int)drmp3_read_pcm_frames_f32((drmp3 *)music.ctxData, frameCountStillNeeded, (float *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize));
-                    frameCountReadTotal += frameCountRead;
-                    frameCountStillNeeded -= frameCountRead;
-                    if (frameCountStillNeeded == 0) break;
-                    else drmp3_seek_to_start_of_stream((drmp3 *)music.ctxData);
-                }
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_QOA)
-            case MUSIC_AUDIO_QOA:
-            {
-                unsigned int frameCountRead = qoaplay_decode((qoaplay_desc *)music.ctxData, (float *)AUDIO.System.pcmBuffer, framesToStream);
-                frameCountReadTotal += frameCountRead;
-                /*
-                while (true)
-                {
-                    int frameCountRead = (int)qoaplay_decode((qoaplay_desc *)music.ctxData, (float *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize),  frameCountStillNeeded);
-                    frameCountReadTotal += frameCountRead;
-                    frameCountStillNeeded -= frameCountRead;
-                    if (frameCountStillNeeded == 0) break;
-                    else qoaplay_rewind((qoaplay_desc *)music.ctxData);
-                }
-                */
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_FLAC)
-            case MUSIC_AUDIO_FLAC:
-            {
-                while (true)
-                {
-                    int frameCountRead = (int)drflac_read_pcm_frames_s16((drflac *)music.ctxData, frameCountStillNeeded, (short *)((char *)AUDIO.System.pcmBuffer + frameCountReadTotal*frameSize));
-                    frameCountReadTotal += frameCountRead;
-                    frameCountStillNeeded -= frameCountRead;
-                    if (frameCountStillNeeded == 0) break;
-                    else drflac__seek_to_first_frame((drflac *)music.ctxData);
-                }
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_XM)
-            case MUSIC_MODULE_XM:
-            {
-                // NOTE: Internally we consider 2 channels generation, so sampleCount/2
-                if (AUDIO_DEVICE_FORMAT == ma_format_f32) jar_xm_generate_samples((jar_xm_context_t *)music.ctxData, (float *)AUDIO.System.pcmBuffer, framesToStream);
-                else if (AUDIO_DEVICE_FORMAT == ma_format_s16) jar_xm_generate_samples_16bit((jar_xm_context_t *)music.ctxData, (short *)AUDIO.System.pcmBuffer, framesToStream);
-                else if (AUDIO_DEVICE_FORMAT == ma_format_u8) jar_xm_generate_samples_8bit((jar_xm_context_t *)music.ctxData, (char *)AUDIO.System.pcmBuffer, framesToStream);
-                //jar_xm_reset((jar_xm_context_t *)music.ctxData);
-
-            } break;
-        #endif
-        #if defined(SUPPORT_FILEFORMAT_MOD)
-            case MUSIC_MODULE_MOD:
-            {
-                // NOTE: 3rd parameter (nbsample) specify the number of stereo 16bits samples you want, so sampleCount/2
-                jar_mod_fillbuffer((jar_mod_context_t *)music.ctxData, (short *)AUDIO.System.pcmBuffer, framesToStream, 0);
-                //jar_mod_seek_start((jar_mod_context_t *)music.ctxData);
-
-            } break;
-        #endif
-            default: break;
+            ReadMusicStreamDecoder(music, AUDIO.System.pcmBuffer, framesToStream);
+            music.stream.buffer->decoderPosition = (framesProcessed + framesToStream)%music.frameCount;
         }
 
+        ma_mutex_lock(&AUDIO.System.lock);
+
+        // The other sub-buffer may have been played meanwhile too, UpdateAudioStreamInLockedState() then fills the first one
+        unsigned int subBufferFilled = music.stream.buffer->isSubBufferProcessed[0]? 0 : 1;
         UpdateAudioStreamInLockedState(music.stream, AUDIO.System.pcmBuffer, framesToStream);
 
         music.stream.buffer->framesProcessed = music.stream.buffer->framesProcessed%music.frameCount;
 
-        if (framesLeft <= subBufferSizeInFrames)
+        bool ending = (framesLeft <= subBufferSizeInFrames) && !music.looping;
+        if (ending)
         {
-            if (!music.looping)
-            {
-                ma_mutex_unlock(&AUDIO.System.lock);
-                // Streaming is ending, we filled latest frames from input
-                StopMusicStream(music);
-                return;
-            }
+            // Streaming is ending, we filled latest frames from input
+            // NOTE: The stream stops itself once they are played, stopping it here would cut up to two sub-buffers
+            music.stream.buffer->draining = true;
+            music.stream.buffer->drainEnd = subBufferSizeInFrames*subBufferFilled + framesToStream;
         }
-    }
 
-    ma_mutex_unlock(&AUDIO.System.lock);
+        PublishAudioBufferInLockedState(music.stream.buffer);
+        ma_mutex_unlock(&AUDIO.System.lock);
+
+        if (ending) break;
+    }
 }
 
 // Check if any music is playing
@@ -2072,17 +2207,10 @@ float GetMusicTimePlayed(Music music)
         else
 #endif
         {
-            ma_mutex_lock(&AUDIO.System.lock);
-            //ma_uint32 frameSizeInBytes = ma_get_bytes_per_sample(music.stream.buffer->dsp.formatConverterIn.config.formatIn)*music.stream.buffer->dsp.formatConverterIn.config.channels;
-            int framesProcessed = (int)music.stream.buffer->framesProcessed;
-            int subBufferSize = (int)music.stream.buffer->sizeInFrames/2;
-            int framesInFirstBuffer = music.stream.buffer->isSubBufferProcessed[0]? 0 : subBufferSize;
-            int framesInSecondBuffer = music.stream.buffer->isSubBufferProcessed[1]? 0 : subBufferSize;
-            int framesSentToMix = music.stream.buffer->frameCursorPos%subBufferSize;
-            int framesPlayed = (framesProcessed - framesInFirstBuffer - framesInSecondBuffer + framesSentToMix)%(int)music.frameCount;
+            // NOTE: Reads the published position, the UI asks for it every frame and must not contend with the audio thread
+            int framesPlayed = (int)ma_atomic_load_explicit_32(&music.stream.buffer->publishedPosition, ma_atomic_memory_order_acquire)%(int)music.frameCount;
             if (framesPlayed < 0) framesPlayed += music.frameCount;
             secondsPlayed = (float)framesPlayed/music.stream.sampleRate;
-            ma_mutex_unlock(&AUDIO.System.lock);
         }
     }
 
@@ -2342,6 +2470,89 @@ static void OnLog(void *pUserData, ma_uint32 level, const char *pMessage)
     TRACELOG(LOG_WARNING, "miniaudio: %s", pMessage);   // All log messages from miniaudio are errors
 }
 
+// Initialize the playback device at a sample rate, 0 for the device default
+// NOTE: Using the default device. Format is floating point because it simplifies mixing
+static ma_result InitPlaybackDevice(ma_uint32 sampleRate, ma_uint32 periodSize)
+{
+    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    config.playback.pDeviceID = NULL;  // NULL for the default playback AUDIO.System.device
+    config.playback.format = AUDIO_DEVICE_FORMAT;
+    config.playback.channels = AUDIO_DEVICE_CHANNELS;
+    config.capture.pDeviceID = NULL;  // NULL for the default capture AUDIO.System.device
+    config.capture.format = ma_format_s16;
+    config.capture.channels = 1;
+    config.sampleRate = sampleRate;
+    config.periodSizeInFrames = periodSize;
+    config.dataCallback = OnSendAudioDataToDevice;
+    config.pUserData = NULL;
+
+    ma_result result = ma_device_init(&AUDIO.System.context, &config, &AUDIO.System.device);
+    if (result == MA_SUCCESS)
+    {
+        AUDIO.System.requestedSampleRate = sampleRate;
+        AUDIO.System.requestedPeriodSize = periodSize;
+    }
+
+    return result;
+}
+
+// Reopen the playback device, playing buffers are kept and converted to the new sample rate
+static void ReopenPlaybackDevice(ma_uint32 sampleRate, ma_uint32 periodSize)
+{
+    ma_uint32 previousSampleRate = AUDIO.System.requestedSampleRate;
+    ma_uint32 previousPeriodSize = AUDIO.System.requestedPeriodSize;
+    float volume = GetMasterVolume();
+
+    // Uninitializing waits for the device callback to return, so the lock must not be held here
+    ma_device_uninit(&AUDIO.System.device);
+
+    ma_result result = InitPlaybackDevice(sampleRate, periodSize);
+    if (result != MA_SUCCESS)
+    {
+        TRACELOG(LOG_WARNING, "AUDIO: Failed to reopen playback device (%i Hz, %i frames period)", sampleRate, periodSize);
+        result = InitPlaybackDevice(previousSampleRate, previousPeriodSize);
+    }
+
+    if (result != MA_SUCCESS)
+    {
+        TRACELOG(LOG_WARNING, "AUDIO: Failed to reopen playback device");
+        ma_mutex_uninit(&AUDIO.System.lock);
+        ma_context_uninit(&AUDIO.System.context);
+        AUDIO.System.isReady = false;
+        return;
+    }
+
+    ma_mutex_lock(&AUDIO.System.lock);
+    for (AudioBuffer *buffer = AUDIO.Buffer.first; buffer != NULL; buffer = buffer->next)
+    {
+        if (buffer->converter.sampleRateOut == AUDIO.System.device.sampleRate) continue;
+
+        // The converter points into itself, so it is rebuilt in place
+        ma_data_converter_config converterConfig = ma_data_converter_config_init(buffer->converter.formatIn, AUDIO_DEVICE_FORMAT, buffer->converter.channelsIn, AUDIO_DEVICE_CHANNELS, buffer->converter.sampleRateIn, AUDIO.System.device.sampleRate);
+        converterConfig.allowDynamicSampleRate = true;
+
+        ma_data_converter_uninit(&buffer->converter, NULL);
+        if (ma_data_converter_init(&converterConfig, NULL, &buffer->converter) != MA_SUCCESS)
+        {
+            TRACELOG(LOG_WARNING, "AUDIO: Failed to recreate data conversion pipeline");
+            memset(&buffer->converter, 0, sizeof(buffer->converter));
+            StopAudioBufferInLockedState(buffer);
+            continue;
+        }
+
+        if (buffer->pitch != 1.0f) ma_data_converter_set_rate(&buffer->converter, buffer->converter.sampleRateIn, (ma_uint32)((float)buffer->converter.sampleRateOut/buffer->pitch));
+    }
+    AUDIO.Stats.lastCallback = 0.0;   // The gap while reopening is not a device period
+    ma_mutex_unlock(&AUDIO.System.lock);
+
+    SetMasterVolume(volume);
+
+    result = ma_device_start(&AUDIO.System.device);
+    if (result != MA_SUCCESS) TRACELOG(LOG_WARNING, "AUDIO: Failed to start playback device");
+
+    TRACELOG(LOG_INFO, "AUDIO: Device reopened, sample rate: %d -> %d, period size: %d", AUDIO.System.device.sampleRate, AUDIO.System.device.playback.internalSampleRate, AUDIO.System.device.playback.internalPeriodSizeInFrames);
+}
+
 // Reads audio data from an AudioBuffer object in internal format
 static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer, void *framesOut, ma_uint32 frameCount)
 {
@@ -2369,8 +2580,11 @@ static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer,
 
     // Fill out every frame until we find a buffer that's marked as processed. Then fill the remainder with 0
     ma_uint32 framesRead = 0;
+    bool drained = false;
     while (1)
     {
+        bool drainEndsHere = false;
+
         // We break from this loop differently depending on the buffer's usage
         //  - For static buffers, we simply fill as much data as we can
         //  - For streaming buffers we only fill half of the buffer that are processed
@@ -2396,6 +2610,13 @@ static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer,
         {
             ma_uint32 firstFrameIndexOfThisSubBuffer = subBufferSizeInFrames*currentSubBufferIndex;
             framesRemainingInOutputBuffer = subBufferSizeInFrames - (audioBuffer->frameCursorPos - firstFrameIndexOfThisSubBuffer);
+
+            // A draining stream ends at its last frame, not at the end of the sub-buffer holding it
+            if (audioBuffer->draining && (audioBuffer->drainEnd > audioBuffer->frameCursorPos) && (audioBuffer->drainEnd <= firstFrameIndexOfThisSubBuffer + subBufferSizeInFrames))
+            {
+                framesRemainingInOutputBuffer = audioBuffer->drainEnd - audioBuffer->frameCursorPos;
+                drainEndsHere = true;
+            }
         }
 
         ma_uint32 framesToRead = totalFramesRemaining;
@@ -2405,6 +2626,13 @@ static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer,
         audioBuffer->frameCursorPos = (audioBuffer->frameCursorPos + framesToRead)%audioBuffer->sizeInFrames;
         framesRead += framesToRead;
 
+        if (drainEndsHere && (framesToRead == framesRemainingInOutputBuffer))
+        {
+            StopAudioBufferInLockedState(audioBuffer);
+            drained = true;
+            break;
+        }
+
         // If we've read to the end of the buffer, mark it as processed
         if (framesToRead == framesRemainingInOutputBuffer)
         {
@@ -2428,6 +2656,9 @@ static ma_uint32 ReadAudioBufferFramesInInternalFormat(AudioBuffer *audioBuffer,
     {
         memset((unsigned char *)framesOut + (framesRead*frameSizeInBytes), 0, totalFramesRemaining*frameSizeInBytes);
 
+        // A stream that runs out of data before its end was not refilled in time
+        if ((audioBuffer->usage == AUDIO_BUFFER_USAGE_STREAM) && !drained) AUDIO.Stats.counters.underruns++;
+
         // For static buffers we can fill the remaining frames with silence for safety, but we don't want
         // to report those frames as "read". The reason for this is that the caller uses the return value
         // to know whether a non-looping sound has finished playback
@@ -2444,9 +2675,38 @@ static ma_uint32 ReadAudioBufferFramesInMixingFormat(AudioBuffer *audioBuffer, f
     // should be defined by the output format of the data converter. We do this until frameCount frames have been output. The important
     // detail to remember here is that we never, ever attempt to read more input data than is required for the specified number of output
     // frames. This can be achieved with ma_data_converter_get_required_input_frame_count()
-    ma_uint8 inputBuffer[4096] = { 0 };
+    ma_uint8 inputBuffer[4096];     // Not cleared, the internal format reader fills whatever it does not read with zeros
     ma_uint32 inputBufferFrameCap = sizeof(inputBuffer)/ma_get_bytes_per_frame(audioBuffer->converter.formatIn, audioBuffer->converter.channelsIn);
 
+    // When neither the sample rate (pitch included) nor the channels change, the converter would only change
+    // the sample format, after running every frame through a 1:1 resampler: float data is read directly
+    // into the output and 16 bit data is converted by the SIMD kernel instead
+    // NOTE: The resampler keeps its state, so a pitch change back from 1.0f resumes from a stale history frame
+    const ma_data_converter *converter = &audioBuffer->converter;
+    if (!converter->hasChannelConverter && (converter->channelsIn == converter->channelsOut) && (converter->formatOut == ma_format_f32) &&
+        (converter->resampler.sampleRateIn == converter->resampler.sampleRateOut))
+    {
+        if (converter->formatIn == ma_format_f32) return ReadAudioBufferFramesInInternalFormat(audioBuffer, framesOut, frameCount);
+
+        if (converter->formatIn == ma_format_s16)
+        {
+            ma_uint32 totalFramesRead = 0;
+            while (totalFramesRead < frameCount)
+            {
+                ma_uint32 framesToRead = frameCount - totalFramesRead;
+                if (framesToRead > inputBufferFrameCap) framesToRead = inputBufferFrameCap;
+
+                ma_uint32 framesRead = ReadAudioBufferFramesInInternalFormat(audioBuffer, inputBuffer, framesToRead);
+                ConvertSamplesS16ToF32(framesOut + totalFramesRead*converter->channelsOut, (const short *)inputBuffer, framesRead*converter->channelsIn);
+                totalFramesRead += framesRead;
+
+                if (framesRead < framesToRead) break;  // Ran out of input data
+            }
+
+            return totalFramesRead;
+        }
+    }
+
     ma_uint32 totalOutputFramesProcessed = 0;
     while (totalOutputFramesProcessed < frameCount)
     {
@@ -2492,6 +2752,14 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
     // This is unlikely to be necessary for this project, but may want to consider how you might want to avoid this
     ma_mutex_lock(&AUDIO.System.lock);
     {
+        double time = ma_timer_get_time_in_seconds(&AUDIO.Stats.timer);
+        if (AUDIO.Stats.lastCallback > 0.0) AUDIO.Stats.counters.interval += time - AUDIO.Stats.lastCallback;
+        AUDIO.Stats.lastCallback = time;
+        AUDIO.Stats.counters.callbacks++;
+        AUDIO.Stats.counters.frames += frameCount;
+
+        const ma_uint64 clock = AUDIO.System.frameClock;
+
         for (AudioBuffer *audioBuffer = AUDIO.Buffer.first; audioBuffer != NULL; audioBuffer = audioBuffer->next)
         {
             // Ignore stopped or paused sounds
@@ -2499,6 +2767,13 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
 
             ma_uint32 framesRead = 0;
 
+            // A buffer fading in starts on its frame of the device clock, not at the start of a period
+            if ((audioBuffer->fade == AUDIO_FADE_IN) && (audioBuffer->fadeStart > clock))
+            {
+                if (audioBuffer->fadeStart >= clock + frameCount) continue;
+                framesRead = (ma_uint32)(audioBuffer->fadeStart - clock);
+            }
+
             while (1)
             {
                 if (framesRead >= frameCount) break;
@@ -2508,7 +2783,7 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
 
                 while (framesToRead > 0)
                 {
-                    float tempBuffer[1024] = { 0 }; // Frames for stereo
+                    float tempBuffer[1024];     // Frames for stereo, not cleared: every frame mixed is read first
 
                     ma_uint32 framesToReadRightNow = framesToRead;
                     if (framesToReadRightNow > sizeof(tempBuffer)/sizeof(tempBuffer[0])/AUDIO_DEVICE_CHANNELS)
@@ -2516,8 +2791,29 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
                         framesToReadRightNow = sizeof(tempBuffer)/sizeof(tempBuffer[0])/AUDIO_DEVICE_CHANNELS;
                     }
 
-                    ma_uint32 framesJustRead = ReadAudioBufferFramesInMixingFormat(audioBuffer, tempBuffer, framesToReadRightNow);
-                    if (framesJustRead > 0)
+                    if (audioBuffer->fade != AUDIO_FADE_NONE)
+                    {
+                        const ma_uint64 position = clock + framesRead;
+                        const ma_uint64 fadeEnd = audioBuffer->fadeStart + audioBuffer->fadeLength;
+
+                        // A buffer fading out stops right at the end of the fade
+                        if ((audioBuffer->fade == AUDIO_FADE_OUT) && (position >= fadeEnd))
+                        {
+                            StopAudioBufferInLockedState(audioBuffer);
+                            framesRead = frameCount;
+                            break;
+                        }
+
+                        // Frames mixed at once do not cross the start or the end of the fade, each ramps from its own gain
+                        if ((position < audioBuffer->fadeStart) && (position + framesToReadRightNow > audioBuffer->fadeStart)) framesToReadRightNow = (ma_uint32)(audioBuffer->fadeStart - position);
+                        else if ((position < fadeEnd) && (position + framesToReadRightNow > fadeEnd)) framesToReadRightNow = (ma_uint32)(fadeEnd - position);
+
+                        // Short ramps stay close to the equal-power curve, whatever the period size
+                        if ((position >= audioBuffer->fadeStart) && (position < fadeEnd) && (framesToReadRightNow > AUDIO_FADE_STEP_FRAMES)) framesToReadRightNow = AUDIO_FADE_STEP_FRAMES;
+                    }
+
+                    ma_uint32 framesJustRead = ReadAudioBufferFramesInMixingFormat(audioBuffer, tempBuffer, framesToReadRightNow);
+                    if (framesJustRead > 0)
                     {
                         float *framesOut = (float *)pFramesOut + (framesRead*AUDIO.System.device.playback.channels);
                         float *framesIn = tempBuffer;
@@ -2530,7 +2826,7 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
                             processor = processor->next;
                         }
 
-                        MixAudioFrames(framesOut, framesIn, framesJustRead, audioBuffer);
+                        MixAudioFrames(framesOut, framesIn, framesJustRead, audioBuffer, clock + framesRead);
 
                         framesToRead -= framesJustRead;
                         framesRead += framesJustRead;
@@ -2564,6 +2860,8 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
                 // Not doing this could theoretically put us into an infinite loop
                 if (framesToRead > 0) break;
             }
+
+            PublishAudioBufferInLockedState(audioBuffer);
         }
     }
 
@@ -2574,52 +2872,165 @@ static void OnSendAudioDataToDevice(ma_device *pDevice, void *pFramesOut, const
         processor = processor->next;
     }
 
+    AUDIO.System.frameClock += frameCount;
+
     ma_mutex_unlock(&AUDIO.System.lock);
 }
 
 // Main mixing function, pretty simple in this project, just an accumulation
-// NOTE: framesOut is both an input and an output, it is initially filled with zeros outside of this function
-static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, AudioBuffer *buffer)
+// NOTE: framesOut is both an input and an output, it is initially filled with zeros outside of this function,
+// position is the device frame (see frameClock) the first frame plays at
+static void MixAudioFrames(float *framesOut, const float *framesIn, ma_uint32 frameCount, AudioBuffer *buffer, ma_uint64 position)
 {
     const float localVolume = buffer->volume;
     const ma_uint32 channels = AUDIO.System.device.playback.channels;
 
+    // Crossfade gains at the first frame and right after the last one, at most AUDIO_FADE_STEP_FRAMES apart
+    // NOTE: The callback never mixes frames across the start or the end of a fade at once
+    const float fade[2] = { GetAudioBufferFadeGain(buffer, position), GetAudioBufferFadeGain(buffer, position + frameCount) };
+
     if (channels == 2)  // We consider panning
     {
         const float left = buffer->pan;
         const float right = 1.0f - left;
 
         // Fast sine approximation in [0..1] for pan law: y = 0.5f*x*(3 - x*x);
-        const float levels[2] = { localVolume*0.5f*left*(3.0f - left*left), localVolume*0.5f*right*(3.0f - right*right) };
+        const float panLevels[2] = { localVolume*0.5f*left*(3.0f - left*left), localVolume*0.5f*right*(3.0f - right*right) };
+        const float levels[2] = { panLevels[0]*fade[1], panLevels[1]*fade[1] };
 
-        float *frameOut = framesOut;
-        const float *frameIn = framesIn;
-
-        for (ma_uint32 frame = 0; frame < frameCount; frame++)
+        // Volume and pan changes ramp across the frames instead of stepping, which would click
+        if (buffer->mixLevels[0] < 0.0f)
         {
-            frameOut[0] += (frameIn[0]*levels[0]);
-            frameOut[1] += (frameIn[1]*levels[1]);
-
-            frameOut += 2;
-            frameIn += 2;
+            buffer->mixLevels[0] = panLevels[0]*fade[0];
+            buffer->mixLevels[1] = panLevels[1]*fade[0];
         }
+
+        MixFramesStereo(framesOut, framesIn, frameCount, buffer->mixLevels, levels);
+
+        buffer->mixLevels[0] = levels[0];
+        buffer->mixLevels[1] = levels[1];
     }
-    else  // We do not consider panning
+    else MixSamples(framesOut, framesIn, frameCount*channels, localVolume*fade[1]);  // We do not consider panning
+}
+
+// Get the crossfade gain of an audio buffer at a device frame, equal power: the squares of both gains add up to 1
+static float GetAudioBufferFadeGain(AudioBuffer *buffer, ma_uint64 position)
+{
+    if ((buffer->fade == AUDIO_FADE_NONE) || (buffer->fadeLength == 0)) return 1.0f;
+
+    float progress = 0.0f;
+    if (position >= buffer->fadeStart + buffer->fadeLength) progress = 1.0f;
+    else if (position > buffer->fadeStart) progress = (float)(position - buffer->fadeStart)/buffer->fadeLength;
+
+    return (buffer->fade == AUDIO_FADE_IN)? sinf(progress*PI/2.0f) : cosf(progress*PI/2.0f);
+}
+
+// Accumulate stereo frames with per channel levels going linearly from levelsFrom to levelsTo
+static void MixFramesStereo(float *framesOut, const float *framesIn, ma_uint32 frameCount, const float *levelsFrom, const float *levelsTo)
+{
+    const float steps[2] = { (levelsTo[0] - levelsFrom[0])/frameCount, (levelsTo[1] - levelsFrom[1])/frameCount };
+    ma_uint32 frame = 0;
+
+#if defined(RAUDIO_AVX2)
+    // Four frames per vector
+    __m256 levels = _mm256_setr_ps(levelsFrom[0], levelsFrom[1], levelsFrom[0] + steps[0], levelsFrom[1] + steps[1],
+                                   levelsFrom[0] + 2*steps[0], levelsFrom[1] + 2*steps[1], levelsFrom[0] + 3*steps[0], levelsFrom[1] + 3*steps[1]);
+    const __m256 step = _mm256_setr_ps(4*steps[0], 4*steps[1], 4*steps[0], 4*steps[1], 4*steps[0], 4*steps[1], 4*steps[0], 4*steps[1]);
+
+    for (; frame + 4 <= frameCount; frame += 4)
     {
-        for (ma_uint32 frame = 0; frame < frameCount; frame++)
-        {
-            for (ma_uint32 c = 0; c < channels; c++)
-            {
-                float *frameOut = framesOut + (frame*channels);
-                const float *frameIn = framesIn + (frame*channels);
+        __m256 out = _mm256_loadu_ps(framesOut + frame*2);
+        out = _mm256_add_ps(out, _mm256_mul_ps(_mm256_loadu_ps(framesIn + frame*2), levels));
+        _mm256_storeu_ps(framesOut + frame*2, out);
+        levels = _mm256_add_ps(levels, step);
+    }
+#elif defined(RAUDIO_SSE2)
+    // Two frames per vector
+    __m128 levels = _mm_setr_ps(levelsFrom[0], levelsFrom[1], levelsFrom[0] + steps[0], levelsFrom[1] + steps[1]);
+    const __m128 step = _mm_setr_ps(2*steps[0], 2*steps[1], 2*steps[0], 2*steps[1]);
 
-                // Output accumulates input multiplied by volume to provided output (usually 0)
-                frameOut[c] += (frameIn[c]*localVolume);
-            }
-        }
+    for (; frame + 2 <= frameCount; frame += 2)
+    {
+        __m128 out = _mm_loadu_ps(framesOut + frame*2);
+        out = _mm_add_ps(out, _mm_mul_ps(_mm_loadu_ps(framesIn + frame*2), levels));
+        _mm_storeu_ps(framesOut + frame*2, out);
+        levels = _mm_add_ps(levels, step);
+    }
+#elif defined(RAUDIO_NEON)
+    // Two frames per vector
+    const float start[4] = { levelsFrom[0], levelsFrom[1], levelsFrom[0] + steps[0], levelsFrom[1] + steps[1] };
+    const float twoSteps[4] = { 2*steps[0], 2*steps[1], 2*steps[0], 2*steps[1] };
+    float32x4_t levels = vld1q_f32(start);
+    const float32x4_t step = vld1q_f32(twoSteps);
+
+    for (; frame + 2 <= frameCount; frame += 2)
+    {
+        vst1q_f32(framesOut + frame*2, vmlaq_f32(vld1q_f32(framesOut + frame*2), vld1q_f32(framesIn + frame*2), levels));
+        levels = vaddq_f32(levels, step);
+    }
+#endif
+
+    for (; frame < frameCount; frame++)
+    {
+        framesOut[frame*2] += framesIn[frame*2]*(levelsFrom[0] + steps[0]*frame);
+        framesOut[frame*2 + 1] += framesIn[frame*2 + 1]*(levelsFrom[1] + steps[1]*frame);
     }
 }
 
+// Accumulate samples multiplied by volume, whatever channels they belong to
+static void MixSamples(float *samplesOut, const float *samplesIn, ma_uint32 sampleCount, float volume)
+{
+    ma_uint32 i = 0;
+
+#if defined(RAUDIO_AVX2)
+    const __m256 levels = _mm256_set1_ps(volume);
+    for (; i + 8 <= sampleCount; i += 8) _mm256_storeu_ps(samplesOut + i, _mm256_add_ps(_mm256_loadu_ps(samplesOut + i), _mm256_mul_ps(_mm256_loadu_ps(samplesIn + i), levels)));
+#elif defined(RAUDIO_SSE2)
+    const __m128 levels = _mm_set1_ps(volume);
+    for (; i + 4 <= sampleCount; i += 4) _mm_storeu_ps(samplesOut + i, _mm_add_ps(_mm_loadu_ps(samplesOut + i), _mm_mul_ps(_mm_loadu_ps(samplesIn + i), levels)));
+#elif defined(RAUDIO_NEON)
+    for (; i + 4 <= sampleCount; i += 4) vst1q_f32(samplesOut + i, vmlaq_n_f32(vld1q_f32(samplesOut + i), vld1q_f32(samplesIn + i), volume));
+#endif
+
+    for (; i < sampleCount; i++) samplesOut[i] += samplesIn[i]*volume;
+}
+
+// Convert 16 bit samples to float, scaled the way miniaudio does it: x/32768
+static void ConvertSamplesS16ToF32(float *samplesOut, const short *samplesIn, ma_uint32 sampleCount)
+{
+    const float scale = 1.0f/32768.0f;
+    ma_uint32 i = 0;
+
+#if defined(RAUDIO_AVX2)
+    const __m256 scales = _mm256_set1_ps(scale);
+    for (; i + 8 <= sampleCount; i += 8)
+    {
+        __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samplesIn + i)));
+        _mm256_storeu_ps(samplesOut + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scales));
+    }
+#elif defined(RAUDIO_SSE2)
+    const __m128 scales = _mm_set1_ps(scale);
+    for (; i + 8 <= sampleCount; i += 8)
+    {
+        // Sign extension: each sample goes into the top half of a 32 bit lane, then shifts back down
+        __m128i samples = _mm_loadu_si128((const __m128i *)(samplesIn + i));
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+        _mm_storeu_ps(samplesOut + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scales));
+        _mm_storeu_ps(samplesOut + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scales));
+    }
+#elif defined(RAUDIO_NEON)
+    for (; i + 8 <= sampleCount; i += 8)
+    {
+        int16x8_t samples = vld1q_s16(samplesIn + i);
+        vst1q_f32(samplesOut + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), scale));
+        vst1q_f32(samplesOut + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), scale));
+    }
+#endif
+
+    for (; i < sampleCount; i++) samplesOut[i] = samplesIn[i]*scale;
+}
+
 // Check if an audio buffer is playing, assuming the audio system mutex has been locked
 static bool IsAudioBufferPlayingInLockedState(AudioBuffer *buffer)
 {
@@ -2644,9 +3055,40 @@ static void StopAudioBufferInLockedState(AudioBuffer *buffer)
             buffer->isSubBufferProcessed[0] = true;
             buffer->isSubBufferProcessed[1] = true;
         }
+
+        // NOTE: The crossfade role is kept: frames read just before a drained stream stops are still mixed
+        buffer->draining = false;
+        PublishAudioBufferInLockedState(buffer);
     }
 }
 
+// Get the frames played of an audio buffer, assuming the audio system mutex has been locked
+// NOTE: For streams, framesProcessed less the frames still queued, which may be negative or past the end
+static int GetAudioBufferPositionInLockedState(AudioBuffer *buffer)
+{
+    int framesPlayed = (int)buffer->frameCursorPos;
+
+    if ((buffer->usage == AUDIO_BUFFER_USAGE_STREAM) && (buffer->sizeInFrames > 1))
+    {
+        int subBufferSize = (int)buffer->sizeInFrames/2;
+        int framesInFirstBuffer = buffer->isSubBufferProcessed[0]? 0 : subBufferSize;
+        int framesInSecondBuffer = buffer->isSubBufferProcessed[1]? 0 : subBufferSize;
+        int framesSentToMix = (int)buffer->frameCursorPos%subBufferSize;
+        framesPlayed = (int)buffer->framesProcessed - framesInFirstBuffer - framesInSecondBuffer + framesSentToMix;
+    }
+
+    return framesPlayed;
+}
+
+// Publish the play position and state of an audio buffer, assuming the audio system mutex has been locked
+// NOTE: Every change to them under the mutex ends here, each is published as a single word,
+// so readers get a consistent value without locking (see IsAudioBufferPlaying() and GetMusicTimePlayed())
+static void PublishAudioBufferInLockedState(AudioBuffer *buffer)
+{
+    ma_atomic_store_explicit_32(&buffer->publishedPosition, (ma_uint32)GetAudioBufferPositionInLockedState(buffer), ma_atomic_memory_order_release);
+    ma_atomic_store_explicit_32(&buffer->publishedPlaying, IsAudioBufferPlayingInLockedState(buffer), ma_atomic_memory_order_release);
+}
+
 // Update audio stream, assuming the audio system mutex has been locked
 static void UpdateAudioStreamInLockedState(AudioStream stream, const void *data, int frameCount)
 {
@@ -2690,13 +3132,417 @@ static void UpdateAudioStreamInLockedState(AudioStream stream, const void *data,
                 if (leftoverFrameCount > 0) memset(subBuffer + bytesToWrite, 0, leftoverFrameCount*stream.channels*(stream.sampleSize/8));
 
                 stream.buffer->isSubBufferProcessed[subBufferToUpdate] = false;
+                AUDIO.Stats.counters.refills++;
             }
             else TRACELOG(LOG_WARNING, "STREAM: Attempting to write too many frames to buffer");
         }
         else TRACELOG(LOG_WARNING, "STREAM: Buffer not available for updating");
+
+        PublishAudioBufferInLockedState(stream.buffer);
+    }
+}
+
+// Decode frames of a music stream from where its decoder is, looping back to the start at the end
+static void ReadMusicStreamDecoder(Music music, void *framesOut, unsigned int frameCount)
+{
+    int frameSize = music.stream.channels*music.stream.sampleSize/8;
+    int frameCountStillNeeded = frameCount;
+    int frameCountReadTotal = 0;
+
+    switch (music.ctxType)
+    {
+    #if defined(SUPPORT_FILEFORMAT_WAV)
+        case MUSIC_AUDIO_WAV:
+        {
+            if (music.stream.sampleSize == 16)
+            {
+                while (true)
+                {
+                    int frameCountRead = (int)drwav_read_pcm_frames_s16((drwav *)music.ctxData, frameCountStillNeeded, (short *)((char *)framesOut + frameCountReadTotal*frameSize));
+                    frameCountReadTotal += frameCountRead;
+                    frameCountStillNeeded -= frameCountRead;
+                    if (frameCountStillNeeded == 0) break;
+                    else drwav_seek_to_first_pcm_frame((drwav *)music.ctxData);
+                }
+            }
+            else if (music.stream.sampleSize == 32)
+            {
+                while (true)
+                {
+                    int frameCountRead = (int)drwav_read_pcm_frames_f32((drwav *)music.ctxData, frameCountStillNeeded, (float *)((char *)framesOut + frameCountReadTotal*frameSize));
+                    frameCountReadTotal += frameCountRead;
+                    frameCountStillNeeded -= frameCountRead;
+                    if (frameCountStillNeeded == 0) break;
+                    else drwav_seek_to_first_pcm_frame((drwav *)music.ctxData);
+                }
+            }
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_OGG)
+        case MUSIC_AUDIO_OGG:
+        {
+            while (true)
+            {
+                int frameCountRead = stb_vorbis_get_samples_short_interleaved((stb_vorbis *)music.ctxData, music.stream.channels, (short *)((char *)framesOut + frameCountReadTotal*frameSize), frameCountStillNeeded*music.stream.channels);
+                frameCountReadTotal += frameCountRead;
+                frameCountStillNeeded -= frameCountRead;
+                if (frameCountStillNeeded == 0) break;
+                else stb_vorbis_seek_start((stb_vorbis *)music.ctxData);
+            }
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_MP3)
+        case MUSIC_AUDIO_MP3:
+        {
+            while (true)
+            {
+                int frameCountRead = (int)drmp3_read_pcm_frames_f32((drmp3 *)music.ctxData, frameCountStillNeeded, (float *)((char *)framesOut + frameCountReadTotal*frameSize));
+                frameCountReadTotal += frameCountRead;
+                frameCountStillNeeded -= frameCountRead;
+                if (frameCountStillNeeded == 0) break;
+                else drmp3_seek_to_start_of_stream((drmp3 *)music.ctxData);
+            }
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_QOA)
+        case MUSIC_AUDIO_QOA:
+        {
+            unsigned int frameCountRead = qoaplay_decode((qoaplay_desc *)music.ctxData, (float *)framesOut, frameCount);
+            frameCountReadTotal += frameCountRead;
+            /*
+            while (true)
+            {
+                int frameCountRead = (int)qoaplay_decode((qoaplay_desc *)music.ctxData, (float *)((char *)framesOut + frameCountReadTotal*frameSize),  frameCountStillNeeded);
+                frameCountReadTotal += frameCountRead;
+                frameCountStillNeeded -= frameCountRead;
+                if (frameCountStillNeeded == 0) break;
+                else qoaplay_rewind((qoaplay_desc *)music.ctxData);
+            }
+            */
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_FLAC)
+        case MUSIC_AUDIO_FLAC:
+        {
+            while (true)
+            {
+                int frameCountRead = (int)drflac_read_pcm_frames_s16((drflac *)music.ctxData, frameCountStillNeeded, (short *)((char *)framesOut + frameCountReadTotal*frameSize));
+                frameCountReadTotal += frameCountRead;
+                frameCountStillNeeded -= frameCountRead;
+                if (frameCountStillNeeded == 0) break;
+                else drflac__seek_to_first_frame((drflac *)music.ctxData);
+            }
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_XM)
+        case MUSIC_MODULE_XM:
+        {
+            // NOTE: Internally we consider 2 channels generation, so sampleCount/2
+            if (AUDIO_DEVICE_FORMAT == ma_format_f32) jar_xm_generate_samples((jar_xm_context_t *)music.ctxData, (float *)framesOut, frameCount);
+            else if (AUDIO_DEVICE_FORMAT == ma_format_s16) jar_xm_generate_samples_16bit((jar_xm_context_t *)music.ctxData, (short *)framesOut, frameCount);
+            else if (AUDIO_DEVICE_FORMAT == ma_format_u8) jar_xm_generate_samples_8bit((jar_xm_context_t *)music.ctxData, (char *)framesOut, frameCount);
+            //jar_xm_reset((jar_xm_context_t *)music.ctxData);
+
+        } break;
+    #endif
+    #if defined(SUPPORT_FILEFORMAT_MOD)
+        case MUSIC_MODULE_MOD:
+        {
+            // NOTE: 3rd parameter (nbsample) specify the number of stereo 16bits samples you want, so sampleCount/2
+            jar_mod_fillbuffer((jar_mod_context_t *)music.ctxData, (short *)framesOut, frameCount, 0);
+            //jar_mod_seek_start((jar_mod_context_t *)music.ctxData);
+
+        } break;
+    #endif
+        default: break;
     }
 }
 
+// Move the decoder of a music stream, returns the frame it moved to (QOA only stops at the start of its frames)
+static unsigned int SeekMusicStreamDecoder(Music music, unsigned int positionInFrames)
+{
+    switch (music.ctxType)
+    {
+#if defined(SUPPORT_FILEFORMAT_WAV)
+        case MUSIC_AUDIO_WAV: drwav_seek_to_pcm_frame((drwav *)music.ctxData, positionInFrames); break;
+#endif
+#if defined(SUPPORT_FILEFORMAT_OGG)
+        case MUSIC_AUDIO_OGG: stb_vorbis_seek_frame((stb_vorbis *)music.ctxData, positionInFrames); break;
+#endif
+#if defined(SUPPORT_FILEFORMAT_MP3)
+        case MUSIC_AUDIO_MP3: drmp3_seek_to_pcm_frame((drmp3 *)music.ctxData, positionInFrames); break;
+#endif
+#if defined(SUPPORT_FILEFORMAT_QOA)
+        case MUSIC_AUDIO_QOA:
+        {
+            int qoaFrame = positionInFrames/QOA_FRAME_LEN;
+            qoaplay_seek_frame((qoaplay_desc *)music.ctxData, qoaFrame); // Seeks to QOA frame, not PCM frame
+
+            // We need to compute QOA frame number and update positionInFrames
+            positionInFrames = ((qoaplay_desc *)music.ctxData)->sample_position;
+        } break;
+#endif
+#if defined(SUPPORT_FILEFORMAT_FLAC)
+        case MUSIC_AUDIO_FLAC: drflac_seek_to_pcm_frame((drflac *)music.ctxData, positionInFrames); break;
+#endif
+        default: break;
+    }
+
+    music.stream.buffer->decoderPosition = positionInFrames;
+    return positionInFrames;
+}
+
+#if defined(SUPPORT_FILEFORMAT_MP3)
+// Make a decoder reading a file read data, the same file in memory, from the byte it got to
+// NOTE: Its state and the frames it decoded ahead carry over, so it plays on as if nothing changed;
+// data has to match the file in size and in the bytes the decoder has read but not decoded yet
+static bool MoveMp3DecoderToMemory(drmp3 *mp3, const unsigned char *data, int dataSize)
+{
+    if ((mp3->onRead != drmp3__on_read_stdio) || (mp3->pUserData == NULL) || (mp3->streamCursor < mp3->dataSize)) return false;
+
+    FILE *file = (FILE *)mp3->pUserData;
+    size_t offset = (size_t)(mp3->streamCursor - mp3->dataSize);
+    if ((fseek(file, 0, SEEK_END) != 0) || (ftell(file) != dataSize) || (offset + mp3->dataSize > (size_t)dataSize) ||
+        (memcmp(data + offset, mp3->pData + mp3->dataConsumed, mp3->dataSize) != 0))
+    {
+        fseek(file, (long)mp3->streamCursor, SEEK_SET);     // Left on the file, where it was
+        return false;
+    }
+
+    fclose(file);
+    mp3->onRead = drmp3__on_read_memory;
+    mp3->onSeek = drmp3__on_seek_memory;
+    mp3->pUserData = mp3;
+    mp3->memory.pData = data;
+    mp3->memory.dataSize = dataSize;
+    mp3->memory.currentReadPos = offset;
+    mp3->dataSize = 0;
+    mp3->dataConsumed = 0;
+
+    return true;
+}
+#endif
+
+// Check if the frames of a music stream go through the cache: a key is set and its decoder seeks to exact frames
+static bool IsMusicStreamCacheable(Music music)
+{
+    if ((music.stream.buffer == NULL) || (music.stream.buffer->cacheKey == 0) || (AUDIO.Cache.sizeLimit == 0)) return false;
+    if ((music.stream.sampleSize != 16) && (music.stream.sampleSize != 32)) return false;
+    if (music.frameCount == 0) return false;
+
+    return (music.ctxType == MUSIC_AUDIO_WAV) || (music.ctxType == MUSIC_AUDIO_OGG) || (music.ctxType == MUSIC_AUDIO_MP3) || (music.ctxType == MUSIC_AUDIO_FLAC);
+}
+
+// Read frames of a music stream from position on, cached ones from the cache and the rest from the decoder
+// NOTE: The mutex is only held for the cache, never while the decoder moves. Frames from the cache leave the decoder
+// behind; when the frames cached ahead run short of the distance, it catches up a few reads per call,
+// so running out of cached frames never has to skip a long stretch at once
+static void ReadMusicStreamFrames(Music music, void *framesOut, unsigned int position, unsigned int frameCount)
+{
+    AudioBuffer *buffer = music.stream.buffer;
+    unsigned int frameSize = music.stream.channels*music.stream.sampleSize/8;
+    unsigned int framesRead = 0;
+
+    while (framesRead < frameCount)
+    {
+        if (position >= music.frameCount) position = 0;     // Looping back to the start
+
+        unsigned int frames = frameCount - framesRead;
+        if (frames > music.frameCount - position) frames = music.frameCount - position;
+        unsigned char *frameOut = (unsigned char *)framesOut + framesRead*frameSize;
+
+        ma_mutex_lock(&AUDIO.System.lock);
+        unsigned int framesCached = ReadMusicCacheInLockedState(music, frameOut, position, frames);
+        ma_mutex_unlock(&AUDIO.System.lock);
+
+        if (framesCached > 0) frames = framesCached;
+        else
+        {
+            if (buffer->decoderPosition != position) SeekMusicStreamDecoder(music, position);
+            ReadMusicStreamDecoder(music, frameOut, frames);
+            buffer->decoderPosition = position + frames;
+
+            ma_mutex_lock(&AUDIO.System.lock);
+            WriteMusicCacheInLockedState(music, frameOut, position, frames);
+            ma_mutex_unlock(&AUDIO.System.lock);
+        }
+
+        position += frames;
+        framesRead += frames;
+    }
+
+    if (position < music.frameCount)
+    {
+        if (buffer->decoderPosition >= music.frameCount) SeekMusicStreamDecoder(music, 0);  // Rewinding is cheap in every format
+
+        // Catching up gains three reads per call, it starts while the frames cached ahead still last half the distance
+        if (buffer->decoderPosition < position)
+        {
+            unsigned int lag = position - buffer->decoderPosition;
+            unsigned int framesNeeded = lag/2;
+            if (framesNeeded > music.frameCount - position) framesNeeded = music.frameCount - position;   // No further than the end
+
+            ma_mutex_lock(&AUDIO.System.lock);
+            unsigned int framesAhead = ReadMusicCacheInLockedState(music, NULL, position, framesNeeded);
+            ma_mutex_unlock(&AUDIO.System.lock);
+
+            if (framesAhead < framesNeeded) SeekMusicStreamDecoder(music, buffer->decoderPosition + ((lag < 4*frameCount)? lag : 4*frameCount));
+        }
+    }
+}
+
+// Copy the frames of a music stream cached in a row from position on, at most frameCount, in the stream format
+// NOTE: With framesOut NULL they are only counted
+static unsigned int ReadMusicCacheInLockedState(Music music, void *framesOut, unsigned int position, unsigned int frameCount)
+{
+    ma_format format = (music.stream.sampleSize == 16)? ma_format_s16 : ma_format_f32;
+    unsigned int frameSize = music.stream.channels*ma_get_bytes_per_sample(format);
+    unsigned int framesRead = 0;
+
+    while (framesRead < frameCount)
+    {
+        unsigned int frame = position + framesRead;
+        unsigned int offset = frame%AUDIO_CACHE_SEGMENT_FRAMES;
+        rMusicCacheSegment *segment = FindMusicCacheSegment(music.stream.buffer->cacheKey, frame/AUDIO_CACHE_SEGMENT_FRAMES);
+        if ((segment == NULL) || (segment->channels != music.stream.channels) || (segment->frames <= offset)) break;
+
+        unsigned int frames = segment->frames - offset;
+        if (frames > frameCount - framesRead) frames = frameCount - framesRead;
+
+        if (framesOut != NULL)
+        {
+            const unsigned char *framesIn = (const unsigned char *)segment->data + offset*segment->channels*ma_get_bytes_per_sample(segment->format);
+            ma_pcm_convert((unsigned char *)framesOut + framesRead*frameSize, format, framesIn, segment->format, frames*segment->channels, ma_dither_mode_none);
+            TouchMusicCacheSegment(segment);
+        }
+
+        framesRead += frames;
+    }
+
+    return framesRead;
+}
+
+// Keep the frames a music stream decoded at position, those that continue a segment from its start
+static void WriteMusicCacheInLockedState(Music music, const void *framesIn, unsigned int position, unsigned int frameCount)
+{
+    ma_format format = (music.stream.sampleSize == 16)? ma_format_s16 : ma_format_f32;
+    ma_format segmentFormat = ((format == ma_format_f32) && AUDIO.Cache.compact)? ma_format_s16 : format;
+    unsigned int frameSize = music.stream.channels*ma_get_bytes_per_sample(format);
+    unsigned int segmentFrameSize = music.stream.channels*ma_get_bytes_per_sample(segmentFormat);
+    unsigned int framesWritten = 0;
+
+    while (framesWritten < frameCount)
+    {
+        unsigned int frame = position + framesWritten;
+        unsigned int offset = frame%AUDIO_CACHE_SEGMENT_FRAMES;
+        unsigned int frames = AUDIO_CACHE_SEGMENT_FRAMES - offset;
+        if (frames > frameCount - framesWritten) frames = frameCount - framesWritten;
+
+        rMusicCacheSegment *segment = FindMusicCacheSegment(music.stream.buffer->cacheKey, frame/AUDIO_CACHE_SEGMENT_FRAMES);
+        if ((segment == NULL) && (offset == 0)) segment = LoadMusicCacheSegment(music.stream.buffer->cacheKey, frame/AUDIO_CACHE_SEGMENT_FRAMES, segmentFormat, music.stream.channels);
+
+        if ((segment != NULL) && (segment->channels == music.stream.channels) && (segment->frames == offset))
+        {
+            segmentFrameSize = segment->channels*ma_get_bytes_per_sample(segment->format);
+            ma_pcm_convert((unsigned char *)segment->data + offset*segmentFrameSize, segment->format, (const unsigned char *)framesIn + framesWritten*frameSize, format, frames*segment->channels, ma_dither_mode_none);
+            segment->frames += frames;
+            TouchMusicCacheSegment(segment);
+        }
+
+        framesWritten += frames;
+    }
+}
+
+// Get the hash bucket a segment of a track goes in
+static rMusicCacheSegment **GetMusicCacheBucket(unsigned long long key, unsigned int index)
+{
+    unsigned long long hash = (key ^ (index*0x9E3779B97F4A7C15ULL))*0xFF51AFD7ED558CCDULL;
+    return &AUDIO.Cache.buckets[(hash >> 32)%AUDIO_CACHE_BUCKETS];
+}
+
+// Find a segment of a track in the cache, NULL if it is not there
+static rMusicCacheSegment *FindMusicCacheSegment(unsigned long long key, unsigned int index)
+{
+    rMusicCacheSegment *segment = *GetMusicCacheBucket(key, index);
+
+    while ((segment != NULL) && ((segment->key != key) || (segment->index != index))) segment = segment->hashNext;
+
+    return segment;
+}
+
+// Add an empty segment to the cache, evicting the least recently used ones to make room
+static rMusicCacheSegment *LoadMusicCacheSegment(unsigned long long key, unsigned int index, ma_format format, unsigned int channels)
+{
+    unsigned int size = AUDIO_CACHE_SEGMENT_FRAMES*channels*ma_get_bytes_per_sample(format);
+    if (size > AUDIO.Cache.sizeLimit) return NULL;
+
+    TrimMusicCache(AUDIO.Cache.sizeLimit - size);
+
+    rMusicCacheSegment *segment = (rMusicCacheSegment *)RL_CALLOC(1, sizeof(rMusicCacheSegment));
+    segment->data = RL_MALLOC(size);
+    if (segment->data == NULL)
+    {
+        RL_FREE(segment);
+        return NULL;
+    }
+
+    segment->key = key;
+    segment->index = index;
+    segment->format = format;
+    segment->channels = channels;
+
+    rMusicCacheSegment **bucket = GetMusicCacheBucket(key, index);
+    segment->hashNext = *bucket;
+    *bucket = segment;
+
+    segment->next = AUDIO.Cache.first;
+    if (AUDIO.Cache.first != NULL) AUDIO.Cache.first->prev = segment;
+    else AUDIO.Cache.last = segment;
+    AUDIO.Cache.first = segment;
+
+    AUDIO.Cache.size += size;
+
+    return segment;
+}
+
+// Remove a segment from the cache and free it
+static void UnloadMusicCacheSegment(rMusicCacheSegment *segment)
+{
+    rMusicCacheSegment **bucket = GetMusicCacheBucket(segment->key, segment->index);
+    while (*bucket != segment) bucket = &(*bucket)->hashNext;
+    *bucket = segment->hashNext;
+
+    if (segment->prev != NULL) segment->prev->next = segment->next;
+    else AUDIO.Cache.first = segment->next;
+    if (segment->next != NULL) segment->next->prev = segment->prev;
+    else AUDIO.Cache.last = segment->prev;
+
+    AUDIO.Cache.size -= AUDIO_CACHE_SEGMENT_FRAMES*segment->channels*ma_get_bytes_per_sample(segment->format);
+    RL_FREE(segment->data);
+    RL_FREE(segment);
+}
+
+// Mark a segment as the most recently used one
+static void TouchMusicCacheSegment(rMusicCacheSegment *segment)
+{
+    if (AUDIO.Cache.first == segment) return;
+
+    segment->prev->next = segment->next;
+    if (segment->next != NULL) segment->next->prev = segment->prev;
+    else AUDIO.Cache.last = segment->prev;
+
+    segment->prev = NULL;
+    segment->next = AUDIO.Cache.first;
+    AUDIO.Cache.first->prev = segment;
+    AUDIO.Cache.first = segment;
+}
+
+// Evict the least recently used segments until the cache holds at most size bytes
+static void TrimMusicCache(unsigned int size)
+{
+    while ((AUDIO.Cache.size > size) && (AUDIO.Cache.last != NULL)) UnloadMusicCacheSegment(AUDIO.Cache.last);
+}
+
 // Some required functions for audio standalone module version
 #if defined(RAUDIO_STANDALONE)
 // Check file extension
@@ -486,6 +486,15 @@ typedef struct Music {
     void *ctxData;              // Audio context data, depends on type
 } Music;
 
+// AudioStats, playback counters kept by the audio device since it was initialized
+typedef struct AudioStats {
+    unsigned int callbacks;     // Device callbacks, each one mixes a period
+    unsigned int frames;        // Frames mixed by those callbacks
+    double interval;            // Time between consecutive callbacks, summed (seconds)
+    unsigned int refills;       // Stream sub-buffers refilled with new data
+    unsigned int underruns;     // Stream reads that ran out of data and played silence
+} AudioStats;
+
 // VrDeviceInfo, Head-Mounted-Display device parameters
 typedef struct VrDeviceInfo {
     int hResolution;                // Horizontal resolution in pixels
@@ -1632,6 +1641,10 @@ typedef void (*AudioCallback)(void *bufferData, unsigned int frames);
 RLAPI void InitAudioDevice(void);                                     // Initialize audio device and context
 RLAPI void CloseAudioDevice(void);                                    // Close the audio device and context
 RLAPI bool IsAudioDeviceReady(void);                                  // Check if audio device has been initialized successfully
+RLAPI void SetAudioDeviceSampleRate(unsigned int sampleRate);         // Reopen audio device at a sample rate (0 for the device default)
+RLAPI unsigned int GetAudioDeviceSampleRate(void);                    // Get audio device sample rate
+RLAPI void SetAudioDevicePeriodSize(unsigned int frames);             // Reopen audio device with a period size in frames (0 for the device default)
+RLAPI AudioStats GetAudioDeviceStats(void);                           // Get audio device playback counters
 RLAPI void SetMasterVolume(float volume);                             // Set master volume (listener)
 RLAPI float GetMasterVolume(void);                                    // Get master volume (listener)
 
@@ -1677,6 +1690,11 @@ RLAPI void StopMusicStream(Music music);                              // Stop mu
 RLAPI void PauseMusicStream(Music music);                             // Pause music playing
 RLAPI void ResumeMusicStream(Music music);                            // Resume playing paused music
 RLAPI void SeekMusicStream(Music music, float position);              // Seek music to a position (in seconds)
+RLAPI void CrossfadeMusicStream(Music from, Music to, float seconds);  // Start music to where music from has seconds left, crossfading sample-accurately
+RLAPI void CancelMusicStreamCrossfade(Music music);                   // Cancel the crossfade of a music stream, fading out it plays on
+RLAPI void SetMusicStreamCacheKey(Music music, unsigned long long key); // Set the track a music stream plays, its decoded frames are cached under key (0 for none)
+RLAPI void SetMusicCacheSize(unsigned int size, bool compact);        // Set the bytes of decoded music kept for replays and seeks back, compact keeps float data as 16 bit
+RLAPI bool SetMusicStreamData(Music *music, const char *fileType, const unsigned char *data, int dataSize); // Move a music stream onto data holding the same track, it plays on without a gap
 RLAPI void SetMusicVolume(Music music, float volume);                 // Set volume for music (1.0 is max level)
 RLAPI void SetMusicPitch(Music music, float pitch);                   // Set pitch for a music (1.0 is base level)
 RLAPI void SetMusicPan(Music music, float pan);                       // Set pan for a music (0.5 is center)
@@ -0,0 +1,229 @@
+// bake
+// Build time half of the assets: turns the font and the icons into signed
+// distance fields, packs them into one single channel atlas and composes the
+// window icon. bundle.py runs it and embeds the results in assets.h, so mus
+// only has to upload a single texture, which then draws crisp at any UI scale.
+//
+// Usage: bake <font size> <output> <font.ttf> <window icon.png> [icon.png...]
+// Writes the atlas pixels and then the 64x64 RGBA window icon to <output>,
+// and describes the atlas on stdout:
+//   atlas <width> <height> <padding>
+//   glyph <codepoint> <offset x> <offset y> <advance x> <x> <y> <width> <height>
+//   icon <x> <y> <size>
+// Glyph rects already include the distance field margin, so the padding is 0.
+// Icon rects are the icon itself, the margin is around them.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_PNG
+#include "external/stb_image.h"
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "external/stb_image_resize2.h"
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "external/stb_truetype.h"
+
+#define BAKE_ATLAS_WIDTH 512
+#define BAKE_GAP 1           // empty pixels between neighbours, so filtering never bleeds
+#define BAKE_SDF_PADDING 4   // distance field margin around every glyph and icon
+#define BAKE_SDF_ON_EDGE 128 // the value of the outline, inside is above
+#define BAKE_SDF_SCALE 64.f  // change of value per pixel away from the outline
+#define BAKE_WINDOW_ICON_SIZE 64
+
+typedef struct {
+    int codepoint; // 0 for icons
+    int offset_x, offset_y, advance_x;
+    int width, height;
+    unsigned char* sdf;   // NULL for glyphs without pixels (space, missing ones)
+    int x, y;             // placed in the atlas
+} BakeItem;
+
+unsigned char* bake_read_file(const char* path, int* size) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    unsigned char* data = malloc(*size);
+    if (fread(data, 1, *size, f) != (size_t) *size) { free(data); data = NULL; }
+    fclose(f);
+    return data;
+}
+
+// Same as LoadImageFromMemory then ImageResize
+unsigned char* bake_load_icon(const char* path, int size) {
+    int w = 0, h = 0, channels = 0;
+    unsigned char* pixels = stbi_load(path, &w, &h, &channels, 4);
+    if (pixels == NULL) return NULL;
+    unsigned char* resized = malloc((size_t) size*size*4);
+    stbir_resize_uint8_linear(pixels, w, h, 0, resized, size, size, 0, STBIR_RGBA);
+    stbi_image_free(pixels);
+    return resized;
+}
+
+// The icons are white shapes, so their alpha is thresholded at full size and
+// every output pixel gets the distance to the nearest source pixel on the
+// other side of the outline, in the same encoding stb_truetype uses for glyphs
+unsigned char* bake_icon_sdf(const char* path, int size) {
+    int w = 0, h = 0, channels = 0;
+    unsigned char* pixels = stbi_load(path, &w, &h, &channels, 4);
+    if (pixels == NULL) return NULL;
+    int n = size + 2*BAKE_SDF_PADDING;
+    float step = (float) w/size; // source pixels per output pixel
+    unsigned char* sdf = malloc((size_t) n*n);
+    for (int oy = 0; oy < n; oy++) {
+        for (int ox = 0; ox < n; ox++) {
+            float sx = (ox - BAKE_SDF_PADDING + 0.5f)*step, sy = (oy - BAKE_SDF_PADDING + 0.5f)*step;
+            int px = (int) sx, py = (int) sy;
+            bool inside = sx >= 0 && sy >= 0 && px < w && py < h && pixels[((size_t) py*w + px)*4 + 3] >= 128;
+            float best = 1e9f;
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                    if ((pixels[((size_t) y*w + x)*4 + 3] >= 128) == inside) continue;
+                    float dx = x + 0.5f - sx, dy = y + 0.5f - sy;
+                    if (dx*dx + dy*dy < best) best = dx*dx + dy*dy;
+                }
+            }
+            float distance = (sqrtf(best) - 0.5f)/step; // to the pixel's edge, in output pixels
+            if (!inside && best == 1e9f) distance = 0; // an empty icon
+            float value = BAKE_SDF_ON_EDGE + (inside ? distance : -distance)*BAKE_SDF_SCALE;
+            sdf[oy*n + ox] = value < 0 ? 0 : value > 255 ? 255 : (unsigned char) value;
+        }
+    }
+    stbi_image_free(pixels);
+    return sdf;
+}
+
+// ImageDrawCircle's midpoint circle, then the icon drawn over it
+unsigned char* bake_window_icon(const char* path) {
+    int size = BAKE_WINDOW_ICON_SIZE, r = size/2;
+    unsigned char* icon = bake_load_icon(path, size);
+    if (icon == NULL) return NULL;
+
+    unsigned char* pixels = calloc((size_t) size*size, 4);
+    unsigned char bg[4] = {0x18, 0x18, 0x18, 0xFF}; // theme.bg
+    int x = 0, y = r, d = 3 - 2*r;
+    while (y >= x) {
+        int spans[4][3] = {{r - x, r + y, x*2}, {r - x, r - y, x*2}, {r - y, r + x, y*2}, {r - y, r - x, y*2}};
+        for (int i = 0; i < 4; i++) {
+            if (spans[i][1] < 0 || spans[i][1] >= size) continue;
+            for (int sx = spans[i][0]; sx < spans[i][0] + spans[i][2]; sx++) {
+                if (sx >= 0 && sx < size) memcpy(pixels + ((size_t) spans[i][1]*size + sx)*4, bg, 4);
+            }
+        }
+        x++;
+        if (d > 0) { y--; d += 4*(x - y) + 10; }
+        else d += 4*x + 6;
+    }
+    for (int i = 0; i < size*size; i++) { // alpha blending, like ImageDraw
+        unsigned char* dst = pixels + i*4;
+        unsigned char* src = icon + i*4;
+        int a = src[3], out_a = a + dst[3]*(255 - a)/255;
+        if (out_a == 0) continue;
+        for (int c = 0; c < 3; c++) dst[c] = (src[c]*a + dst[c]*dst[3]*(255 - a)/255)/out_a;
+        dst[3] = out_a;
+    }
+    free(icon);
+    return pixels;
+}
+
+int bake_compare_height(const void* a, const void* b) {
+    const BakeItem* x = *(const BakeItem**) a;
+    const BakeItem* y = *(const BakeItem**) b;
+    return y->height - x->height;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <font size> <output> <font.ttf> <window icon.png> [icon.png...]\n", argv[0]);
+        return 1;
+    }
+    int font_size = atoi(argv[1]);
+    int font_data_size = 0;
+    unsigned char* font_data = bake_read_file(argv[3], &font_data_size);
+    stbtt_fontinfo font;
+    if (font_size <= 0 || font_data == NULL || !stbtt_InitFont(&font, font_data, 0)) {
+        fprintf(stderr, "Could not load %s\n", argv[3]);
+        return 1;
+    }
+
+    // The glyphs mus draws: ascii and cyrillic
+    int codepoints[95 + 255];
+    int glyph_count = 0;
+    for (int i = 0; i < 95; i++) codepoints[glyph_count++] = 32 + i;
+    for (int i = 0; i < 255; i++) codepoints[glyph_count++] = 0x400 + i;
+
+    int icon_count = argc - 5;
+    BakeItem* items = calloc(glyph_count + icon_count, sizeof(BakeItem));
+    float scale = stbtt_ScaleForPixelHeight(&font, font_size);
+    int ascent = 0, descent = 0, line_gap = 0;
+    stbtt_GetFontVMetrics(&font, &ascent, &descent, &line_gap);
+    for (int i = 0; i < glyph_count; i++) {
+        BakeItem* item = &items[i];
+        item->codepoint = codepoints[i];
+        if (stbtt_FindGlyphIndex(&font, item->codepoint) == 0) continue;
+        if (item->codepoint != ' ') item->sdf = stbtt_GetCodepointSDF(&font, scale, item->codepoint, BAKE_SDF_PADDING, BAKE_SDF_ON_EDGE, BAKE_SDF_SCALE, &item->width, &item->height, &item->offset_x, &item->offset_y);
+        stbtt_GetCodepointHMetrics(&font, item->codepoint, &item->advance_x, NULL);
+        item->advance_x = (int) (item->advance_x*scale);
+        item->offset_y += (int) (ascent*scale);
+        if (item->codepoint == ' ') { // an empty rect, raylib measures text with it
+            item->width = item->advance_x;
+            item->height = font_size;
+        }
+    }
+    for (int i = 0; i < icon_count; i++) {
+        BakeItem* item = &items[glyph_count + i];
+        item->sdf = bake_icon_sdf(argv[5 + i], font_size);
+        if (item->sdf == NULL) {
+            fprintf(stderr, "Could not load %s\n", argv[5 + i]);
+            return 1;
+        }
+        item->width = item->height = font_size + 2*BAKE_SDF_PADDING;
+    }
+
+    // Shelves, tallest first
+    int count = glyph_count + icon_count;
+    BakeItem** order = malloc(count*sizeof(BakeItem*));
+    for (int i = 0; i < count; i++) order[i] = &items[i];
+    qsort(order, count, sizeof(BakeItem*), bake_compare_height);
+    int x = 0, y = 0, shelf = 0;
+    for (int i = 0; i < count; i++) {
+        BakeItem* item = order[i];
+        int w = item->width + 2*BAKE_GAP, h = item->height + 2*BAKE_GAP;
+        if (x + w > BAKE_ATLAS_WIDTH) { x = 0; y += shelf; shelf = 0; }
+        item->x = x + BAKE_GAP;
+        item->y = y + BAKE_GAP;
+        x += w;
+        if (h > shelf) shelf = h;
+    }
+    int height = y + shelf;
+
+    unsigned char* atlas = calloc((size_t) BAKE_ATLAS_WIDTH*height, 1);
+    for (int i = 0; i < count; i++) {
+        BakeItem* item = &items[i];
+        if (item->sdf == NULL) continue;
+        for (int iy = 0; iy < item->height; iy++) memcpy(atlas + (size_t) (item->y + iy)*BAKE_ATLAS_WIDTH + item->x, item->sdf + iy*item->width, item->width);
+    }
+
+    unsigned char* window_icon = bake_window_icon(argv[4]);
+    FILE* out = fopen(argv[2], "wb");
+    if (window_icon == NULL || out == NULL) {
+        fprintf(stderr, "Could not write %s\n", argv[2]);
+        return 1;
+    }
+    fwrite(atlas, 1, (size_t) BAKE_ATLAS_WIDTH*height, out);
+    fwrite(window_icon, 1, BAKE_WINDOW_ICON_SIZE*BAKE_WINDOW_ICON_SIZE*4, out);
+    fclose(out);
+
+    printf("atlas %d %d %d\n", BAKE_ATLAS_WIDTH, height, 0);
+    for (int i = 0; i < glyph_count; i++) {
+        BakeItem* item = &items[i];
+        printf("glyph %d %d %d %d %d %d %d %d\n", item->codepoint, item->offset_x, item->offset_y, item->advance_x, item->x, item->y, item->width, item->height);
+    }
+    for (int i = 0; i < icon_count; i++) printf("icon %d %d %d\n", items[glyph_count + i].x + BAKE_SDF_PADDING, items[glyph_count + i].y + BAKE_SDF_PADDING, font_size);
+    return 0;
+}
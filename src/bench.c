@@ -0,0 +1,374 @@
+// mus-bench
+// Runs the non-UI parts of mus against a music folder without opening a
+// window and prints the results as JSON on stdout, one key per part, from
+// scanning and tag parsing to the background work the player relies on.
+//
+// Usage: mus-bench [-n iterations] [-v] <music folder>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "library.h"
+
+#define BENCH_COVER_SIZE 144
+#define BENCH_WAVE_TRACKS 16 // every overview decodes a whole track
+#define BENCH_SPECTRUM_TRANSFORMS 1000
+
+typedef struct {
+    double* samples; // seconds
+    double total;
+} BenchTimes;
+
+double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+BenchTimes bench_times_new() {
+    return (BenchTimes) {.samples = da_new(double), .total = 0};
+}
+
+void bench_times_add(BenchTimes* t, double seconds) {
+    da_push(t->samples, seconds);
+    t->total += seconds;
+}
+
+int bench_compare(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+double bench_percentile(BenchTimes* t, double p) {
+    size_t count = da_length(t->samples);
+    if (count == 0) return 0;
+    size_t index = p * (count - 1) + 0.5;
+    return t->samples[index];
+}
+
+// Prints the "latency_us" object and frees the samples
+void bench_print_latency(BenchTimes* t) {
+    size_t count = da_length(t->samples);
+    qsort(t->samples, count, sizeof(double), bench_compare);
+    printf("\"latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f}",
+           count ? t->total / count * 1e6 : 0,
+           bench_percentile(t, 0.50) * 1e6, bench_percentile(t, 0.90) * 1e6,
+           bench_percentile(t, 0.99) * 1e6, bench_percentile(t, 1.00) * 1e6);
+    da_free(t->samples);
+}
+
+size_t bench_tag_size(char* path) {
+    ID3v2_TagHeader* header = ID3v2_read_tag_header(path);
+    if (header == NULL) return 0;
+    size_t size = header->tag_size + ID3v2_TAG_HEADER_LENGTH;
+    ID3v2_TagHeader_free(header);
+    return size;
+}
+
+void bench_print_string(const char* str) {
+    putchar('"');
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\') putchar('\\');
+        putchar(*str);
+    }
+    putchar('"');
+}
+
+long bench_peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char** argv) {
+    int iterations = 5;
+    char* root = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-v") == 0) library_verbose = true;
+        else root = argv[i];
+    }
+    if (root == NULL || iterations < 1) {
+        fprintf(stderr, "Usage: %s [-n iterations] [-v] <music folder>\n", argv[0]);
+        return 1;
+    }
+    struct stat st;
+    if (stat(root, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "%s is not a folder\n", root);
+        return 1;
+    }
+
+    char savestate[64];
+    snprintf(savestate, sizeof(savestate), "/tmp/mus-bench-%d.savestate", (int) getpid());
+
+    printf("{\n  \"root\": ");
+    bench_print_string(root);
+    printf(",\n  \"iterations\": %d,\n", iterations);
+
+    // Cold scan: every file is new and gets parsed
+    library_init();
+    double start = bench_now();
+    music_scan(root);
+    double scan_time = bench_now() - start;
+    size_t files = da_length(library_files);
+    printf("  \"files\": %zu,\n  \"albums\": %zu,\n", files, da_length(albums) - 1);
+    printf("  \"scan\": {\"seconds\": %.6f, \"files_per_sec\": %.1f},\n", scan_time, scan_time > 0 ? files / scan_time : 0);
+
+    // Rescan of an unchanged folder: only stats, no parsing
+    BenchTimes rescan = bench_times_new();
+    for (int i = 0; i < iterations; i++) {
+        start = bench_now();
+        music_scan(root);
+        bench_times_add(&rescan, bench_now() - start);
+    }
+    printf("  \"rescan\": {\"seconds\": %.6f, \"files_per_sec\": %.1f},\n", rescan.total / iterations, rescan.total > 0 ? files * iterations / rescan.total : 0);
+    da_free(rescan.samples);
+
+    // Tag parsing of every file in the library
+    BenchTimes parse = bench_times_new();
+    size_t tag_bytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        for (size_t j = 0; j < files; j++) {
+            char* path = library_files[j].path;
+            if (i == 0) tag_bytes += bench_tag_size(path);
+            start = bench_now();
+            ID3v2_TagView* tag = ID3v2_read_tag_view(path);
+            bench_times_add(&parse, bench_now() - start);
+            if (tag != NULL) ID3v2_TagView_free(tag);
+        }
+    }
+    printf("  \"tag_parse\": {\"tags\": %zu, \"bytes\": %zu, \"files_per_sec\": %.1f, \"mb_per_sec\": %.3f, ",
+           files, tag_bytes, parse.total > 0 ? files * iterations / parse.total : 0,
+           parse.total > 0 ? tag_bytes * iterations / parse.total / (1024.0 * 1024.0) : 0);
+    bench_print_latency(&parse);
+    printf("},\n");
+
+    // Savestate round trips
+    BenchTimes save = bench_times_new();
+    BenchTimes load = bench_times_new();
+    long savestate_size = 0;
+    for (int i = 0; i < iterations; i++) {
+        start = bench_now();
+        config_save(savestate);
+        bench_times_add(&save, bench_now() - start);
+        if (stat(savestate, &st) == 0) savestate_size = st.st_size;
+        library_free();
+        library_init();
+        start = bench_now();
+        config_load(savestate);
+        bench_times_add(&load, bench_now() - start);
+    }
+    unlink(savestate);
+    printf("  \"savestate_save\": {\"bytes\": %ld, ", savestate_size);
+    bench_print_latency(&save);
+    printf("},\n  \"savestate_load\": {\"bytes\": %ld, ", savestate_size);
+    bench_print_latency(&load);
+    printf("},\n");
+
+    // Playlist: queue the whole library, then empty it again from the front
+    BenchTimes add = bench_times_new();
+    BenchTimes remove = bench_times_new();
+    for (int i = 0; i < iterations; i++) {
+        for (size_t j = 0; j < files; j++) {
+            start = bench_now();
+            playlist_add(library_files[j].path);
+            bench_times_add(&add, bench_now() - start);
+        }
+        while (da_length(playlist) != 0) {
+            start = bench_now();
+            playlist_remove(0);
+            bench_times_add(&remove, bench_now() - start);
+        }
+    }
+    printf("  \"playlist_add\": {\"ops\": %zu, ", da_length(add.samples));
+    bench_print_latency(&add);
+    printf("},\n  \"playlist_remove\": {\"ops\": %zu, ", da_length(remove.samples));
+    bench_print_latency(&remove);
+    printf("},\n");
+
+    // Covers shared between albums are stored and decoded once
+    size_t with_cover = 0, unique_covers = 0, cover_bytes = 0;
+    for (size_t j = 1; j < da_length(albums); j++) with_cover += albums[j].cover != 0;
+    for (size_t j = 1; j < da_length(covers); j++) {
+        if (covers[j].data == NULL) continue;
+        unique_covers++;
+        cover_bytes += covers[j].size;
+    }
+    printf("  \"covers\": {\"albums_with_cover\": %zu, \"unique\": %zu, \"bytes\": %zu},\n", with_cover, unique_covers, cover_bytes);
+
+    // Covers, decoded for a card (font_size*6 in the UI) and at full size
+    BenchTimes thumbnail = bench_times_new();
+    BenchTimes full = bench_times_new();
+    size_t decoded = 0, thumbnail_pixels = 0, full_pixels = 0;
+    for (int i = 0; i < iterations; i++) {
+        for (size_t j = 1; j < da_length(covers); j++) {
+            Cover cover = covers[j];
+            int w = 0, h = 0;
+            start = bench_now();
+            unsigned char* pixels = cover_decode(cover.data, cover.size, BENCH_COVER_SIZE, &w, &h);
+            double elapsed = bench_now() - start;
+            if (pixels == NULL) continue;
+            free(pixels);
+            bench_times_add(&thumbnail, elapsed);
+            if (i == 0) { decoded++; thumbnail_pixels += (size_t) w*h; }
+
+            start = bench_now();
+            pixels = cover_decode(cover.data, cover.size, 0, &w, &h);
+            bench_times_add(&full, bench_now() - start);
+            free(pixels);
+            if (i == 0) full_pixels += (size_t) w*h;
+        }
+    }
+    printf("  \"cover_thumbnail\": {\"covers\": %zu, \"pixels\": %zu, ", decoded, thumbnail_pixels);
+    bench_print_latency(&thumbnail);
+    printf("},\n  \"cover_full\": {\"covers\": %zu, \"pixels\": %zu, ", decoded, full_pixels);
+    bench_print_latency(&full);
+    printf("},\n");
+
+    // Thumbnails through a cache of their own: the first pass makes them, the rest read them back
+    char thumbs[64];
+    snprintf(thumbs, sizeof(thumbs), "/tmp/mus-bench-%d.thumbs", (int) getpid());
+    thumb_dir = thumbs;
+    BenchTimes thumb_miss = bench_times_new();
+    BenchTimes thumb_hit = bench_times_new();
+    for (int i = 0; i <= iterations; i++) {
+        for (size_t j = 1; j < da_length(covers); j++) {
+            Cover cover = covers[j];
+            start = bench_now();
+            unsigned char* pixels = thumb_get(cover.data, cover.size, cover.hash, BENCH_COVER_SIZE);
+            double elapsed = bench_now() - start;
+            if (pixels == NULL) continue;
+            free(pixels);
+            bench_times_add(i == 0 ? &thumb_miss : &thumb_hit, elapsed);
+        }
+    }
+    DIR* dir = opendir(thumbs);
+    struct dirent* entry;
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        char path[384];
+        snprintf(path, sizeof(path), "%s/%s", thumbs, entry->d_name);
+        if (entry->d_name[0] != '.') unlink(path);
+    }
+    if (dir != NULL) closedir(dir);
+    rmdir(thumbs);
+    printf("  \"thumbnail_miss\": {\"covers\": %zu, ", da_length(thumb_miss.samples));
+    bench_print_latency(&thumb_miss);
+    printf("},\n  \"thumbnail_hit\": {\"covers\": %zu, ", da_length(thumb_hit.samples));
+    bench_print_latency(&thumb_hit);
+    printf("},\n");
+
+    // Waveform overviews of the first few tracks, cached the same way
+    char waves[64];
+    snprintf(waves, sizeof(waves), "/tmp/mus-bench-%d.waves", (int) getpid());
+    wave_dir = waves;
+    BenchTimes wave_miss = bench_times_new();
+    BenchTimes wave_hit = bench_times_new();
+    size_t wave_tracks = files < BENCH_WAVE_TRACKS ? files : BENCH_WAVE_TRACKS;
+    for (int i = 0; i <= iterations; i++) {
+        for (size_t j = 0; j < wave_tracks; j++) {
+            start = bench_now();
+            unsigned char* wave = wave_get(library_files[j].path);
+            double elapsed = bench_now() - start;
+            if (wave == NULL) continue;
+            free(wave);
+            bench_times_add(i == 0 ? &wave_miss : &wave_hit, elapsed);
+        }
+    }
+    dir = opendir(waves);
+    while (dir != NULL && (entry = readdir(dir)) != NULL) {
+        char path[384];
+        snprintf(path, sizeof(path), "%s/%s", waves, entry->d_name);
+        if (entry->d_name[0] != '.') unlink(path);
+    }
+    if (dir != NULL) closedir(dir);
+    rmdir(waves);
+    printf("  \"waveform_miss\": {\"tracks\": %zu, ", da_length(wave_miss.samples));
+    bench_print_latency(&wave_miss);
+    printf("},\n  \"waveform_hit\": {\"tracks\": %zu, ", da_length(wave_hit.samples));
+    bench_print_latency(&wave_hit);
+    printf("},\n");
+
+    // Loudness: single tracks, then the whole library through the worker pool
+    BenchTimes loudness = bench_times_new();
+    for (int i = 0; i < iterations; i++) {
+        for (size_t j = 0; j < wave_tracks; j++) {
+            LibraryFile result = {0};
+            start = bench_now();
+            bool ok = loudness_analyze(library_files[j].path, &result);
+            double elapsed = bench_now() - start;
+            if (ok) bench_times_add(&loudness, elapsed);
+        }
+    }
+    printf("  \"loudness_track\": {\"tracks\": %zu, ", da_length(loudness.samples));
+    bench_print_latency(&loudness);
+    printf("},\n");
+
+    start = bench_now();
+    loudness_start();
+    do {
+        loudness_update();
+        usleep(1000);
+    } while (loudness_pending() != 0);
+    loudness_stop();
+    double pool_time = bench_now() - start;
+    size_t measured = 0;
+    double audio_seconds = 0;
+    for (size_t j = 0; j < files; j++) {
+        if (library_files[j].duration <= 0) continue;
+        measured++;
+        audio_seconds += library_files[j].duration;
+    }
+    printf("  \"loudness_library\": {\"files\": %zu, \"measured\": %zu, \"seconds\": %.6f, \"files_per_sec\": %.1f, \"audio_x_realtime\": %.1f},\n",
+           files, measured, pool_time, pool_time > 0 ? files / pool_time : 0, pool_time > 0 ? audio_seconds / pool_time : 0);
+
+    // Prefetching: the first few tracks read whole, a request's worth at a time
+    prefetch_start();
+    size_t prefetched = 0, prefetched_bytes = 0;
+    start = bench_now();
+    for (size_t j = 0; j < wave_tracks; j += PREFETCH_SLOTS) {
+        char* paths[PREFETCH_SLOTS];
+        size_t count = 0;
+        for (; count < PREFETCH_SLOTS && j + count < wave_tracks; count++) paths[count] = library_files[j + count].path;
+        prefetch_request(paths, count);
+        while (prefetch_pending() != 0) usleep(100);
+        for (size_t k = 0; k < count; k++) {
+            size_t size = 0;
+            unsigned char* data = prefetch_take(paths[k], &size);
+            if (data == NULL) continue;
+            prefetched++;
+            prefetched_bytes += size;
+            free(data);
+        }
+    }
+    double prefetch_time = bench_now() - start;
+    prefetch_stop();
+    printf("  \"prefetch\": {\"tracks\": %zu, \"bytes\": %zu, \"seconds\": %.6f, \"mb_per_sec\": %.1f},\n",
+           prefetched, prefetched_bytes, prefetch_time, prefetch_time > 0 ? prefetched_bytes / 1048576.0 / prefetch_time : 0);
+
+    // Spectrum: one transform per frame drawn, of noise since the cost does not depend on the audio
+    float* spectrum_frames = malloc(SPECTRUM_SIZE*2*sizeof(float));
+    srand(1);
+    for (size_t j = 0; j < SPECTRUM_SIZE*2; j++) spectrum_frames[j] = rand() / (float) RAND_MAX * 2 - 1;
+    BenchTimes spectrum = bench_times_new();
+    for (int i = 0; i < iterations*BENCH_SPECTRUM_TRANSFORMS; i++) {
+        Spectrum result;
+        start = bench_now();
+        spectrum_compute(spectrum_frames, 48000, &result);
+        bench_times_add(&spectrum, bench_now() - start);
+    }
+    free(spectrum_frames);
+    printf("  \"spectrum\": {\"transforms\": %zu, \"size\": %d, ", da_length(spectrum.samples), SPECTRUM_SIZE);
+    bench_print_latency(&spectrum);
+    printf("},\n");
+
+    library_free();
+
+    printf("  \"peak_rss_kb\": %ld\n}\n", bench_peak_rss_kb());
+    return 0;
+}
@@ -1,16 +1,24 @@
 
+#include <stdlib.h>
+#include <string.h>
+
+#include "library.h"
+
+// Savestates start with a magic and a version number. Files written before
+// versioning was introduced start right with the album count (version 1).
+#define CONFIG_MAGIC "MUSS"
+#define CONFIG_VERSION 6
+
 void config_write_string(FILE* f, char* str) {
     uint32_t strl = strlen(str);
     fwrite(&strl, sizeof(strl), 1, f);
     fwrite(str, sizeof(char), strl, f);
 }
 
-void config_write_image(FILE* f, Image img) {
-    int bytesize = 0;
-    unsigned char* file = ExportImageToMemory(img, ".png", &bytesize);
-    uint32_t size = bytesize;
+// Covers are stored exactly as they were embedded in the tag (PNG or JPEG)
+void config_write_blob(FILE* f, unsigned char* data, uint32_t size) {
     fwrite(&size, sizeof(size), 1, f);
-    fwrite(file, sizeof(unsigned char), size, f);
+    if (size != 0) fwrite(data, sizeof(unsigned char), size, f);
 }
 
 char* config_read_string(FILE* f) {
@@ -22,15 +30,31 @@ char* config_read_string(FILE* f) {
     return str;
 }
 
-Image config_read_image(FILE* f) {
-    uint32_t size = 0;
-    fread(&size, sizeof(size), 1, f);
-    unsigned char str[size];
-    fread(str, sizeof(unsigned char), size, f);
-    return LoadImageFromMemory(".png", str, size);
+unsigned char* config_read_blob(FILE* f, uint32_t* size) {
+    *size = 0;
+    fread(size, sizeof(*size), 1, f);
+    if (*size == 0) return NULL;
+    unsigned char* data = malloc(*size);
+    *size = fread(data, sizeof(unsigned char), *size, f);
+    return data;
 }
 
-void config_save_albums(FILE* f) {
+// Every cover is written once, albums refer to it by its position here plus
+// one. Returns the position of every cover id, so the albums can be written.
+uint32_t* config_save_covers(FILE* f) {
+    uint32_t* positions = calloc(da_length(covers), sizeof(uint32_t));
+    uint32_t cover_count = 0;
+    for (size_t i = 1; i < da_length(covers); i++) if (covers[i].data != NULL) positions[i] = ++cover_count;
+    fwrite(&cover_count, sizeof(cover_count), 1, f);
+    for (size_t i = 1; i < da_length(covers); i++) {
+        if (covers[i].data == NULL) continue;
+        config_write_blob(f, covers[i].data, covers[i].size);
+        fwrite(&covers[i].hash, sizeof(covers[i].hash), 1, f);
+    }
+    return positions;
+}
+
+void config_save_albums(FILE* f, uint32_t* cover_positions) {
     uint32_t album_count = da_length(albums)-1;
     fwrite(&album_count, sizeof(album_count), 1, f);
     for (size_t i = 1; i < da_length(albums); i++) {
@@ -38,7 +62,7 @@ void config_save_albums(FILE* f) {
         config_write_string(f, album.name);
         config_write_string(f, album.artists);
         config_write_string(f, album.genres);
-        config_write_image(f, album.cover_image);
+        fwrite(&cover_positions[album.cover], sizeof(uint32_t), 1, f);
         uint32_t album_size = da_length(album.playlist);
         fwrite(&album_size, sizeof(album_size), 1, f);
         for (size_t i = 0; i < da_length(album.playlist); i++) config_write_string(f, album.playlist[i]);
@@ -51,14 +75,68 @@ void config_save_playlist(FILE* f) {
     for (size_t i = 0; i < da_length(playlist); i++) config_write_string(f, playlist[i]);
 }
 
-void config_save() {
-    FILE* f = fopen(".mus-savestate", "wb");
-    config_save_albums(f);
+void config_save_unsorted(FILE* f) {
+    char** list = albums[0].playlist;
+    uint32_t size = da_length(list);
+    fwrite(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < da_length(list); i++) config_write_string(f, list[i]);
+}
+
+void config_save_files(FILE* f) {
+    uint32_t size = da_length(library_files);
+    fwrite(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < da_length(library_files); i++) {
+        LibraryFile file = library_files[i];
+        config_write_string(f, file.path);
+        fwrite(&file.size, sizeof(file.size), 1, f);
+        fwrite(&file.mtime, sizeof(file.mtime), 1, f);
+        fwrite(&file.inode, sizeof(file.inode), 1, f);
+        fwrite(&file.duration, sizeof(file.duration), 1, f);
+        fwrite(&file.loudness, sizeof(file.loudness), 1, f);
+        fwrite(&file.peak, sizeof(file.peak), 1, f);
+    }
+}
+
+void config_save_roots(FILE* f) {
+    uint32_t size = da_length(library_roots);
+    fwrite(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < da_length(library_roots); i++) config_write_string(f, library_roots[i]);
+}
+
+void config_save(const char* path) {
+    FILE* f = fopen(path, "wb");
+    if (f == NULL) return;
+    uint32_t version = CONFIG_VERSION;
+    fwrite(CONFIG_MAGIC, 1, 4, f);
+    fwrite(&version, sizeof(version), 1, f);
+    uint32_t* cover_positions = config_save_covers(f);
+    config_save_albums(f, cover_positions);
+    free(cover_positions);
     config_save_playlist(f);
+    config_save_unsorted(f);
+    config_save_files(f);
+    config_save_roots(f);
     fclose(f);
 }
 
-void config_load_albums(FILE* f) {
+// The loader holds a reference on every cover until the albums took theirs
+size_t* config_load_covers(FILE* f) {
+    uint32_t cover_count = 0;
+    fread(&cover_count, sizeof(cover_count), 1, f);
+    size_t* ids = da_new(size_t);
+    for (uint32_t i = 0; i < cover_count; i++) {
+        uint32_t size = 0;
+        uint64_t hash = 0;
+        unsigned char* data = config_read_blob(f, &size);
+        fread(&hash, sizeof(hash), 1, f);
+        size_t id = cover_add(data, size, hash);
+        da_push(ids, id);
+        free(data);
+    }
+    return ids;
+}
+
+void config_load_albums(FILE* f, uint32_t version, size_t* cover_ids) {
     uint32_t album_count = 0;
     fread(&album_count, sizeof(uint32_t), 1, f);
     for (uint32_t i = 0; i < album_count; i++) {
@@ -66,11 +144,20 @@ void config_load_albums(FILE* f) {
         album.name = config_read_string(f);
         album.artists = config_read_string(f);
         album.genres = config_read_string(f);
-        album.cover_image = config_read_image(f);
-        Image img = ImageCopy(album.cover_image);
-        ImageResize(&img, font_size*6.f, font_size*6.f);
-        album.cover = LoadTextureFromImage(img);
-        UnloadImage(img);
+        if (version >= 5) {
+            uint32_t position = 0;
+            fread(&position, sizeof(position), 1, f);
+            if (position != 0 && position <= da_length(cover_ids)) album.cover = cover_ids[position-1];
+            cover_retain(album.cover);
+        } else { // every album had a copy of its cover, and a hash from version 4 on
+            uint32_t size = 0;
+            uint64_t hash = 0;
+            unsigned char* data = config_read_blob(f, &size);
+            if (version >= 4) fread(&hash, sizeof(hash), 1, f);
+            else if (data != NULL) hash = ht_hash(data, size);
+            album.cover = cover_add(data, size, hash);
+            free(data);
+        }
         uint32_t album_size = 0;
         fread(&album_size, sizeof(album_size), 1, f);
         album.playlist = da_new(char*);
@@ -85,14 +172,75 @@ void config_load_albums(FILE* f) {
 void config_load_playlist(FILE* f) {
     uint32_t size = 0;
     fread(&size, sizeof(size), 1, f);
-    for (size_t i = 0; i < size; i++) music_add_to_playlist(config_read_string(f));
-    music_unload();
+    for (size_t i = 0; i < size; i++) {
+        char* path = config_read_string(f);
+        playlist_add(path);
+        free(path);
+    }
     playlist_position = -1;
 }
 
-void config_load() {
-    FILE* f = fopen(".mus-savestate", "rb");
-    config_load_albums(f);
+void config_load_unsorted(FILE* f) {
+    uint32_t size = 0;
+    fread(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < size; i++) da_push(albums[0].playlist, config_read_string(f));
+}
+
+// Loudness came with version 6, older files are measured again
+void config_load_files(FILE* f, uint32_t version) {
+    uint32_t size = 0;
+    fread(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < size; i++) {
+        LibraryFile file = {0};
+        file.path = config_read_string(f);
+        fread(&file.size, sizeof(file.size), 1, f);
+        fread(&file.mtime, sizeof(file.mtime), 1, f);
+        fread(&file.inode, sizeof(file.inode), 1, f);
+        if (version >= 6) {
+            fread(&file.duration, sizeof(file.duration), 1, f);
+            fread(&file.loudness, sizeof(file.loudness), 1, f);
+            fread(&file.peak, sizeof(file.peak), 1, f);
+        }
+        library_add_file(file);
+    }
+}
+
+void config_load_roots(FILE* f) {
+    uint32_t size = 0;
+    fread(&size, sizeof(size), 1, f);
+    for (size_t i = 0; i < size; i++) da_push(library_roots, config_read_string(f));
+}
+
+void config_migrate_files() {
+    // No fingerprints were saved, so register every known track with an empty
+    // one: the next scan will re-parse them instead of adding them twice
+    for (size_t i = 0; i < da_length(albums); i++) {
+        for (size_t j = 0; j < da_length(albums[i].playlist); j++) {
+            char* path = albums[i].playlist[j];
+            if (ht_get(&library_index, path, NULL)) continue;
+            LibraryFile file = {.path = malloc(strlen(path)+1)};
+            memcpy(file.path, path, strlen(path)+1);
+            library_add_file(file);
+        }
+    }
+}
+
+void config_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return;
+    char magic[4] = {0};
+    uint32_t version = 1;
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, CONFIG_MAGIC, 4) == 0) fread(&version, sizeof(version), 1, f);
+    else fseek(f, 0, SEEK_SET);
+    size_t* cover_ids = version >= 5 ? config_load_covers(f) : da_new(size_t);
+    config_load_albums(f, version, cover_ids);
+    for (size_t i = 0; i < da_length(cover_ids); i++) cover_release(cover_ids[i]);
+    da_free(cover_ids);
     config_load_playlist(f);
+    if (version >= 2) {
+        config_load_unsorted(f);
+        config_load_files(f, version);
+    } else config_migrate_files();
+    if (version >= 3) config_load_roots(f);
     fclose(f);
 }
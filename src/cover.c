@@ -0,0 +1,548 @@
+// Cover decoding.
+// Album cards show covers a couple hundred pixels wide, while the pictures
+// embedded in tags are often 3000 pixels or more. Baseline JPEGs are decoded
+// straight at 1/2, 1/4 or 1/8 of their size: every block keeps only its low
+// frequency DCT coefficients and goes through a 4x4, 2x2 or 1x1 inverse DCT,
+// so the full size image never exists. Progressive JPEGs are decoded at 1/8
+// from their DC scans alone, the rest of the file is skipped. Anything else
+// (PNGs, full size decodes, JPEG flavours not handled here) goes through
+// stb_image and is then halved with a box filter down to about the size asked.
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Static, so it doesn't clash with the copy inside raylib. What this file
+// doesn't call of it would warn as unused
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+#define STBI_NO_GIF // its declaration comes before STBI_ONLY_* leave it out
+#define STBI_NO_STDIO
+#include "external/stb_image.h"
+#pragma GCC diagnostic pop
+
+#include "library.h"
+
+#define COVER_FAST_BITS 9
+
+typedef struct {
+    uint16_t fast[1 << COVER_FAST_BITS]; // length << 8 | symbol, 0 if the code is longer
+    int16_t fast_ac[1 << COVER_FAST_BITS]; // value << 8 | run << 4 | length with the value bits, 0 if they don't fit
+    int32_t maxcode[18];
+    int32_t valptr[17];
+    uint8_t symbols[256];
+    bool defined;
+} CoverHuffman;
+
+typedef struct {
+    int id, h, v, tq;
+    int dc_table, ac_table;
+    int bw, bh;       // blocks across and down, padded to whole MCUs
+    uint8_t* plane;   // decoded samples, bw*n by bh*n
+    int16_t* dc;      // progressive only, one DC coefficient per block
+    int pred;
+} CoverComponent;
+
+typedef struct {
+    const uint8_t* data;
+    size_t size, pos;
+    uint64_t bits; // left aligned
+    int count;
+
+    int width, height;
+    int hmax, vmax, mcux, mcuy;
+    int n; // samples per block side: 8 >> shift
+    bool progressive, rgb;
+    int restart_interval;
+    int component_count;
+    CoverComponent components[3];
+    uint16_t quant[4][64]; // natural order
+    CoverHuffman huffman[8]; // 0..3 DC, 4..7 AC
+} CoverJpeg;
+
+const uint8_t cover_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// cover_idct_table[log2(n)][x][u] = C(u) cos((2x+1)u pi / 2n) / 2, the usual
+// 8 point IDCT evaluated on an n point grid
+float cover_idct_table[3][4][4];
+bool cover_idct_ready = false;
+
+void cover_idct_init() {
+    if (cover_idct_ready) return;
+    for (int log = 0; log < 3; log++) {
+        int n = 1 << log;
+        for (int x = 0; x < n; x++) {
+            for (int u = 0; u < n; u++) {
+                float c = u == 0 ? 1.f/sqrtf(2.f) : 1.f;
+                cover_idct_table[log][x][u] = c*cosf((2*x + 1)*u*(float) M_PI/(2*n))/2.f;
+            }
+        }
+    }
+    cover_idct_ready = true;
+}
+
+uint8_t cover_clamp(int x) {
+    return x < 0 ? 0 : x > 255 ? 255 : x;
+}
+
+// coefficients are dequantized, natural order, only the top left n by n are read
+void cover_idct(const int* coefficients, int n, uint8_t* out, int stride) {
+    if (n == 1) { *out = cover_clamp((coefficients[0] + 4*(coefficients[0] >= 0 ? 1 : -1))/8 + 128); return; }
+    bool flat = true;
+    for (int v = 0; v < n && flat; v++) for (int u = 0; u < n; u++) if ((u | v) && coefficients[v*8 + u]) { flat = false; break; }
+    if (flat) { // smooth blocks are common and come out as a single value
+        uint8_t value = cover_clamp(lrintf(coefficients[0]/8.f) + 128);
+        for (int y = 0; y < n; y++) memset(out + y*stride, value, n);
+        return;
+    }
+    int log = n == 2 ? 1 : 2;
+    float tmp[4][4];
+    for (int v = 0; v < n; v++) {
+        for (int x = 0; x < n; x++) {
+            float sum = 0;
+            for (int u = 0; u < n; u++) sum += cover_idct_table[log][x][u]*coefficients[v*8 + u];
+            tmp[v][x] = sum;
+        }
+    }
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            float sum = 0;
+            for (int v = 0; v < n; v++) sum += cover_idct_table[log][y][v]*tmp[v][x];
+            out[y*stride + x] = cover_clamp(lrintf(sum) + 128);
+        }
+    }
+}
+
+// Bits of the entropy coded data. Stops at the next marker and reads zeros from there on
+void cover_fill(CoverJpeg* j) {
+    while (j->count <= 56) {
+        uint64_t byte = 0;
+        if (j->pos < j->size) {
+            byte = j->data[j->pos];
+            if (byte == 0xFF) {
+                uint8_t next = j->pos + 1 < j->size ? j->data[j->pos + 1] : 0xD9;
+                if (next == 0x00) j->pos += 2;
+                else byte = 0; // a marker, leave it for the caller
+            } else j->pos++;
+        }
+        j->bits |= byte << (56 - j->count);
+        j->count += 8;
+    }
+}
+
+int cover_get_bits(CoverJpeg* j, int count) {
+    if (count == 0) return 0;
+    cover_fill(j);
+    int value = j->bits >> (64 - count);
+    j->bits <<= count;
+    j->count -= count;
+    return value;
+}
+
+// The value of a count bit magnitude category, see F.2.2.1 of the spec
+int cover_extend(CoverJpeg* j, int count) {
+    if (count == 0) return 0;
+    int value = cover_get_bits(j, count);
+    return value < (1 << (count - 1)) ? value - (1 << count) + 1 : value;
+}
+
+int cover_decode_symbol(CoverJpeg* j, CoverHuffman* h) {
+    cover_fill(j);
+    uint16_t fast = h->fast[j->bits >> (64 - COVER_FAST_BITS)];
+    if (fast != 0) {
+        j->bits <<= fast >> 8;
+        j->count -= fast >> 8;
+        return fast & 0xFF;
+    }
+    for (int length = COVER_FAST_BITS + 1; length <= 16; length++) {
+        int32_t code = j->bits >> (64 - length);
+        if (code <= h->maxcode[length]) {
+            j->bits <<= length;
+            j->count -= length;
+            return h->symbols[h->valptr[length] + code];
+        }
+    }
+    return -1; // corrupt data
+}
+
+bool cover_build_huffman(CoverHuffman* h, const uint8_t* counts, const uint8_t* symbols, int total) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->symbols, symbols, total);
+    int code = 0, k = 0;
+    for (int length = 1; length <= 16; length++) {
+        h->valptr[length] = k - code;
+        if (code + counts[length - 1] > (1 << length)) return false; // more codes than the length has, the fill would overrun fast
+        for (int i = 0; i < counts[length - 1]; i++, k++, code++) {
+            if (length <= COVER_FAST_BITS) {
+                int shift = COVER_FAST_BITS - length;
+                for (int fill = 0; fill < (1 << shift); fill++) h->fast[(code << shift) | fill] = (length << 8) | symbols[k];
+            }
+        }
+        h->maxcode[length] = counts[length - 1] ? code - 1 : -1;
+        code <<= 1;
+    }
+    h->maxcode[17] = INT32_MAX;
+
+    // Short AC codes followed by a short value are decoded in one lookup
+    for (int i = 0; i < (1 << COVER_FAST_BITS); i++) {
+        if (h->fast[i] == 0) continue;
+        int length = h->fast[i] >> 8, run = h->fast[i] >> 4 & 15, size = h->fast[i] & 15;
+        if (size == 0 || length + size > COVER_FAST_BITS) continue;
+        int value = (i << length & ((1 << COVER_FAST_BITS) - 1)) >> (COVER_FAST_BITS - size);
+        if (value < (1 << (size - 1))) value += 1 - (1 << size);
+        if (value >= -128 && value <= 127) h->fast_ac[i] = value*256 + run*16 + length + size;
+    }
+    h->defined = true;
+    return true;
+}
+
+uint16_t cover_read16(const uint8_t* p) {
+    return p[0] << 8 | p[1];
+}
+
+// Restart markers reset the predictions and start on a fresh byte
+void cover_restart(CoverJpeg* j) {
+    j->bits = 0;
+    j->count = 0;
+    while (j->pos + 1 < j->size && !(j->data[j->pos] == 0xFF && j->data[j->pos + 1] != 0)) j->pos++;
+    if (j->pos + 1 < j->size && j->data[j->pos + 1] >= 0xD0 && j->data[j->pos + 1] <= 0xD7) j->pos += 2;
+    for (int i = 0; i < j->component_count; i++) j->components[i].pred = 0;
+}
+
+bool cover_decode_block(CoverJpeg* j, CoverComponent* c, int bx, int by) {
+    if (j->progressive) return false;
+    int coefficients[64];
+    int n = j->n;
+    for (int v = 0; v < n; v++) for (int u = 0; u < n; u++) coefficients[v*8 + u] = 0;
+    const uint16_t* q = j->quant[c->tq];
+
+    int s = cover_decode_symbol(j, &j->huffman[c->dc_table]);
+    if (s < 0 || s > 11) return false;
+    c->pred += cover_extend(j, s);
+    coefficients[0] = c->pred*q[0];
+
+    CoverHuffman* ac = &j->huffman[4 + c->ac_table];
+    for (int k = 1; k < 64;) {
+        cover_fill(j);
+        int fast = ac->fast_ac[j->bits >> (64 - COVER_FAST_BITS)];
+        if (fast != 0) {
+            j->bits <<= fast & 15;
+            j->count -= fast & 15;
+            k += fast >> 4 & 15;
+            if (k > 63) return false;
+            int natural = cover_zigzag[k];
+            if ((natural & 7) < n && (natural >> 3) < n) coefficients[natural] = (fast >> 8)*q[natural];
+            k++;
+            continue;
+        }
+        int rs = cover_decode_symbol(j, ac);
+        if (rs < 0) return false;
+        int run = rs >> 4, size = rs & 15;
+        if (size == 0) {
+            if (run != 15) break; // end of block
+            k += 16;
+            continue;
+        }
+        k += run;
+        if (k > 63) return false;
+        int value = cover_extend(j, size);
+        int natural = cover_zigzag[k];
+        if ((natural & 7) < n && (natural >> 3) < n) coefficients[natural] = value*q[natural];
+        k++;
+    }
+
+    int stride = c->bw*n;
+    cover_idct(coefficients, n, c->plane + by*n*stride + bx*n, stride);
+    return true;
+}
+
+// Progressive DC scans, the first one and the refinements that add one bit each
+bool cover_decode_dc(CoverJpeg* j, CoverComponent* c, int bx, int by, int ah, int al) {
+    int16_t* dc = &c->dc[by*c->bw + bx];
+    if (ah == 0) {
+        int s = cover_decode_symbol(j, &j->huffman[c->dc_table]);
+        if (s < 0 || s > 11) return false;
+        c->pred += cover_extend(j, s);
+        *dc = c->pred*(1 << al);
+    } else if (cover_get_bits(j, 1)) *dc |= 1 << al;
+    return true;
+}
+
+// Skips the entropy coded data up to the next marker that is not a restart
+void cover_skip_scan(CoverJpeg* j) {
+    while (j->pos + 1 < j->size) {
+        if (j->data[j->pos] == 0xFF && j->data[j->pos + 1] != 0 && !(j->data[j->pos + 1] >= 0xD0 && j->data[j->pos + 1] <= 0xD7)) return;
+        j->pos++;
+    }
+    j->pos = j->size;
+}
+
+bool cover_decode_scan(CoverJpeg* j, const uint8_t* header) {
+    int count = header[0];
+    if (count < 1 || count > j->component_count) return false;
+    CoverComponent* scan[3];
+    for (int i = 0; i < count; i++) {
+        scan[i] = NULL;
+        for (int c = 0; c < j->component_count; c++) {
+            if (j->components[c].id == header[1 + i*2]) scan[i] = &j->components[c];
+        }
+        if (scan[i] == NULL) return false;
+        scan[i]->dc_table = header[2 + i*2] >> 4 & 3;
+        scan[i]->ac_table = header[2 + i*2] & 3;
+        scan[i]->pred = 0;
+    }
+    int ss = header[1 + count*2], ah = header[3 + count*2] >> 4, al = header[3 + count*2] & 15;
+
+    if (j->progressive && ss != 0) { // AC, not needed at 1/8
+        cover_skip_scan(j);
+        return true;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!j->huffman[scan[i]->dc_table].defined && !(j->progressive && ah != 0)) return false;
+        if (!j->progressive && !j->huffman[4 + scan[i]->ac_table].defined) return false;
+    }
+
+    j->bits = 0;
+    j->count = 0;
+    int todo = j->restart_interval;
+    if (count == 1) {
+        // Not interleaved: the component's own blocks in raster order, without the MCU padding
+        CoverComponent* c = scan[0];
+        int across = ((j->width*c->h + j->hmax - 1)/j->hmax + 7)/8;
+        int down = ((j->height*c->v + j->vmax - 1)/j->vmax + 7)/8;
+        for (int by = 0; by < down; by++) {
+            for (int bx = 0; bx < across; bx++) {
+                if (j->restart_interval && todo-- == 0) { cover_restart(j); todo = j->restart_interval - 1; }
+                bool ok = j->progressive ? cover_decode_dc(j, c, bx, by, ah, al) : cover_decode_block(j, c, bx, by);
+                if (!ok) return false;
+            }
+        }
+    } else {
+        for (int my = 0; my < j->mcuy; my++) {
+            for (int mx = 0; mx < j->mcux; mx++) {
+                if (j->restart_interval && todo-- == 0) { cover_restart(j); todo = j->restart_interval - 1; }
+                for (int i = 0; i < count; i++) {
+                    CoverComponent* c = scan[i];
+                    for (int y = 0; y < c->v; y++) {
+                        for (int x = 0; x < c->h; x++) {
+                            int bx = mx*c->h + x, by = my*c->v + y;
+                            bool ok = j->progressive ? cover_decode_dc(j, c, bx, by, ah, al) : cover_decode_block(j, c, bx, by);
+                            if (!ok) return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    cover_skip_scan(j);
+    return true;
+}
+
+bool cover_read_frame(CoverJpeg* j, const uint8_t* p, size_t length) {
+    if (length < 6 || p[0] != 8) return false; // 12 bit samples aren't worth it
+    j->height = cover_read16(p + 1);
+    j->width = cover_read16(p + 3);
+    j->component_count = p[5];
+    if (j->width == 0 || j->height == 0) return false;
+    if ((j->component_count != 1 && j->component_count != 3) || length < 6 + 3u*j->component_count) return false;
+    j->hmax = j->vmax = 1;
+    for (int i = 0; i < j->component_count; i++) {
+        CoverComponent* c = &j->components[i];
+        c->id = p[6 + i*3];
+        c->h = p[7 + i*3] >> 4;
+        c->v = p[7 + i*3] & 15;
+        c->tq = p[8 + i*3] & 3;
+        if (c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4) return false;
+        if (c->h > j->hmax) j->hmax = c->h;
+        if (c->v > j->vmax) j->vmax = c->v;
+    }
+    if (j->component_count == 1) j->hmax = j->vmax = j->components[0].h = j->components[0].v = 1;
+    j->mcux = (j->width + 8*j->hmax - 1)/(8*j->hmax);
+    j->mcuy = (j->height + 8*j->vmax - 1)/(8*j->vmax);
+    for (int i = 0; i < j->component_count; i++) {
+        CoverComponent* c = &j->components[i];
+        c->bw = j->mcux*c->h;
+        c->bh = j->mcuy*c->v;
+        c->plane = calloc((size_t) c->bw*j->n*c->bh*j->n, 1);
+        if (j->progressive) c->dc = calloc((size_t) c->bw*c->bh, sizeof(int16_t));
+        if (c->plane == NULL || (j->progressive && c->dc == NULL)) return false;
+    }
+    if (j->component_count == 3 && j->components[0].id == 'R' && j->components[1].id == 'G' && j->components[2].id == 'B') j->rgb = true;
+    return true;
+}
+
+unsigned char* cover_jpeg_to_rgba(CoverJpeg* j, int* width, int* height) {
+    if (j->progressive) {
+        for (int i = 0; i < j->component_count; i++) {
+            CoverComponent* c = &j->components[i];
+            for (int b = 0; b < c->bw*c->bh; b++) {
+                int coefficient = c->dc[b]*j->quant[c->tq][0];
+                cover_idct(&coefficient, 1, &c->plane[b], 1);
+            }
+        }
+    }
+
+    int shift = j->n == 1 ? 3 : j->n == 2 ? 2 : 1;
+    int w = (j->width + (1 << shift) - 1) >> shift, h = (j->height + (1 << shift) - 1) >> shift;
+    unsigned char* pixels = malloc((size_t) w*h*4);
+    int* columns = malloc((size_t) w*j->component_count*sizeof(int)); // subsampled components are stretched
+    if (pixels == NULL || columns == NULL) { free(pixels); free(columns); return NULL; }
+    for (int i = 0; i < j->component_count; i++) {
+        for (int x = 0; x < w; x++) columns[i*w + x] = x*j->components[i].h/j->hmax;
+    }
+    for (int y = 0; y < h; y++) {
+        unsigned char* out = pixels + (size_t) y*w*4;
+        const uint8_t* rows[3];
+        for (int i = 0; i < j->component_count; i++) {
+            CoverComponent* c = &j->components[i];
+            rows[i] = c->plane + (size_t) (y*c->v/j->vmax)*c->bw*j->n;
+        }
+        for (int x = 0; x < w; x++) {
+            if (j->component_count == 1) {
+                out[0] = out[1] = out[2] = rows[0][x];
+            } else {
+                int a = rows[0][columns[x]];
+                int b = rows[1][columns[w + x]];
+                int c = rows[2][columns[2*w + x]];
+                if (j->rgb) { out[0] = a; out[1] = b; out[2] = c; }
+                else {
+                    // JFIF YCbCr, 16.16 fixed point
+                    b -= 128; c -= 128;
+                    out[0] = cover_clamp(a + ((91881*c + 32768) >> 16));
+                    out[1] = cover_clamp(a - ((22554*b + 46802*c + 32768) >> 16));
+                    out[2] = cover_clamp(a + ((116130*b + 32768) >> 16));
+                }
+            }
+            out[3] = 255;
+            out += 4;
+        }
+    }
+    free(columns);
+    *width = w;
+    *height = h;
+    return pixels;
+}
+
+// shift is 1, 2 or 3. NULL if the file uses something this decoder doesn't do
+unsigned char* cover_decode_jpeg_scaled(const uint8_t* data, size_t size, int shift, int* width, int* height) {
+    CoverJpeg* j = calloc(1, sizeof(CoverJpeg));
+    j->data = data;
+    j->size = size;
+    j->n = 8 >> shift;
+    cover_idct_init();
+
+    unsigned char* pixels = NULL;
+    bool frame = false, adobe_rgb = false;
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) { pos++; continue; } // garbage between segments
+        uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) { pos++; continue; } // fill bytes
+        if (marker == 0xD9) break; // EOI
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { pos += 2; continue; }
+        size_t length = cover_read16(data + pos + 2);
+        if (length < 2 || pos + 2 + length > size) goto fail;
+        const uint8_t* p = data + pos + 4;
+        length -= 2;
+        pos += 2 + 2 + length;
+
+        if (marker == 0xC0 || marker == 0xC1 || marker == 0xC2) {
+            if (frame) goto fail;
+            j->progressive = marker == 0xC2;
+            if (j->progressive && shift != 3) goto fail;
+            if (!cover_read_frame(j, p, length)) goto fail;
+            frame = true;
+        } else if ((marker >= 0xC3 && marker <= 0xCF) && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+            goto fail; // lossless, hierarchical or arithmetic coded
+        } else if (marker == 0xC4) {
+            while (length >= 17) {
+                int table = p[0] >> 4 ? 4 + (p[0] & 3) : p[0] & 3;
+                int total = 0;
+                for (int i = 0; i < 16; i++) total += p[1 + i];
+                if (total > 256 || length < 17u + total) goto fail;
+                if (!cover_build_huffman(&j->huffman[table], p + 1, p + 17, total)) goto fail;
+                p += 17 + total;
+                length -= 17 + total;
+            }
+        } else if (marker == 0xDB) {
+            while (length >= 65) {
+                int precision = p[0] >> 4, table = p[0] & 3;
+                if (length < (precision ? 129u : 65u)) goto fail;
+                for (int i = 0; i < 64; i++) j->quant[table][cover_zigzag[i]] = precision ? cover_read16(p + 1 + i*2) : p[1 + i];
+                p += precision ? 129 : 65;
+                length -= precision ? 129 : 65;
+            }
+        } else if (marker == 0xDD) {
+            if (length < 2) goto fail;
+            j->restart_interval = cover_read16(p);
+        } else if (marker == 0xEE) {
+            if (length >= 12 && memcmp(p, "Adobe", 5) == 0 && p[11] == 0) adobe_rgb = true;
+        } else if (marker == 0xDA) {
+            if (!frame || length < 1u + p[0]*2 + 3) goto fail;
+            j->pos = pos;
+            if (!cover_decode_scan(j, p)) goto fail;
+            pos = j->pos;
+        }
+    }
+    if (!frame) goto fail;
+    if (adobe_rgb && j->component_count == 3) j->rgb = true;
+    pixels = cover_jpeg_to_rgba(j, width, height);
+
+fail:
+    for (int i = 0; i < 3; i++) {
+        free(j->components[i].plane);
+        free(j->components[i].dc);
+    }
+    free(j);
+    return pixels;
+}
+
+// Averages every 2x2 square, in place. An odd last row or column is dropped
+void cover_halve(unsigned char* pixels, int* width, int* height) {
+    int w = *width/2, h = *height/2, stride = *width*4;
+    for (int y = 0; y < h; y++) {
+        const unsigned char* a = pixels + (size_t) y*2*stride;
+        const unsigned char* b = a + stride;
+        unsigned char* out = pixels + (size_t) y*w*4;
+        for (int x = 0; x < w*4; x++) {
+            int i = (x & ~3)*2 + (x & 3);
+            out[x] = (a[i] + a[i + 4] + b[i] + b[i + 4] + 2) >> 2;
+        }
+    }
+    *width = w;
+    *height = h;
+}
+
+unsigned char* cover_decode(const unsigned char* data, uint32_t size, int min_size, int* width, int* height) {
+    *width = *height = 0;
+    if (data == NULL || size < 4) return NULL;
+
+    bool jpeg = data[0] == 0xFF && data[1] == 0xD8;
+    int w = 0, h = 0, channels = 0;
+    if (jpeg && min_size > 0 && stbi_info_from_memory(data, size, &w, &h, &channels)) {
+        int shift = 3;
+        int smaller = w < h ? w : h;
+        while (shift > 0 && (smaller >> shift) < min_size) shift--;
+        if (shift > 0) {
+            unsigned char* pixels = cover_decode_jpeg_scaled(data, size, shift, width, height);
+            if (pixels != NULL) return pixels;
+        }
+    }
+
+    unsigned char* pixels = stbi_load_from_memory(data, size, &w, &h, &channels, 4);
+    if (pixels == NULL) return NULL;
+    while (min_size > 0 && w/2 >= min_size && h/2 >= min_size) cover_halve(pixels, &w, &h);
+    *width = w;
+    *height = h;
+    return pixels;
+}
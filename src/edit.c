@@ -0,0 +1,278 @@
+// Album wide tag edits.
+// Every file of the album becomes a task for a small pool of background
+// threads, which rewrite the tags with id3v2lib while the UI keeps running.
+// The main thread collects the results. Every written file takes its new
+// fingerprint right away, so neither the watcher nor the next scan parses it
+// again, and once every file of a job made it the album itself takes the new
+// values in one go. If any file failed the album is left as it was and the
+// written files are parsed again.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "uc.h"
+
+#include "library.h"
+
+#define EDIT_WORKERS 4
+
+typedef struct {
+    char* album; // by name, album indices move around while the job runs
+    AlbumEdit edit;
+    size_t total, done, failed;
+    char** written; // paths, parsed again if the job fails
+} EditJob;
+
+typedef struct {
+    EditJob* job;
+    char* path;
+} EditTask;
+
+typedef struct {
+    EditJob* job;
+    char* path;
+    bool ok;
+    LibraryFile fingerprint;
+} EditResult;
+
+pthread_t edit_threads[EDIT_WORKERS];
+size_t edit_thread_count = 0;
+pthread_mutex_t edit_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t edit_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by edit_lock
+bool edit_quit = false;
+EditTask* edit_tasks = 0;
+size_t edit_tasks_position = 0;
+EditResult* edit_results = 0;
+
+// Owned by the main thread
+EditJob** edit_jobs = 0;
+
+char* edit_strdup(const char* str) {
+    char* copy = malloc(strlen(str)+1);
+    memcpy(copy, str, strlen(str)+1);
+    return copy;
+}
+
+void edit_free_fields(AlbumEdit* edit) {
+    free(edit->artists);
+    free(edit->genres);
+    free(edit->cover_data);
+}
+
+// id3v2lib takes latin-1 or UTF-16 with a BOM, anything past ASCII goes as the latter
+void edit_set_text(ID3v2_Tag* tag, void (*set)(ID3v2_Tag* tag, const char* text), char* text) {
+    bool ascii = true;
+    for (char* c = text; *c != 0; c++) if ((unsigned char) *c >= 0x80) { ascii = false; break; }
+    if (ascii) { set(tag, text); return; }
+    size_t size = strlen(text)*4 + 8;
+    char* utf16 = calloc(size, 1);
+    uc_utf8_to_utf16_buffered(text, utf16, size, 0, false, UC_BYTE_ORDER_BOM);
+    set(tag, utf16);
+    free(utf16);
+}
+
+// The flags byte of the file's ID3v2 header, -1 if it has none
+int edit_header_flags(char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return -1;
+    unsigned char header[6] = {0};
+    bool found = fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, "ID3", 3) == 0;
+    fclose(file);
+    return found ? header[5] : -1;
+}
+
+// Only a file without a tag gets a new one, writing an empty tag over one
+// id3v2lib could not read would throw away every frame it holds. Neither does
+// it undo unsynchronisation, the frames of such a tag would be read mangled or
+// not at all and written back that way, so those files are left alone too
+bool edit_write_file(char* path, AlbumEdit* edit) {
+    int flags = edit_header_flags(path);
+    if (flags != -1 && (flags & 0x80)) return false;
+    ID3v2_Tag* tag = ID3v2_read_tag(path);
+    if (tag == NULL && flags != -1) return false;
+    if (tag == NULL) tag = ID3v2_Tag_new_empty();
+    if (edit->artists != NULL) edit_set_text(tag, ID3v2_Tag_set_album_artist, edit->artists);
+    if (edit->genres != NULL) edit_set_text(tag, ID3v2_Tag_set_genre, edit->genres);
+    if (edit->year != 0) {
+        char year[16];
+        snprintf(year, sizeof(year), "%d", edit->year);
+        ID3v2_Tag_set_year(tag, year);
+    }
+    if (edit->cover_data != NULL) {
+        bool png = edit->cover_size >= 4 && memcmp(edit->cover_data, "\x89PNG", 4) == 0;
+        ID3v2_Tag_set_album_cover(tag, png ? ID3v2_MIME_TYPE_PNG : ID3v2_MIME_TYPE_JPG, edit->cover_size, (const char*) edit->cover_data);
+    }
+    bool ok = ID3v2_write_tag(path, tag) == 0;
+    ID3v2_Tag_free(tag);
+    return ok;
+}
+
+void* edit_main(void* arg) {
+    (void) arg;
+    while (true) {
+        pthread_mutex_lock(&edit_lock);
+        while (!edit_quit && edit_tasks_position == da_length(edit_tasks)) pthread_cond_wait(&edit_wake, &edit_lock);
+        if (edit_quit) {
+            pthread_mutex_unlock(&edit_lock);
+            break;
+        }
+        EditTask task = edit_tasks[edit_tasks_position++];
+        if (edit_tasks_position == da_length(edit_tasks)) {
+            _da_set(edit_tasks, DA_LENGTH, 0);
+            edit_tasks_position = 0;
+        }
+        pthread_mutex_unlock(&edit_lock);
+
+        EditResult result = {.job = task.job, .path = task.path};
+        result.ok = edit_write_file(task.path, &task.job->edit);
+        if (result.ok) result.ok = library_stat(task.path, &result.fingerprint);
+
+        pthread_mutex_lock(&edit_lock);
+        da_push(edit_results, result);
+        pthread_mutex_unlock(&edit_lock);
+    }
+    return NULL;
+}
+
+void edit_start() {
+    edit_tasks = da_new(EditTask);
+    edit_results = da_new(EditResult);
+    edit_jobs = da_new(EditJob*);
+    for (size_t i = 0; i < EDIT_WORKERS; i++) {
+        if (pthread_create(&edit_threads[edit_thread_count], NULL, edit_main, NULL) == 0) edit_thread_count++;
+    }
+}
+
+// Tasks nobody picked up yet are dropped, a file is never left half written
+void edit_stop() {
+    if (edit_jobs == NULL) return;
+    pthread_mutex_lock(&edit_lock);
+    edit_quit = true;
+    pthread_cond_broadcast(&edit_wake);
+    pthread_mutex_unlock(&edit_lock);
+    for (size_t i = 0; i < edit_thread_count; i++) pthread_join(edit_threads[i], NULL);
+    edit_thread_count = 0;
+
+    for (size_t i = edit_tasks_position; i < da_length(edit_tasks); i++) free(edit_tasks[i].path);
+    for (size_t i = 0; i < da_length(edit_results); i++) free(edit_results[i].path);
+    for (size_t i = 0; i < da_length(edit_jobs); i++) {
+        for (size_t j = 0; j < da_length(edit_jobs[i]->written); j++) free(edit_jobs[i]->written[j]);
+        da_free(edit_jobs[i]->written);
+        edit_free_fields(&edit_jobs[i]->edit);
+        free(edit_jobs[i]->album);
+        free(edit_jobs[i]);
+    }
+    da_free(edit_tasks);
+    da_free(edit_results);
+    da_free(edit_jobs);
+    edit_jobs = NULL;
+}
+
+EditJob* edit_find_job(const char* album) {
+    for (size_t i = 0; i < da_length(edit_jobs); i++) {
+        if (strcmp(edit_jobs[i]->album, album) == 0) return edit_jobs[i];
+    }
+    return NULL;
+}
+
+bool edit_album(size_t index, AlbumEdit edit) {
+    Album* album = &albums[index];
+    if (edit_thread_count == 0 || index == 0 || da_length(album->playlist) == 0 || edit_find_job(album->name) != NULL) {
+        edit_free_fields(&edit);
+        return false;
+    }
+
+    EditJob* job = calloc(1, sizeof(EditJob));
+    job->album = edit_strdup(album->name);
+    job->edit = edit;
+    job->total = da_length(album->playlist);
+    job->written = da_new(char*);
+    da_push(edit_jobs, job);
+
+    pthread_mutex_lock(&edit_lock);
+    for (size_t i = 0; i < da_length(album->playlist); i++) {
+        EditTask task = {.job = job, .path = edit_strdup(album->playlist[i])};
+        da_push(edit_tasks, task);
+    }
+    pthread_cond_broadcast(&edit_wake);
+    pthread_mutex_unlock(&edit_lock);
+    library_log("Writing tags of %zu files of %s", job->total, job->album);
+    return true;
+}
+
+bool edit_album_progress(const char* name, size_t* done, size_t* total) {
+    EditJob* job = edit_jobs == NULL ? NULL : edit_find_job(name);
+    if (job == NULL) return false;
+    *done = job->done;
+    *total = job->total;
+    return true;
+}
+
+void edit_apply(EditJob* job) {
+    Album* album = NULL;
+    for (size_t i = 1; i < da_length(albums); i++) {
+        if (strcmp(albums[i].name, job->album) == 0) { album = &albums[i]; break; }
+    }
+    if (album == NULL) return; // went away while the files were written
+    AlbumEdit* edit = &job->edit;
+    if (edit->artists != NULL) { free(album->artists); album->artists = edit->artists; edit->artists = NULL; }
+    if (edit->genres != NULL) { free(album->genres); album->genres = edit->genres; edit->genres = NULL; }
+    if (edit->year != 0) album->year = edit->year;
+    if (edit->cover_data != NULL) {
+        size_t old = album->cover;
+        album->cover = cover_add(edit->cover_data, edit->cover_size, ht_hash(edit->cover_data, edit->cover_size));
+        cover_release(old);
+    }
+}
+
+void edit_update() {
+    if (edit_jobs == NULL || da_length(edit_jobs) == 0) return;
+
+    pthread_mutex_lock(&edit_lock);
+    for (size_t i = 0; i < da_length(edit_results); i++) {
+        EditResult result = edit_results[i];
+        result.job->done++;
+        if (result.ok) {
+            size_t index = 0;
+            if (ht_get(&library_index, result.path, &index)) {
+                library_files[index].size = result.fingerprint.size;
+                library_files[index].mtime = result.fingerprint.mtime;
+                library_files[index].inode = result.fingerprint.inode;
+            }
+            da_push(result.job->written, result.path);
+            continue;
+        }
+        result.job->failed++;
+        library_log("Could not write the tag of %s", result.path);
+        free(result.path);
+    }
+    _da_set(edit_results, DA_LENGTH, 0);
+    pthread_mutex_unlock(&edit_lock);
+
+    for (size_t i = da_length(edit_jobs); i > 0; i--) {
+        EditJob* job = edit_jobs[i-1];
+        if (job->done != job->total) continue;
+        if (job->failed == 0) edit_apply(job);
+        else library_log("%zu of %zu files of %s were not written, the album is left as it was", job->failed, job->total, job->album);
+        for (size_t j = 0; j < da_length(job->written); j++) {
+            size_t index = 0;
+            if (job->failed != 0 && ht_get(&library_index, job->written[j], &index)) {
+                // A zeroed fingerprint never matches, so the file is parsed again
+                library_files[index].size = 0;
+                library_files[index].mtime = 0;
+                library_update_file(job->written[j]);
+            }
+            free(job->written[j]);
+        }
+        da_free(job->written);
+        edit_free_fields(&job->edit);
+        free(job->album);
+        free(job);
+        memmove(edit_jobs + i-1, edit_jobs + i, da_stride(edit_jobs) * (da_length(edit_jobs) - i));
+        da_pop(edit_jobs, NULL);
+    }
+}
@@ -0,0 +1,134 @@
+// ht.h
+//
+// Open addressing hash map from C strings to size_t values, done in the same
+// fashion as da.h.
+//
+// Instuctions:
+// To use: Define HT_IMPL and include this header ONCE.
+// In all other files just include it, without any definitions.
+//
+// NOTE: keys are NOT copied, they are borrowed from the caller and have to
+// outlive their entry in the map.
+
+#ifndef HT_H_
+#define HT_H_
+
+// Header file
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HT_START_SIZE 64
+
+typedef struct {
+    const char* key; // NULL - empty slot, HT_TOMBSTONE - removed slot
+    uint64_t hash;
+    size_t value;
+} HtEntry;
+
+typedef struct {
+    HtEntry* entries;
+    size_t capacity;
+    size_t count; // live entries
+    size_t used;  // live entries + tombstones
+} Ht;
+
+Ht ht_new(void);
+// -> Create an empty map
+
+uint64_t ht_hash(const void* data, size_t size);
+// -> FNV-1a hash of SIZE bytes at DATA
+
+bool ht_get(Ht* ht, const char* key, size_t* value);
+// -> Look up KEY, write its value to VALUE (can be NULL). Returns false if the key is not present.
+
+void ht_set(Ht* ht, const char* key, size_t value);
+// -> Insert KEY or overwrite its value
+
+void ht_remove(Ht* ht, const char* key);
+// -> Remove KEY from the map, if it is present
+
+void ht_free(Ht* ht);
+// -> Destroy the map (keys are not freed)
+
+#ifdef HT_IMPL
+
+static const char ht_tombstone_key = 0;
+#define HT_TOMBSTONE (&ht_tombstone_key)
+
+Ht ht_new(void) {
+    Ht ht = {0};
+    ht.capacity = HT_START_SIZE;
+    ht.entries = calloc(ht.capacity, sizeof(HtEntry));
+    return ht;
+}
+
+uint64_t ht_hash(const void* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= ((const unsigned char*) data)[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static HtEntry* _ht_find(Ht* ht, const char* key, uint64_t hash, bool for_insert) {
+    HtEntry* tombstone = NULL;
+    size_t mask = ht->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        HtEntry* e = &ht->entries[i];
+        if (e->key == NULL) return for_insert && tombstone != NULL ? tombstone : e;
+        if (e->key == HT_TOMBSTONE) { if (tombstone == NULL) tombstone = e; continue; }
+        if (e->hash == hash && strcmp(e->key, key) == 0) return e;
+    }
+}
+
+static void _ht_resize(Ht* ht, size_t capacity) {
+    HtEntry* old = ht->entries;
+    size_t old_capacity = ht->capacity;
+    ht->entries = calloc(capacity, sizeof(HtEntry));
+    ht->capacity = capacity;
+    ht->used = ht->count;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].key == NULL || old[i].key == HT_TOMBSTONE) continue;
+        *_ht_find(ht, old[i].key, old[i].hash, true) = old[i];
+    }
+    free(old);
+}
+
+bool ht_get(Ht* ht, const char* key, size_t* value) {
+    HtEntry* e = _ht_find(ht, key, ht_hash(key, strlen(key)), false);
+    if (e->key == NULL) return false;
+    if (value != NULL) *value = e->value;
+    return true;
+}
+
+void ht_set(Ht* ht, const char* key, size_t value) {
+    if ((ht->used + 1)*4 > ht->capacity*3) _ht_resize(ht, ht->count*2 >= ht->capacity/2 ? ht->capacity*2 : ht->capacity);
+    uint64_t hash = ht_hash(key, strlen(key));
+    HtEntry* e = _ht_find(ht, key, hash, true);
+    if (e->key == NULL) { ht->count++; ht->used++; }
+    else if (e->key == HT_TOMBSTONE) ht->count++;
+    e->key = key;
+    e->hash = hash;
+    e->value = value;
+}
+
+void ht_remove(Ht* ht, const char* key) {
+    HtEntry* e = _ht_find(ht, key, ht_hash(key, strlen(key)), false);
+    if (e->key == NULL) return;
+    e->key = HT_TOMBSTONE;
+    ht->count--;
+}
+
+void ht_free(Ht* ht) {
+    free(ht->entries);
+    ht->entries = NULL;
+    ht->capacity = ht->count = ht->used = 0;
+}
+
+#endif // HT_IMPL
+
+#endif // HT_H_
@@ -0,0 +1,481 @@
+#include <dirent.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define UC_IMPL
+#include "uc.h"
+
+#define DA_IMPL
+#include "da.h"
+
+#define HT_IMPL
+#include "ht.h"
+
+#include "library.h"
+
+#ifdef _WIN32
+#include "win32.h"
+
+char* GetShortPath(char *path) {
+    static char shortPath[MAX_PATH];
+    wchar_t wPath[MAX_PATH];
+    wchar_t wShortPath[MAX_PATH];
+    MultiByteToWideChar(CP_UTF8, 0, path, -1, wPath, MAX_PATH);
+    GetShortPathNameW(wPath, wShortPath, MAX_PATH);
+    WideCharToMultiByte(CP_UTF8, 0, wShortPath, -1, shortPath, MAX_PATH, NULL, NULL);
+    return shortPath;
+}
+
+char* to_utf8(char *path) {
+    static char shortPath[MAX_PATH];
+    wchar_t wPath[MAX_PATH];
+    MultiByteToWideChar(CP_ACP, 0, path, -1, wPath, MAX_PATH);
+    WideCharToMultiByte(CP_UTF8, 0, wPath, -1, shortPath, MAX_PATH, NULL, NULL);
+    return shortPath;
+}
+#endif
+
+char** playlist = 0;
+int playlist_position = -1;
+
+bool library_verbose = false;
+void (*cover_free_hook)(Cover* cover) = NULL;
+void (*album_remove_hook)(size_t index) = NULL;
+
+char utf8str[1024] = {0};
+
+Album* albums;
+Cover* covers;
+Ht cover_index;
+
+char* utf162utf8(char* utf16str) {
+    uc_utf16_to_utf8_buffered(utf16str, utf8str, 1024, 0, UC_BYTE_ORDER_BOM, false);
+    return utf8str;
+}
+
+char* music_string_from_textframe(ID3v2_TextFrame* data) {
+    if (data == NULL) return "";
+    char* str;
+    if (data->data->encoding == 1) str = utf162utf8(data->data->text);    else str = data->data->text;
+    return str;
+}
+
+// frame payloads aren't null terminated, so the text is copied out with a few zero bytes after it first
+char* music_string_from_frame_view(const ID3v2_FrameView* frame) {
+    static char text[1024 + 4];
+    if (frame == NULL || frame->size < 1) return "";
+    int size = frame->size - 1;
+    if (size > 1024) size = 1024;
+    memcpy(text, frame->data + 1, size);
+    memset(text + size, 0, 4);
+
+    char encoding = frame->data[0];
+    if (encoding == 1) uc_utf16_to_utf8_buffered(text, utf8str, 1024, 0, UC_BYTE_ORDER_BOM, false);
+    else if (encoding == 2) uc_utf16_to_utf8_buffered(text, utf8str, 1024, 0, UC_BYTE_ORDER_BIG, false);
+    else {
+        if (size > (int) sizeof(utf8str) - 1) size = sizeof(utf8str) - 1; // room for the terminator
+        memcpy(utf8str, text, size);
+        utf8str[size] = 0;
+    }
+    return utf8str;
+}
+
+char* music_get_text_from_path(char* path, const char* frame_id) {
+    ID3v2_TagView* tag = ID3v2_read_tag_view(path);
+    if (tag == NULL) return "";
+    char* str = music_string_from_frame_view(ID3v2_TagView_get_frame(tag, frame_id));
+    ID3v2_TagView_free(tag);
+    return str;
+}
+
+char* music_get_artist_from_path(char* path) {
+    return music_get_text_from_path(path, ID3v2_ARTIST_FRAME_ID);
+}
+
+char* music_get_album_artists_from_path(char* path) {
+    char* str = music_get_text_from_path(path, ID3v2_ALBUM_ARTIST_FRAME_ID);
+    if (*str == 0) return music_get_artist_from_path(path);
+    return str;
+}
+
+char* music_get_title_from_path(char* path) {
+    return music_get_text_from_path(path, ID3v2_TITLE_FRAME_ID);
+}
+
+int music_get_no_from_path(char* path) {
+    char* str = music_get_text_from_path(path, ID3v2_TRACK_FRAME_ID);
+    while (*str == '0') str++;
+    return atoi(str);
+}
+
+char* music_get_album_name_from_path(char* path) {
+    return music_get_text_from_path(path, ID3v2_ALBUM_FRAME_ID);
+}
+
+char* music_get_genres_from_path(char* path) {
+    return music_get_text_from_path(path, ID3v2_GENRE_FRAME_ID);
+}
+
+int music_get_year_from_path(char* path) {
+    return atoi(music_get_text_from_path(path, ID3v2_YEAR_FRAME_ID));
+}
+
+size_t cover_add(const unsigned char* data, uint32_t size, uint64_t hash) {
+    if (data == NULL || size == 0) return 0;
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long) hash);
+    size_t id = 0;
+    if (ht_get(&cover_index, key, &id) && covers[id].size == size && memcmp(covers[id].data, data, size) == 0) {
+        covers[id].refs++;
+        return id;
+    }
+
+    Cover cover = {.data = malloc(size), .size = size, .hash = hash, .refs = 1};
+    memcpy(cover.data, data, size);
+    if (id == 0) { // a different picture with the same hash keeps its place in the index
+        cover.key = malloc(sizeof(key));
+        memcpy(cover.key, key, sizeof(key));
+    }
+    for (id = 1; id < da_length(covers) && covers[id].data != NULL; id++);
+    if (id == da_length(covers)) da_push(covers, cover);
+    else covers[id] = cover;
+    if (cover.key != NULL) ht_set(&cover_index, cover.key, id);
+    return id;
+}
+
+void cover_retain(size_t id) {
+    if (id != 0) covers[id].refs++;
+}
+
+void cover_release(size_t id) {
+    if (id == 0 || --covers[id].refs != 0) return;
+    Cover* cover = &covers[id];
+    if (cover_free_hook != NULL) cover_free_hook(cover);
+    if (cover->key != NULL) {
+        ht_remove(&cover_index, cover->key);
+        free(cover->key);
+    }
+    free(cover->data);
+    *cover = (Cover) {0};
+}
+
+// Only pictures not in covers yet are copied out of the tag
+size_t music_get_cover_id_from_path(char* path) {
+    ID3v2_TagView* tag = ID3v2_read_tag_view(path);
+    if (tag == NULL) return 0;
+    int picture_size = 0;
+    const char* picture = ID3v2_FrameView_get_picture(ID3v2_TagView_get_frame(tag, ID3v2_ALBUM_COVER_FRAME_ID), &picture_size);
+    size_t id = 0;
+    if (picture != NULL && picture_size > 0) id = cover_add((const unsigned char*) picture, picture_size, ht_hash(picture, picture_size));
+    ID3v2_TagView_free(tag);
+    return id;
+}
+
+void album_new(char* name, char* path) {
+    char* mname    = malloc(strlen(name)    + 1); memcpy(mname,    name,    strlen(name)    + 1);
+    char* artists  = music_get_album_artists_from_path(path);
+    char* martists = malloc(strlen(artists) + 1); memcpy(martists, artists, strlen(artists) + 1);
+    char* genres   = music_get_genres_from_path(path);
+    char* mgenres  = malloc(strlen(genres)  + 1); memcpy(mgenres,  genres,  strlen(genres)  + 1);
+    Album a = {.name = mname, .artists = martists, .genres = mgenres, .year = music_get_year_from_path(path), .playlist = da_new(char*)};
+    a.cover = music_get_cover_id_from_path(path);
+    da_push(albums, a);
+}
+
+void album_remove(size_t index) {
+    if (album_remove_hook != NULL) album_remove_hook(index);
+    Album album = albums[index];
+    for (size_t i = 0; i < da_length(album.playlist); i++) free(album.playlist[i]);
+    da_free(album.playlist);
+    free(album.name);
+    free(album.genres);
+    free(album.artists);
+    cover_release(album.cover);
+    memmove(albums + index, albums + index + 1, da_stride(albums) * (da_length(albums) - index - 1));
+    da_pop(albums, NULL);
+}
+
+void album_add_song(char* path) {
+    char* mpath = malloc(strlen(path)+1); memcpy(mpath, path, strlen(path)+1);
+    char* name = music_get_album_name_from_path(path);
+    if (*name == 0) { da_push(albums[0].playlist, mpath); return; }
+    size_t index = 0;
+    bool found = false;
+    for (size_t i = 0; i < da_length(albums); i++) {
+        if (strcmp(albums[i].name, name) == 0) { found = true; index = i; break; }
+    }
+    if (!found) {
+        album_new(name, path);
+        index = da_length(albums)-1;
+    }
+    da_push(albums[index].playlist, mpath);
+}
+
+void album_remove_song(char* path) {
+    for (size_t i = 0; i < da_length(albums); i++) {
+        char** list = albums[i].playlist;
+        for (size_t j = 0; j < da_length(list); j++) {
+            if (strcmp(list[j], path) != 0) continue;
+            free(list[j]);
+            memmove(list + j, list + j + 1, da_stride(list) * (da_length(list) - j - 1));
+            da_pop(list, NULL);
+            if (da_length(list) == 0 && i != 0) album_remove(i);
+            return;
+        }
+    }
+}
+
+// A rescanned file keeps its place. Its album takes the new values if they came
+// from this file, its first track, and only a new album name moves the file
+void album_update_song(char* path) {
+    for (size_t i = 0; i < da_length(albums); i++) {
+        char** list = albums[i].playlist;
+        for (size_t j = 0; j < da_length(list); j++) {
+            if (strcmp(list[j], path) != 0) continue;
+            char* name = music_get_album_name_from_path(path);
+            if (i == 0 ? *name != 0 : strcmp(albums[i].name, name) != 0) {
+                album_remove_song(path);
+                album_add_song(path);
+                return;
+            }
+            if (i == 0 || j != 0) return;
+            Album* album = &albums[i];
+            free(album->artists); album->artists = strdup(music_get_album_artists_from_path(path));
+            free(album->genres);  album->genres  = strdup(music_get_genres_from_path(path));
+            album->year = music_get_year_from_path(path);
+            size_t old = album->cover;
+            album->cover = music_get_cover_id_from_path(path);
+            cover_release(old);
+            return;
+        }
+    }
+    album_add_song(path);
+}
+
+// Whether next comes right after path on their album
+bool album_follows(char* path, char* next) {
+    for (size_t i = 1; i < da_length(albums); i++) {
+        char** list = albums[i].playlist;
+        for (size_t j = 0; j + 1 < da_length(list); j++) {
+            if (strcmp(list[j], path) == 0) return strcmp(list[j + 1], next) == 0;
+        }
+    }
+    return false;
+}
+
+LibraryFile* library_files;
+Ht library_index; // path -> index in library_files
+uint32_t library_generation = 0;
+
+char** library_roots; // every folder ever passed to music_scan
+
+bool library_stat(char* path, LibraryFile* fp) {
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    fp->size = st.st_size;
+    fp->mtime = st.st_mtime;
+    fp->inode = st.st_ino;
+    return true;
+}
+
+// Names what was made from a file (overviews, decoded audio) by its path and
+// fingerprint, so a rewritten file gets a new key. 0 if it cannot be read
+uint64_t library_file_key(char* path) {
+    LibraryFile fp;
+    if (!library_stat(path, &fp)) return 0;
+    uint64_t key = ht_hash(path, strlen(path)) ^ ht_hash(&fp.size, sizeof(fp.size)) ^ (ht_hash(&fp.mtime, sizeof(fp.mtime)) << 1);
+    return key != 0 ? key : 1;
+}
+
+void library_add_file(LibraryFile file) {
+    file.generation = library_generation;
+    da_push(library_files, file);
+    ht_set(&library_index, file.path, da_length(library_files)-1);
+}
+
+void library_remove_file(size_t index) {
+    LibraryFile file = library_files[index];
+    ht_remove(&library_index, file.path);
+    size_t last = da_length(library_files)-1;
+    if (index != last) {
+        library_files[index] = library_files[last];
+        ht_set(&library_index, library_files[index].path, index);
+    }
+    da_pop(library_files, NULL);
+    free(file.path);
+}
+
+// Bring a single file up to date: parse it if it is new, re-parse it if its
+// fingerprint changed and drop it if it does not exist anymore.
+void library_update_file(char* path) {
+    size_t index = 0;
+    bool known = ht_get(&library_index, path, &index);
+    LibraryFile fp = {0};
+    if (!library_stat(path, &fp)) {
+        if (known) {
+            album_remove_song(path);
+            library_remove_file(index);
+        }
+        return;
+    }
+    if (known) {
+        LibraryFile* file = &library_files[index];
+        file->generation = library_generation;
+        if (file->size == fp.size && file->mtime == fp.mtime && file->inode == fp.inode) return;
+        library_log("Rescanning %s", path);
+        album_update_song(path);
+        file->size = fp.size; file->mtime = fp.mtime; file->inode = fp.inode;
+        file->duration = 0; // the audio may be new too, measure it again
+        return;
+    }
+    library_log("Scanning %s", path);
+    album_add_song(path);
+    fp.path = malloc(strlen(path)+1); memcpy(fp.path, path, strlen(path)+1);
+    library_add_file(fp);
+}
+
+bool library_path_in(char* path, char* root, size_t root_length) {
+    if (strncmp(path, root, root_length) != 0) return false;
+    if (root_length > 0 && (root[root_length-1] == '/' || root[root_length-1] == '\\')) return true;
+    return path[root_length] == '/' || path[root_length] == '\\';
+}
+
+void library_add_root(char* root) {
+    for (size_t i = 0; i < da_length(library_roots); i++) {
+        if (strcmp(library_roots[i], root) == 0) return;
+    }
+    char* mroot = malloc(strlen(root)+1); memcpy(mroot, root, strlen(root)+1);
+    da_push(library_roots, mroot);
+}
+
+bool library_is_mp3(const char* name) {
+    size_t length = strlen(name);
+    if (length < 4) return false;
+    const char* ext = name + length - 4;
+    return ext[0] == '.' && (ext[1] | 0x20) == 'm' && (ext[2] | 0x20) == 'p' && ext[3] == '3';
+}
+
+// Recursive directory walk, calls ON_FILE for every mp3 and ON_DIR (can be NULL) for every directory
+void library_walk(const char* path, void (*on_file)(const char* path), void (*on_dir)(const char* path)) {
+    DIR* dir = opendir(path);
+    if (dir == NULL) return;
+    if (on_dir != NULL) on_dir(path);
+    struct dirent* entry;
+    char* child = malloc(strlen(path) + 2 + 256);
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        child = realloc(child, strlen(path) + strlen(entry->d_name) + 2);
+#ifdef _WIN32
+        sprintf(child, "%s\\%s", path, entry->d_name);
+#else
+        sprintf(child, "%s/%s", path, entry->d_name);
+#endif
+        struct stat st;
+        if (stat(child, &st) != 0) continue;
+        if (S_ISDIR(st.st_mode)) library_walk(child, on_file, on_dir);
+        else if (library_is_mp3(entry->d_name)) on_file(child);
+    }
+    free(child);
+    closedir(dir);
+}
+
+void music_scan_file(const char* path) {
+    library_update_file(get_path(norm_text((char*) path)));
+}
+
+void music_scan(char* path) {
+    char* epath = get_path(path);
+    char* root = malloc(strlen(epath)+1); memcpy(root, epath, strlen(epath)+1);
+    size_t root_length = strlen(root);
+    library_add_root(root);
+    library_generation++;
+    library_walk(root, music_scan_file, NULL);
+    // Whatever lives under this folder and was not seen during the walk got deleted
+    for (size_t i = da_length(library_files); i > 0; i--) {
+        LibraryFile* file = &library_files[i-1];
+        if (file->generation == library_generation || !library_path_in(file->path, root, root_length)) continue;
+        library_log("Removing %s", file->path);
+        album_remove_song(file->path);
+        library_remove_file(i-1);
+    }
+    free(root);
+}
+
+bool music_ismusic(char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return false;
+    char magic[3] = {0};
+    if (fread(magic, 1, 3, f) != 3) {
+        fclose(f); return false;
+    }
+    fclose(f);
+    return memcmp(magic, "\xFF\xFB", 2) == 0 || memcmp(magic, "\xFF\xF3", 2) == 0 || memcmp(magic, "\xFF\xF2", 2) == 0 || memcmp(magic, "ID3", 3) == 0; // only mp3s are supported
+}
+
+char* music_get_name_playlist(size_t indice) {
+    return music_get_text_from_path(playlist[indice], ID3v2_TITLE_FRAME_ID);
+}
+
+char* music_get_artist_playlist(size_t indice) {
+    return music_get_text_from_path(playlist[indice], ID3v2_ARTIST_FRAME_ID);
+}
+
+char* music_get_album_playlist(size_t indice) {
+    return music_get_text_from_path(playlist[indice], ID3v2_ALBUM_FRAME_ID);
+}
+
+void playlist_add(char* path) {
+    char* realloced_path = malloc(strlen(path) + 1);
+    memcpy(realloced_path, path, strlen(path) + 1);
+    da_push(playlist, realloced_path);
+}
+
+void playlist_remove(size_t indice) {
+    if (playlist_position > (int) indice) playlist_position--;
+    else if ((int) indice == playlist_position) playlist_position = -1;
+    free(playlist[indice]);
+    memmove(playlist + indice, playlist + indice + 1, da_stride(playlist) * (da_length(playlist) - indice - 1));
+    da_pop(playlist, 0);
+}
+
+void library_log(const char* format, ...) {
+    if (!library_verbose) return;
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void library_init() {
+    playlist = da_new(char*);
+    albums = da_new(Album);
+    covers = da_new(Cover);
+    cover_index = ht_new();
+    Cover empty_cover = {0};
+    da_push(covers, empty_cover);
+    library_files = da_new(LibraryFile);
+    library_index = ht_new();
+    library_roots = da_new(char*);
+
+    Album empty_album = {.name = strdup("<not specified>"), .year = 0, .genres = strdup(""), .artists = strdup(""), .playlist = da_new(char*)};
+    da_push(albums, empty_album);
+}
+
+void library_free() {
+    while (da_length(albums) != 0) album_remove(da_length(albums)-1);
+    while (da_length(library_files) != 0) library_remove_file(da_length(library_files)-1);
+    while (da_length(playlist) != 0) playlist_remove(da_length(playlist)-1);
+    for (size_t i = 0; i < da_length(library_roots); i++) free(library_roots[i]);
+    ht_free(&library_index);
+    ht_free(&cover_index);
+    da_free(albums);
+    da_free(covers);
+    da_free(library_files);
+    da_free(playlist);
+    da_free(library_roots);
+    playlist_position = -1;
+}
@@ -0,0 +1,242 @@
+// library.h
+// Everything mus does that does not need a window or an audio device:
+// scanning folders, reading tags, keeping albums and the playlist, saving
+// and loading the savestate, watching the library for changes and writing
+// album edits back to the files.
+// Built into libmus.a, which both mus and mus-bench link against.
+
+#ifndef LIBRARY_H_
+#define LIBRARY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "raylib.h" // only for the Texture type, libmus never calls into raylib
+#include "id3v2lib.h"
+
+#include "da.h"
+#include "ht.h"
+
+#ifdef _WIN32
+char* GetShortPath(char* path);
+char* to_utf8(char* path);
+#define get_path(path) GetShortPath(path)
+#define norm_text(text) to_utf8(text)
+#else
+#define get_path(path) path
+#define norm_text(text) text
+#endif
+
+#define CONFIG_PATH ".mus-savestate"
+#define THUMBS_PATH ".mus-thumbs"
+#define WAVES_PATH ".mus-waves"
+
+typedef struct {
+    char* name;
+    char* artists;
+    char* genres;
+    size_t cover; // index in covers, 0 if there is none
+    int year;
+    char** playlist;
+} Album;
+
+// Embedded pictures are shared by every album that embeds the same bytes,
+// multi-disc releases and discographies often carry one cover many times.
+// Slot 0 stays empty so that 0 can mean "no cover".
+typedef struct {
+    unsigned char* data; // as stored in the tag (PNG or JPEG), NULL for a free slot
+    uint32_t size;
+    uint64_t hash;       // ht_hash of data, names its cached thumbnails
+    char* key;           // hash in hex, its key in cover_index
+    uint32_t refs;       // albums using it
+    Texture texture;     // uploaded by the UI the first time it is drawn
+} Cover;
+
+// Every file that made it into the library is fingerprinted, so that scanning
+// the same folder again only re-parses files that were added or changed.
+typedef struct {
+    char* path;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode; // always 0 on Windows
+    uint32_t generation;
+    // Loudness analysis (loudness.c), redone when the fingerprint changes
+    float duration; // seconds, 0 until analysed, negative if the file could not be decoded
+    float loudness; // integrated loudness in LUFS
+    float peak;     // true peak, 1 is full scale
+} LibraryFile;
+
+extern Album* albums;
+extern Cover* covers;
+extern Ht cover_index; // hash in hex -> index in covers
+extern LibraryFile* library_files;
+extern Ht library_index; // path -> index in library_files
+extern char** library_roots; // every folder ever passed to music_scan
+
+extern char** playlist;
+extern int playlist_position;
+
+extern bool library_verbose;
+extern void (*cover_free_hook)(Cover* cover); // lets the UI release what it attached to a cover
+extern void (*album_remove_hook)(size_t index); // lets the UI follow the albums after index, which move down one
+
+void library_init();
+void library_free();
+void library_log(const char* format, ...);
+
+char* utf162utf8(char* utf16str);
+char* music_string_from_textframe(ID3v2_TextFrame* data);
+char* music_string_from_frame_view(const ID3v2_FrameView* frame);
+char* music_get_text_from_path(char* path, const char* frame_id);
+char* music_get_artist_from_path(char* path);
+char* music_get_album_artists_from_path(char* path);
+char* music_get_title_from_path(char* path);
+int music_get_no_from_path(char* path);
+char* music_get_album_name_from_path(char* path);
+char* music_get_genres_from_path(char* path);
+int music_get_year_from_path(char* path);
+size_t music_get_cover_id_from_path(char* path);
+char* music_get_name_playlist(size_t indice);
+char* music_get_artist_playlist(size_t indice);
+char* music_get_album_playlist(size_t indice);
+bool music_ismusic(char* path);
+
+size_t cover_add(const unsigned char* data, uint32_t size, uint64_t hash); // copies data unless it is known already, the caller gets a reference
+void cover_retain(size_t id);
+void cover_release(size_t id);
+
+void album_new(char* name, char* path);
+void album_remove(size_t index);
+void album_add_song(char* path);
+void album_remove_song(char* path);
+void album_update_song(char* path);
+bool album_follows(char* path, char* next);
+
+bool library_stat(char* path, LibraryFile* fp);
+uint64_t library_file_key(char* path); // from the path and fingerprint, 0 if the file cannot be read
+void library_add_file(LibraryFile file);
+void library_remove_file(size_t index);
+void library_update_file(char* path);
+bool library_path_in(char* path, char* root, size_t root_length);
+void library_add_root(char* root);
+bool library_is_mp3(const char* name);
+void library_walk(const char* path, void (*on_file)(const char* path), void (*on_dir)(const char* path));
+void music_scan(char* path);
+
+void playlist_add(char* path);
+void playlist_remove(size_t indice);
+
+// Embedded pictures as RGBA pixels (cover.c). With min_size > 0 the picture
+// comes out at about the smallest size that keeps both sides at least
+// min_size, decoded at that size directly when the format allows it.
+unsigned char* cover_decode(const unsigned char* data, uint32_t size, int min_size, int* width, int* height);
+
+// Covers as size x size RGBA thumbnails (thumbs.c), read from thumb_dir when
+// they were made before and decoded and stored there otherwise. thumb_get
+// does that right away, the UI asks the background thread with thumb_request
+// and polls thumb_take instead.
+extern char* thumb_dir;
+unsigned char* thumb_get(const unsigned char* data, uint32_t data_size, uint64_t hash, int size);
+void thumb_start();
+void thumb_stop();
+void thumb_request(const unsigned char* data, uint32_t data_size, uint64_t hash, int size);
+bool thumb_take(uint64_t hash, int size, unsigned char** pixels);
+
+// Whole tracks as float frames (pcm.c), for the analyses that need every sample
+typedef struct {
+    void* decoder;
+    uint32_t channels;
+    uint32_t sample_rate;
+} Pcm;
+
+bool pcm_open(Pcm* pcm, char* path);
+uint64_t pcm_frame_count(Pcm* pcm); // and rewinds
+uint64_t pcm_read(Pcm* pcm, float* out, uint64_t frames);
+void pcm_close(Pcm* pcm);
+
+// Waveform overviews (wave.c): WAVE_BUCKETS pairs of peak and RMS, 0-255 for
+// 0 to full scale, each over an equal stretch of the track. wave_get reads it
+// from wave_dir when it was made before, wave_compute always decodes.
+// The UI asks the background thread with wave_request and polls
+// wave_overview, which is NULL until the overview of that path is ready.
+#define WAVE_BUCKETS 2048
+extern char* wave_dir;
+unsigned char* wave_compute(char* path);
+unsigned char* wave_get(char* path);
+void wave_start();
+void wave_stop();
+void wave_request(char* path);
+unsigned char* wave_overview(const char* path);
+
+// Loudness normalization (loudness.c). Every library file is analysed once
+// per fingerprint by a pool of background threads, one per core, and the
+// results are kept in library_files and the savestate. loudness_update feeds
+// the pool and collects what it made, from the main thread.
+#define LOUDNESS_TARGET -18.f // LUFS, the ReplayGain 2.0 reference level
+bool loudness_analyze(char* path, LibraryFile* result); // fills duration, loudness and peak
+void loudness_start();
+void loudness_stop();
+void loudness_update();
+size_t loudness_pending(); // files queued or being analysed
+float loudness_gain(char* path); // for the album of path when it has one, 1 if nothing is known
+
+// Prefetching (prefetch.c): the tracks that play next read whole into memory
+// by a background thread, so that playing them never waits on slow storage.
+// The UI lists them with prefetch_request, in play order, and prefetch_take
+// hands one over once it is read. At most prefetch_window bytes are held, 0
+// turns prefetching off, larger files keep streaming from disk.
+#define PREFETCH_WINDOW (64 << 20)
+#define PREFETCH_CHUNK (4 << 20) // bytes per read
+#define PREFETCH_SLOTS 4         // files wanted at once
+extern size_t prefetch_window;
+void prefetch_start();
+void prefetch_stop();
+void prefetch_request(char** paths, size_t count); // replaces the previous request
+size_t prefetch_pending();
+unsigned char* prefetch_take(const char* path, size_t* size); // the caller owns the data, NULL if it is not read
+
+// Spectrum analysis (spectrum.c). spectrum_push is an audio stream processor:
+// it copies the frames (stereo floats) into a ring and never locks. A thread
+// started by spectrum_start transforms the latest SPECTRUM_SIZE of them into
+// SPECTRUM_BANDS log-spaced bands. The renderer calls spectrum_get once a
+// frame: it asks for the next snapshot and gets the newest finished one, which
+// stays untouched until the next call.
+#define SPECTRUM_SIZE 2048   // frames per transform
+#define SPECTRUM_BANDS 32
+#define SPECTRUM_RANGE 60.f  // dB below full scale that a bar covers
+typedef struct {
+    float bands[SPECTRUM_BANDS]; // 0 to 1, from SPECTRUM_RANGE dB below full scale to full scale
+    float levels[2];             // RMS of each channel, on the same scale
+} Spectrum;
+
+void spectrum_compute(const float* frames, uint32_t sample_rate, Spectrum* out); // SPECTRUM_SIZE frames, without the bars falling
+void spectrum_start();
+void spectrum_stop();
+void spectrum_push(void* frames, unsigned int count);
+const Spectrum* spectrum_get(uint32_t sample_rate);
+
+void config_save(const char* path);
+void config_load(const char* path);
+
+void watch_start();
+void watch_stop();
+void watch_update();
+
+// Changes written to every file of an album, fields left NULL (or 0) are kept
+typedef struct {
+    char* artists;
+    char* genres;
+    int year;
+    unsigned char* cover_data; // PNG or JPEG
+    uint32_t cover_size;
+} AlbumEdit;
+
+bool edit_album(size_t index, AlbumEdit edit); // takes ownership of the fields, false if the album is already being edited
+bool edit_album_progress(const char* name, size_t* done, size_t* total);
+void edit_start();
+void edit_stop();
+void edit_update();
+
+#endif // LIBRARY_H_
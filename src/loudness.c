@@ -0,0 +1,418 @@
+// Loudness normalization.
+// Albums are mastered at very different levels, so every track is measured
+// the way ITU-R BS.1770 (and so EBU R128 and ReplayGain 2.0) does it:
+// K-weighted, in overlapping 400 ms blocks, gated at -70 LUFS and then 10 LU
+// below the mean of what is left, plus its true peak from 4x oversampling.
+// Playback scales each stream to LOUDNESS_TARGET by its album's loudness when
+// it has one, so quiet songs of an album stay quieter, and never so far that
+// the peak would clip.
+// The analysis runs on a pool of one thread per core. Results land in
+// library_files and so in the savestate, and only files without one get
+// queued, so an interrupted analysis continues where it was on the next start.
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "library.h"
+
+#define LOUDNESS_MAX_WORKERS 64
+#define LOUDNESS_QUEUE 4    // tasks waiting per worker
+#define LOUDNESS_SWEEP 512  // library files looked at per loudness_update
+#define LOUDNESS_CHUNK 4096 // frames decoded at once
+#define LOUDNESS_TAPS 12    // per phase of the oversampling filter
+#define LOUDNESS_GATE -70.  // LUFS, blocks below are silence
+
+typedef struct {
+    char* path;
+    LibraryFile fingerprint; // when it was queued, a result for an older file is dropped
+    bool ok;
+    LibraryFile result;
+} LoudnessTask;
+
+// One track being measured, mono or stereo
+typedef struct {
+    uint32_t channels;
+    double k[2][5];        // shelf, then high pass: b0 b1 b2 a1 a2
+    double z[2][2][2];     // filter state: [stage][delay][channel]
+    double energy[2];      // K-weighted sum of squares of the current 100 ms, per channel
+    uint32_t position;     // frames into the current 100 ms
+    uint32_t step;         // frames in 100 ms
+    double* blocks;        // mean square of every 100 ms, summed over the channels
+    float phases[LOUDNESS_TAPS][4]; // the 4 phases of the interpolator, side by side
+    float history[2][LOUDNESS_TAPS - 1 + LOUDNESS_CHUNK]; // per channel, the last taps - 1 samples first
+    float peak;
+} LoudnessMeter;
+
+pthread_t loudness_threads[LOUDNESS_MAX_WORKERS];
+size_t loudness_thread_count = 0;
+pthread_mutex_t loudness_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t loudness_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by loudness_lock
+bool loudness_quit = false;
+LoudnessTask* loudness_tasks = 0;
+size_t loudness_tasks_position = 0;
+LoudnessTask* loudness_results = 0;
+
+// Owned by the main thread
+Ht loudness_queued; // path -> 1, for every task not collected yet
+size_t loudness_cursor = 0; // next library file loudness_update looks at
+
+// The two K-weighting biquads of BS.1770 for any sample rate, the same
+// derivation libebur128 uses
+void loudness_meter_init(LoudnessMeter* m, uint32_t channels, uint32_t sample_rate) {
+    memset(m, 0, sizeof(*m));
+    m->channels = channels;
+    m->step = sample_rate/10;
+    m->blocks = da_new(double);
+
+    double f0 = 1681.974450955533, gain = 3.999843853973347, q = 0.7071752369554196;
+    double k = tan(M_PI*f0/sample_rate);
+    double vh = pow(10., gain/20.), vb = pow(vh, 0.4996667741545416);
+    double a0 = 1. + k/q + k*k;
+    double shelf[5] = {(vh + vb*k/q + k*k)/a0, 2.*(k*k - vh)/a0, (vh - vb*k/q + k*k)/a0, 2.*(k*k - 1.)/a0, (1. - k/q + k*k)/a0};
+    f0 = 38.13547087602444; q = 0.5003270373238773;
+    k = tan(M_PI*f0/sample_rate);
+    a0 = 1. + k/q + k*k;
+    double high_pass[5] = {1., -2., 1., 2.*(k*k - 1.)/a0, (1. - k/q + k*k)/a0};
+    memcpy(m->k[0], shelf, sizeof(shelf));
+    memcpy(m->k[1], high_pass, sizeof(high_pass));
+
+    // Hann windowed sinc, cut at the original Nyquist. Phase 0 is the sample itself
+    int taps = LOUDNESS_TAPS*4;
+    for (int i = 0; i < taps; i++) {
+        double t = (i - taps/2)/4.;
+        double sinc = t == 0 ? 1. : sin(M_PI*t)/(M_PI*t);
+        double window = 0.5 - 0.5*cos(2.*M_PI*i/taps);
+        m->phases[i/4][i%4] = sinc*window;
+    }
+}
+
+void loudness_close_block(LoudnessMeter* m) {
+    double block = 0;
+    for (uint32_t c = 0; c < m->channels; c++) block += m->energy[c]/m->step;
+    da_push(m->blocks, block);
+    m->energy[0] = m->energy[1] = 0;
+    m->position = 0;
+}
+
+// K-weighting of count frames, all of them within the current 100 ms.
+// A stereo frame goes through both filters at once, a channel per lane
+void loudness_weight(LoudnessMeter* m, const float* frames, uint32_t count) {
+#if defined(__SSE2__)
+    if (m->channels == 2) {
+        __m128d c[2][5];
+        for (int s = 0; s < 2; s++) for (int i = 0; i < 5; i++) c[s][i] = _mm_set1_pd(m->k[s][i]);
+        __m128d z[2][2];
+        for (int s = 0; s < 2; s++) for (int d = 0; d < 2; d++) z[s][d] = _mm_loadu_pd(m->z[s][d]);
+        __m128d energy = _mm_loadu_pd(m->energy);
+        for (uint32_t i = 0; i < count; i++) {
+            __m128d x = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*) (frames + i*2))));
+            for (int s = 0; s < 2; s++) {
+                __m128d y = _mm_add_pd(_mm_mul_pd(c[s][0], x), z[s][0]);
+                z[s][0] = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(c[s][1], x), _mm_mul_pd(c[s][3], y)), z[s][1]);
+                z[s][1] = _mm_sub_pd(_mm_mul_pd(c[s][2], x), _mm_mul_pd(c[s][4], y));
+                x = y;
+            }
+            energy = _mm_add_pd(energy, _mm_mul_pd(x, x));
+        }
+        for (int s = 0; s < 2; s++) for (int d = 0; d < 2; d++) _mm_storeu_pd(m->z[s][d], z[s][d]);
+        _mm_storeu_pd(m->energy, energy);
+        return;
+    }
+#endif
+    for (uint32_t ch = 0; ch < m->channels; ch++) {
+        double energy = m->energy[ch];
+        for (uint32_t i = 0; i < count; i++) {
+            double x = frames[i*m->channels + ch];
+            for (int s = 0; s < 2; s++) {
+                double* k = m->k[s];
+                double y = k[0]*x + m->z[s][0][ch];
+                m->z[s][0][ch] = k[1]*x - k[3]*y + m->z[s][1][ch];
+                m->z[s][1][ch] = k[2]*x - k[4]*y;
+                x = y;
+            }
+            energy += x*x;
+        }
+        m->energy[ch] = energy;
+    }
+}
+
+// Largest magnitude of the signal upsampled 4x, every lane is one phase
+void loudness_true_peak(LoudnessMeter* m, const float* frames, uint32_t count) {
+    for (uint32_t ch = 0; ch < m->channels; ch++) {
+        float* history = m->history[ch];
+        float* samples = history + LOUDNESS_TAPS - 1;
+        for (uint32_t i = 0; i < count; i++) samples[i] = frames[i*m->channels + ch];
+        float peak = m->peak;
+        uint32_t i = 0;
+#if defined(__SSE2__)
+        __m128 phases[LOUDNESS_TAPS];
+        for (int t = 0; t < LOUDNESS_TAPS; t++) phases[t] = _mm_loadu_ps(m->phases[t]);
+        __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 vp = _mm_set1_ps(peak);
+        for (; i < count; i++) {
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < LOUDNESS_TAPS; t++) sum = _mm_add_ps(sum, _mm_mul_ps(phases[t], _mm_set1_ps(samples[(int) i - t])));
+            vp = _mm_max_ps(vp, _mm_and_ps(sum, magnitude));
+        }
+        float lanes[4];
+        _mm_storeu_ps(lanes, vp);
+        peak = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+#endif
+        for (; i < count; i++) {
+            for (int p = 0; p < 4; p++) {
+                float sum = 0;
+                for (int t = 0; t < LOUDNESS_TAPS; t++) sum += m->phases[t][p]*samples[(int) i - t];
+                if (fabsf(sum) > peak) peak = fabsf(sum);
+            }
+        }
+        m->peak = peak;
+        memmove(history, samples + count - (LOUDNESS_TAPS - 1), (LOUDNESS_TAPS - 1)*sizeof(float));
+    }
+}
+
+void loudness_feed(LoudnessMeter* m, const float* frames, uint32_t count) {
+    loudness_true_peak(m, frames, count);
+    while (count > 0) {
+        uint32_t take = m->step - m->position;
+        if (take > count) take = count;
+        loudness_weight(m, frames, take);
+        m->position += take;
+        frames += take*m->channels;
+        count -= take;
+        if (m->position == m->step) loudness_close_block(m);
+    }
+}
+
+// Blocks are 400 ms, four of the 100 ms ones, so consecutive blocks overlap
+// by 75%. A track shorter than that is one block of whatever it has
+double loudness_integrate(LoudnessMeter* m) {
+    if (m->position > 0 && da_length(m->blocks) < 4) loudness_close_block(m);
+    size_t count = da_length(m->blocks);
+    size_t width = count < 4 ? count : 4;
+    size_t blocks = count - width + 1;
+    if (count == 0) return LOUDNESS_GATE;
+    double absolute = pow(10., (LOUDNESS_GATE + 0.691)/10.);
+    double threshold = absolute;
+    for (int pass = 0; pass < 2; pass++) {
+        double sum = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < blocks; i++) {
+            double z = 0;
+            for (size_t j = 0; j < width; j++) z += m->blocks[i + j];
+            z /= width;
+            if (z <= threshold) continue;
+            sum += z;
+            kept++;
+        }
+        if (kept == 0) return LOUDNESS_GATE;
+        if (pass == 1) return -0.691 + 10.*log10(sum/kept);
+        threshold = fmax(absolute, sum/kept*0.1); // 10 LU below the mean
+    }
+    return LOUDNESS_GATE;
+}
+
+// Gives up when mus quits if cancellable
+bool loudness_measure(char* path, LibraryFile* result, bool cancellable) {
+    Pcm pcm;
+    if (!pcm_open(&pcm, path)) return false;
+    if (pcm.channels > 2) {
+        pcm_close(&pcm);
+        return false;
+    }
+    LoudnessMeter* m = malloc(sizeof(LoudnessMeter));
+    loudness_meter_init(m, pcm.channels, pcm.sample_rate);
+    float* chunk = malloc(LOUDNESS_CHUNK*pcm.channels*sizeof(float));
+    uint64_t frames = 0, read = 0;
+    size_t chunks = 0;
+    bool ok = true;
+    while ((read = pcm_read(&pcm, chunk, LOUDNESS_CHUNK)) > 0) {
+        loudness_feed(m, chunk, read);
+        frames += read;
+        if (cancellable && ++chunks % 16 == 0) {
+            pthread_mutex_lock(&loudness_lock);
+            ok = !loudness_quit;
+            pthread_mutex_unlock(&loudness_lock);
+            if (!ok) break;
+        }
+    }
+    if (ok && frames > 0) {
+        result->duration = (float) frames/pcm.sample_rate;
+        result->loudness = loudness_integrate(m);
+        result->peak = m->peak;
+    } else ok = false;
+    free(chunk);
+    da_free(m->blocks);
+    free(m);
+    pcm_close(&pcm);
+    return ok;
+}
+
+bool loudness_analyze(char* path, LibraryFile* result) {
+    return loudness_measure(path, result, false);
+}
+
+void* loudness_main(void* arg) {
+    (void) arg;
+#ifdef __linux__
+    // Linux takes a thread id here, so only the pool yields to the audio and the UI
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+    while (true) {
+        pthread_mutex_lock(&loudness_lock);
+        while (!loudness_quit && loudness_tasks_position == da_length(loudness_tasks)) pthread_cond_wait(&loudness_wake, &loudness_lock);
+        if (loudness_quit) {
+            pthread_mutex_unlock(&loudness_lock);
+            break;
+        }
+        LoudnessTask task = loudness_tasks[loudness_tasks_position++];
+        if (loudness_tasks_position == da_length(loudness_tasks)) {
+            _da_set(loudness_tasks, DA_LENGTH, 0);
+            loudness_tasks_position = 0;
+        }
+        pthread_mutex_unlock(&loudness_lock);
+
+        task.ok = loudness_measure(task.path, &task.result, true);
+
+        pthread_mutex_lock(&loudness_lock);
+        bool quit = loudness_quit;
+        da_push(loudness_results, task);
+        pthread_mutex_unlock(&loudness_lock);
+        if (quit) break; // a cancelled measurement is not a failed one, see loudness_collect
+    }
+    return NULL;
+}
+
+void loudness_start() {
+    loudness_tasks = da_new(LoudnessTask);
+    loudness_results = da_new(LoudnessTask);
+    loudness_queued = ht_new();
+    loudness_cursor = 0;
+    long cores = 4;
+#ifdef _SC_NPROCESSORS_ONLN
+    cores = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (cores < 1) cores = 1;
+    if (cores > LOUDNESS_MAX_WORKERS) cores = LOUDNESS_MAX_WORKERS;
+    for (long i = 0; i < cores; i++) {
+        if (pthread_create(&loudness_threads[loudness_thread_count], NULL, loudness_main, NULL) == 0) loudness_thread_count++;
+    }
+}
+
+void loudness_collect(bool quitting) {
+    pthread_mutex_lock(&loudness_lock);
+    for (size_t i = 0; i < da_length(loudness_results); i++) {
+        LoudnessTask task = loudness_results[i];
+        ht_remove(&loudness_queued, task.path);
+        size_t index = 0;
+        if (ht_get(&library_index, task.path, &index) && !(quitting && !task.ok)) {
+            LibraryFile* file = &library_files[index];
+            if (file->size == task.fingerprint.size && file->mtime == task.fingerprint.mtime && file->inode == task.fingerprint.inode) {
+                if (task.ok) {
+                    file->duration = task.result.duration;
+                    file->loudness = task.result.loudness;
+                    file->peak = task.result.peak;
+                } else {
+                    file->duration = -1;
+                    library_log("Could not measure the loudness of %s", task.path);
+                }
+            }
+        }
+        free(task.path);
+    }
+    _da_set(loudness_results, DA_LENGTH, 0);
+    pthread_mutex_unlock(&loudness_lock);
+}
+
+// Everything measured so far is kept, the rest is picked up on the next start
+void loudness_stop() {
+    if (loudness_tasks == NULL) return;
+    pthread_mutex_lock(&loudness_lock);
+    loudness_quit = true;
+    pthread_cond_broadcast(&loudness_wake);
+    pthread_mutex_unlock(&loudness_lock);
+    for (size_t i = 0; i < loudness_thread_count; i++) pthread_join(loudness_threads[i], NULL);
+    loudness_thread_count = 0;
+
+    loudness_collect(true);
+    for (size_t i = loudness_tasks_position; i < da_length(loudness_tasks); i++) free(loudness_tasks[i].path);
+    da_free(loudness_tasks);
+    da_free(loudness_results);
+    ht_free(&loudness_queued);
+    loudness_tasks = NULL;
+    loudness_tasks_position = 0;
+    loudness_quit = false;
+}
+
+void loudness_update() {
+    if (loudness_tasks == NULL || loudness_thread_count == 0) return;
+    loudness_collect(false);
+
+    // A slice of the library per call, so a big one is not walked every frame
+    size_t limit = loudness_thread_count*LOUDNESS_QUEUE;
+    size_t files = da_length(library_files);
+    LoudnessTask* fresh = da_new(LoudnessTask);
+    for (size_t i = 0; i < LOUDNESS_SWEEP && i < files && loudness_queued.count < limit; i++) {
+        if (loudness_cursor >= files) loudness_cursor = 0;
+        LibraryFile* file = &library_files[loudness_cursor++];
+        if (file->duration != 0 || ht_get(&loudness_queued, file->path, NULL)) continue;
+        LoudnessTask task = {.fingerprint = *file};
+        task.path = malloc(strlen(file->path)+1);
+        memcpy(task.path, file->path, strlen(file->path)+1);
+        task.fingerprint.path = NULL;
+        ht_set(&loudness_queued, task.path, 1);
+        da_push(fresh, task);
+    }
+    if (da_length(fresh) > 0) {
+        pthread_mutex_lock(&loudness_lock);
+        for (size_t i = 0; i < da_length(fresh); i++) da_push(loudness_tasks, fresh[i]);
+        pthread_cond_broadcast(&loudness_wake);
+        pthread_mutex_unlock(&loudness_lock);
+    }
+    da_free(fresh);
+}
+
+size_t loudness_pending() {
+    return loudness_tasks == NULL ? 0 : loudness_queued.count;
+}
+
+// Album loudness is the energy mean of its tracks, weighted by their length
+float loudness_gain(char* path) {
+    Album* album = NULL;
+    for (size_t i = 1; i < da_length(albums) && album == NULL; i++) {
+        for (size_t j = 0; j < da_length(albums[i].playlist); j++) {
+            if (strcmp(albums[i].playlist[j], path) == 0) { album = &albums[i]; break; }
+        }
+    }
+    char** tracks = album != NULL ? album->playlist : &path;
+    size_t track_count = album != NULL ? da_length(album->playlist) : 1;
+
+    double energy = 0, seconds = 0;
+    float peak = 0;
+    for (size_t i = 0; i < track_count; i++) {
+        size_t index = 0;
+        if (!ht_get(&library_index, tracks[i], &index)) continue;
+        LibraryFile* file = &library_files[index];
+        if (file->duration <= 0) continue;
+        energy += file->duration*pow(10., file->loudness/10.);
+        seconds += file->duration;
+        if (file->peak > peak) peak = file->peak;
+    }
+    if (seconds == 0) return 1;
+    double loudness = 10.*log10(energy/seconds);
+    if (loudness <= LOUDNESS_GATE) return 1; // silence, nothing to bring up
+    float gain = pow(10., (LOUDNESS_TARGET - loudness)/20.);
+    if (peak > 0 && gain*peak > 1) gain = 1/peak;
+    return gain;
+}
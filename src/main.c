@@ -1,20 +1,16 @@
 
 #include "raylib.h"
+#include "rlgl.h"
 #include "id3v2lib.h"
 
-#define UC_IMPL
-#include "uc.h"
-
-#define DA_IMPL
-#include "da.h"
-
 #include <stddef.h>
 #include <stdio.h>
 #include <assert.h>
+#include <math.h>
 
-#include "assets.h"
+#include "library.h"
 
-#include "win32.h"
+#include "assets.h"
 
 typedef struct {
     Color bg, mg_off, mg_on, fg_off, fg;
@@ -28,58 +24,42 @@ Colors theme = {
     {0xFF, 0xFF, 0xFF, 0xFF},
 };
 
-int font_size = 24;
-
-#ifdef _WIN32
-char* GetShortPath(char *path) {
-    static char shortPath[MAX_PATH];
-    wchar_t wPath[MAX_PATH];
-    wchar_t wShortPath[MAX_PATH];
-    MultiByteToWideChar(CP_UTF8, 0, path, -1, wPath, MAX_PATH);
-    GetShortPathNameW(wPath, wShortPath, MAX_PATH);
-    WideCharToMultiByte(CP_UTF8, 0, wShortPath, -1, shortPath, MAX_PATH, NULL, NULL);
-    return shortPath;
-}
+#define UI_FONT_SIZE 24 // font_size at a UI scale of 1
 
-char* to_utf8(char *path) {
-    static char shortPath[MAX_PATH];
-    wchar_t wPath[MAX_PATH];
-    MultiByteToWideChar(CP_ACP, 0, path, -1, wPath, MAX_PATH);
-    WideCharToMultiByte(CP_UTF8, 0, wPath, -1, shortPath, MAX_PATH, NULL, NULL);
-    return shortPath;
-}
-
-#define get_path(path) GetShortPath(path)
-#define norm_text(text) to_utf8(text)
-#else
-#define get_path(path) path
-#define norm_text(text) text
-#endif
+int font_size = UI_FONT_SIZE; // follows the UI scale, see ui_set_scale
 
 #include "music.c"
 #include "ui.c"
-#include "config.c"
 
-Font load_font(char* ptr, size_t size) {
-    int codepoints[516] = {0};
-    
-    for (int i = 0; i < 95; i++) codepoints[i] = 32 + i;          // ascii charachters
-    for (int i = 0; i < 255; i++) codepoints[96 + i] = 0x400 + i; // cyrillic charachters
-    
-    Font font = LoadFontFromMemory(".ttf", (const unsigned char*) ptr, size, font_size, codepoints, 516);
+// Glyphs and icons are baked by bundle.py into one distance field atlas, so
+// this is a single upload and any font_size draws from it without a re-bake.
+// The font owns the texture, UnloadFont releases the icons too.
+// Zero alpha tells SDF_SHADER the atlas from every other texture
+Font load_font() {
+    unsigned char* pixels = calloc(ASSETS_ATLAS_WIDTH*ASSETS_ATLAS_HEIGHT, 2);
+    for (int i = 0; i < ASSETS_ATLAS_WIDTH*ASSETS_ATLAS_HEIGHT; i++) pixels[i*2] = _ASSETS_DATA[i];
+    Image image = {pixels, ASSETS_ATLAS_WIDTH, ASSETS_ATLAS_HEIGHT, 1, PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA};
+    Font font = {.baseSize = ASSETS_FONT_SIZE, .glyphCount = ASSETS_GLYPH_COUNT, .glyphPadding = ASSETS_GLYPH_PADDING};
+    font.texture = LoadTextureFromImage(image);
+    UnloadImage(image);
+    SetTextureFilter(font.texture, TEXTURE_FILTER_BILINEAR);
+    font.recs = malloc(ASSETS_GLYPH_COUNT*sizeof(Rectangle));
+    font.glyphs = calloc(ASSETS_GLYPH_COUNT, sizeof(GlyphInfo));
+    for (int i = 0; i < ASSETS_GLYPH_COUNT; i++) {
+        const int* g = _ASSETS_GLYPHS[i];
+        font.glyphs[i] = (GlyphInfo) {.value = g[0], .offsetX = g[1], .offsetY = g[2], .advanceX = g[3]};
+        font.recs[i] = (Rectangle) {g[4], g[5], g[6], g[7]};
+    }
     return font;
 }
 
-void generate_and_set_icon() {
-    Image icon = LoadImageFromMemory(".png", (const unsigned char*) _ICON_PNG, _ICON_PNG_LENGTH);
-    ImageColorTint(&icon, theme.fg);
-    ImageResize(&icon, 64, 64);
-    Image icon_bg = GenImageColor(64, 64, (Color) {0, 0, 0, 0});
-    ImageDrawCircle(&icon_bg, 32, 32, 32, theme.bg);
-    ImageDraw(&icon_bg, icon, (Rectangle) {0, 0, 64, 64}, (Rectangle) {0, 0, 64, 64}, (Color) {0xff, 0xff, 0xff, 255});
-    SetWindowIcon(icon_bg);
-    UnloadImage(icon);
-    UnloadImage(icon_bg);
+Rectangle load_icon(const int icon[3]) {
+    return (Rectangle) {icon[0], icon[1], icon[2], icon[2]};
+}
+
+void set_icon() {
+    const unsigned char* pixels = _ASSETS_DATA + ASSETS_ATLAS_WIDTH*ASSETS_ATLAS_HEIGHT;
+    SetWindowIcon((Image) {(void*) pixels, ASSETS_WINDOW_ICON_SIZE, ASSETS_WINDOW_ICON_SIZE, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8});
 }
 
 int main(void) {
@@ -92,76 +72,75 @@ int main(void) {
     InitWindow(600, 400, "mus");
     SetExitKey(0);
     
-    generate_and_set_icon();
-    
-    playlist = da_new(char*);
-    albums = da_new(Album);
+    set_icon();
     
-    font = load_font(_FONT_TTF, _FONT_TTF_LENGTH);
-
-    Image iplay = LoadImageFromMemory(".png", (const unsigned char*) _PLAY_PNG, _PLAY_PNG_LENGTH);
-    Image ipause = LoadImageFromMemory(".png", (const unsigned char*) _PAUSE_PNG, _PAUSE_PNG_LENGTH);
-    Image iback = LoadImageFromMemory(".png", (const unsigned char*) _BACK_PNG, _BACK_PNG_LENGTH);
-    Image iforward = LoadImageFromMemory(".png", (const unsigned char*) _FORWARD_PNG, _FORWARD_PNG_LENGTH);
-    Image irepeat = LoadImageFromMemory(".png", (const unsigned char*) _REPEAT_PNG, _REPEAT_PNG_LENGTH);
-    Image irepeat_one = LoadImageFromMemory(".png", (const unsigned char*) _REPEAT_ONE_PNG, _REPEAT_ONE_PNG_LENGTH);
-    Image idelete = LoadImageFromMemory(".png", (const unsigned char*) _DELETE_PNG, _DELETE_PNG_LENGTH);
-    Image igo_back = LoadImageFromMemory(".png", (const unsigned char*) _GO_BACK_PNG, _GO_BACK_PNG_LENGTH);
-
-    ImageResize(&iplay, font_size, font_size);
-    ImageResize(&ipause, font_size, font_size);
-    ImageResize(&iback, font_size, font_size);
-    ImageResize(&iforward, font_size, font_size);
-    ImageResize(&irepeat, font_size, font_size);
-    ImageResize(&irepeat_one, font_size, font_size);
-    ImageResize(&idelete, font_size, font_size);
-    ImageResize(&igo_back, font_size, font_size);
-
-    play = LoadTextureFromImage(iplay);
-    pause = LoadTextureFromImage(ipause);
-    back = LoadTextureFromImage(iback);
-    forward = LoadTextureFromImage(iforward);
-    repeat = LoadTextureFromImage(irepeat);
-    repeat_one = LoadTextureFromImage(irepeat_one);
-    tdelete = LoadTextureFromImage(idelete);
-    go_back = LoadTextureFromImage(igo_back);
+    library_init();
+    cover_free_hook = cover_unload_texture;
+    album_remove_hook = album_removed;
     
-    UnloadImage(iplay);
-    UnloadImage(ipause);
-    UnloadImage(iback);
-    UnloadImage(iforward);
-    UnloadImage(irepeat);
-    UnloadImage(irepeat_one);
-    UnloadImage(idelete);
-    UnloadImage(igo_back);
+    ui_set_scale(GetWindowScaleDPI().x);
+    font = load_font();
+    sdf_shader = LoadShaderFromMemory(NULL, SDF_SHADER);
+    play = load_icon(_ASSETS_ICON_PLAY);
+    tpause = load_icon(_ASSETS_ICON_PAUSE);
+    back = load_icon(_ASSETS_ICON_BACK);
+    forward = load_icon(_ASSETS_ICON_FORWARD);
+    repeat = load_icon(_ASSETS_ICON_REPEAT);
+    repeat_one = load_icon(_ASSETS_ICON_REPEAT_ONE);
+    tdelete = load_icon(_ASSETS_ICON_DELETE);
+    go_back = load_icon(_ASSETS_ICON_GO_BACK);
 
     InitAudioDevice();
     
-    Image empty_cover = GenImageColor(font_size*6.f, font_size*6.f, theme.mg_off);
-    Album empty_album = {.name = "<not specified>", .year = 0, .genres = "", .artists = "", .cover = LoadTextureFromImage(empty_cover), .playlist = da_new(char*)};
-    UnloadImage(empty_cover);
-    da_push(albums, empty_album);
-
-    if (FileExists(".mus-savestate")) config_load();
-
-    SetTargetFPS(60);
+    if (FileExists(CONFIG_PATH)) config_load(CONFIG_PATH);
+
+    watch_start();
+    edit_start();
+    wave_start();
+    thumb_start();
+    loudness_start();
+    // MUS_PREFETCH_MB=0 plays every track straight from disk
+    if (getenv("MUS_PREFETCH_MB") != NULL) prefetch_window = (size_t) atoi(getenv("MUS_PREFETCH_MB")) << 20;
+    prefetch_start();
+    // MUS_CROSSFADE_MS=3000 fades every track into the next, except within an album
+    if (getenv("MUS_CROSSFADE_MS") != NULL) music_crossfade_ms = atoi(getenv("MUS_CROSSFADE_MS"));
+    if (getenv("MUS_PCM_CACHE_MB") != NULL) music_cache_mb = atoi(getenv("MUS_PCM_CACHE_MB"));
+    music_cache_compact = getenv("MUS_PCM_CACHE_COMPACT") != NULL;
+    if (music_cache_mb > 0) SetMusicCacheSize((unsigned int) music_cache_mb << 20, music_cache_compact);
+
+    music_apply_profile(MUSIC_PROFILE_LOW_LATENCY); // also sets the frame rate
     
     while (!WindowShouldClose()) {
         cursor = MOUSE_CURSOR_ARROW;
+        cover_uploads = 0;
         
         scroll_factor = GetScreenHeight()*0.1f;
         
         if (music_loaded) UpdateMusicStream(music);
         music_update();
-
-        if (IsKeyPressed(KEY_SPACE)) music_play_pause();
-        else if (IsKeyPressed(KEY_R)) music_toggle_repeat();
-        else if (IsKeyPressed(KEY_LEFT)) music_playlist_previous();
-        else if (IsKeyPressed(KEY_RIGHT)) music_playlist_next();
+        music_profile_update();
+        edit_update();
+        loudness_update();
+        watch_update();
+
+        if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) {
+            if (IsKeyPressed(KEY_EQUAL)) ui_set_scale(ui_scale*1.1f);
+            else if (IsKeyPressed(KEY_MINUS)) ui_set_scale(ui_scale/1.1f);
+            else if (IsKeyPressed(KEY_ZERO)) ui_set_scale(GetWindowScaleDPI().x);
+            else if (IsKeyPressed(KEY_N)) music_toggle_native_rate();
+            else if (IsKeyPressed(KEY_I)) ui_show_audio_stats = !ui_show_audio_stats;
+            else if (IsKeyPressed(KEY_S)) music_toggle_spectrum();
+        } else if (album_edit_focus == -1) { // otherwise the keys are typed into the album edit form
+            if (IsKeyPressed(KEY_SPACE)) music_play_pause();
+            else if (IsKeyPressed(KEY_R)) music_toggle_repeat();
+            else if (IsKeyPressed(KEY_LEFT)) music_playlist_previous();
+            else if (IsKeyPressed(KEY_RIGHT)) music_playlist_next();
+        }
         
         BeginDrawing();
 
         ClearBackground(theme.bg);
+        BeginShaderMode(sdf_shader); // text, icons and shapes share it, see SDF_SHADER
 
         draw_box((Rectangle) {0, font_size*1.5f, GetScreenWidth(), GetScreenHeight() - font_size*5.f});
         draw_main_ui();
@@ -175,27 +154,32 @@ int main(void) {
         draw_status_bar();
         drop_draw_box();
 
+        EndShaderMode();
         SetMouseCursor(cursor);
         EndDrawing();
     }
 
     CloseAudioDevice();
+    spectrum_stop();
 
     UnloadFont(font);
-    UnloadTexture(back);
-    UnloadTexture(forward);
-    UnloadTexture(pause);
-    UnloadTexture(play);
-    UnloadTexture(repeat);
-    UnloadTexture(repeat_one);
-    UnloadTexture(tdelete);
-    UnloadTexture(go_back);
+    UnloadShader(sdf_shader);
 
+    album_edit_end();
+    album_cover_view_close();
     CloseWindow();
-
-    config_save();
+    cover_free_hook = NULL; // textures died with the window
+    album_remove_hook = NULL;
+
+    wave_stop();
+    thumb_stop();
+    loudness_stop();
+    prefetch_stop();
+    edit_stop();
+    watch_stop();
+    config_save(CONFIG_PATH);
     
-    while (da_length(albums) != 0) pop_album();
+    library_free();
     
     return 0;
 }
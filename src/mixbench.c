@@ -0,0 +1,114 @@
+// mus-mix-bench
+// Times raudio's device callback (reading the streams, converting them to the
+// mixing format and mixing them) without an audio device: raudio.c is built
+// into this file and its callback is called directly, the way miniaudio would
+// call it, for a few sample rates and period sizes. Prints JSON on stdout.
+// The f32_spectrum case adds the processor that feeds mus's spectrum.
+//
+// Usage: mus-mix-bench [-n callbacks]
+
+#include <time.h>
+
+// raylib builds raudio.c and its decoders with -Wall alone, what -Wextra adds
+// there is theirs to fix
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-compare"
+#pragma GCC diagnostic ignored "-Wunused-parameter"
+#pragma GCC diagnostic ignored "-Wimplicit-fallthrough"
+#include "raudio.c"
+#pragma GCC diagnostic pop
+#include "library.h"
+
+// raudio refers to these rcore file helpers for loading, nothing here loads files
+bool IsFileExtension(const char* fileName, const char* ext) { (void) fileName; (void) ext; return false; }
+const char* GetFileExtension(const char* fileName) { (void) fileName; return NULL; }
+const char* GetFileNameWithoutExt(const char* filePath) { return filePath; }
+
+typedef struct {
+    const char* name;
+    ma_format format;
+    bool ramp; // the volume changes every callback
+    bool spectrum; // spectrum_push attached as a processor
+} MixCase;
+
+double mix_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int mix_compare(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+    int callbacks = 20000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) callbacks = atoi(argv[++i]);
+    }
+    if (callbacks < 1) {
+        fprintf(stderr, "Usage: %s [-n callbacks]\n", argv[0]);
+        return 1;
+    }
+
+    int rates[] = {48000, 96000, 192000};
+    int periods[] = {64, 128, 256, 512};
+    MixCase cases[] = {
+        {"f32", ma_format_f32, false, false}, // music streams are in the device format
+        {"s16", ma_format_s16, false, false}, // 16 bit streams need a conversion
+        {"f32_ramp", ma_format_f32, true, false},
+        {"f32_spectrum", ma_format_f32, false, true},
+    };
+    double* samples = malloc(callbacks*sizeof(double));
+    float* out = malloc(512*AUDIO_DEVICE_CHANNELS*sizeof(float));
+
+    ma_mutex_init(&AUDIO.System.lock);
+    AUDIO.System.device.playback.format = AUDIO_DEVICE_FORMAT;
+    AUDIO.System.device.playback.channels = AUDIO_DEVICE_CHANNELS;
+
+    printf("{\n  \"callbacks\": %d,\n  \"results\": [\n", callbacks);
+    bool first = true;
+    for (size_t r = 0; r < sizeof(rates)/sizeof(rates[0]); r++) {
+        AUDIO.System.device.sampleRate = rates[r];
+        for (size_t c = 0; c < sizeof(cases)/sizeof(cases[0]); c++) {
+            // One second of a looping sine, played like a sound
+            rAudioBuffer* buffer = LoadAudioBuffer(cases[c].format, 2, rates[r], rates[r], AUDIO_BUFFER_USAGE_STATIC);
+            for (int i = 0; i < rates[r]*2; i++) {
+                float x = 0.5f*sinf(2.f*PI*440.f*(i/2)/rates[r]);
+                if (cases[c].format == ma_format_f32) ((float*) buffer->data)[i] = x;
+                else ((short*) buffer->data)[i] = (short) (x*32767.f);
+            }
+            buffer->looping = true;
+            buffer->playing = true;
+            if (cases[c].spectrum) AttachAudioStreamProcessor((AudioStream) {.buffer = buffer}, spectrum_push);
+
+            for (size_t p = 0; p < sizeof(periods)/sizeof(periods[0]); p++) {
+                for (int i = 0; i < callbacks/10; i++) OnSendAudioDataToDevice(&AUDIO.System.device, out, NULL, periods[p]);
+                double total = 0;
+                for (int i = 0; i < callbacks; i++) {
+                    if (cases[c].ramp) buffer->volume = (i & 1) ? 0.5f : 1.0f;
+                    double start = mix_now();
+                    OnSendAudioDataToDevice(&AUDIO.System.device, out, NULL, periods[p]);
+                    samples[i] = mix_now() - start;
+                    total += samples[i];
+                }
+                qsort(samples, callbacks, sizeof(double), mix_compare);
+                double mean = total/callbacks;
+                double budget = (double) periods[p]/rates[r];
+                printf("%s    {\"sample_rate\": %d, \"stream\": \"%s\", \"period_frames\": %d, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"cpu_percent\": %.3f}",
+                       first ? "" : ",\n", rates[r], cases[c].name, periods[p], mean*1e6,
+                       samples[callbacks/2]*1e6, samples[(int) (callbacks*0.99)]*1e6, mean/budget*100);
+                first = false;
+            }
+            if (cases[c].spectrum) DetachAudioStreamProcessor((AudioStream) {.buffer = buffer}, spectrum_push);
+            UnloadAudioBuffer(buffer);
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    ma_mutex_uninit(&AUDIO.System.lock);
+    free(samples);
+    free(out);
+    return 0;
+}
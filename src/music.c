@@ -1,5 +1,5 @@
 
-ID3v2_Tag* tag;
+ID3v2_TagView* tag;
 Music music;
 bool music_playing = true;
 int music_repeat = 0;
@@ -8,265 +8,252 @@ int music_repeat = 0;
 // 2 - repeat one
 bool music_loaded = false;
 float music_volume = 1.0f;
-
-char** playlist = 0;
-int playlist_position = -1;
-
-char utf8str[1024] = {0};
-
+bool music_native_rate = true; // the device follows the sample rate of the track, see music_load
+unsigned char* music_data = NULL; // the whole file once it is read, the stream plays from it
+size_t music_data_size = 0;
+bool music_from_disk = false; // the file could not be read whole, the stream stays on it
+bool music_spectrum = false; // music feeds spectrum.c, only while the spectrum is shown
+
+// raylib keeps the most recently decoded audio, so playing a track again (previous,
+// repeat one) or seeking back into what was just heard starts without decoding.
+// Samples stay float so a cached replay matches the decoded one: MP3 decodes past
+// full scale and the loudness gain, applied after the cache, often brings it back.
+// 128 MB are about six minutes of 44.1 kHz stereo.
+#define MUSIC_CACHE_MB 128 // MUS_PCM_CACHE_MB sets it, 0 turns the cache off
+int music_cache_mb = MUSIC_CACHE_MB;
+bool music_cache_compact = false; // MUS_PCM_CACHE_COMPACT keeps 16 bit, twice as much but clipped at full scale
+
+// Transitions: the next track is opened shortly before the current one ends and
+// raylib starts it on the exact frame where the crossfade begins, or right after
+// the last frame of the current one for a gapless album. Either way the frame
+// rate no longer decides when it starts.
+#define MUSIC_CROSSFADE_MS 0      // off by default, MUS_CROSSFADE_MS sets it
+#define MUSIC_PREOPEN_LEAD 1.0f   // seconds ahead of the fade, several frames even in the low wakeup profile
+int music_crossfade_ms = MUSIC_CROSSFADE_MS;
+Music music_next;
+int music_next_position = -1;      // index of music_next in playlist, -1 while it is not open
+bool music_next_scheduled = false; // crossfading into it, otherwise it starts once music has stopped
+unsigned char* music_next_data = NULL;
+size_t music_next_data_size = 0;
+
+// Latency profiles: how long the device period is, how much decoded audio the
+// stream holds and how often the main loop comes around to refill it.
+// Switching rebuilds the stream and reopens the device, which is audible, so a
+// wanted profile is only applied where playback is interrupted anyway: loading
+// a track, seeking, or while nothing plays.
 typedef struct {
-    char* name;
-    char* artists;
-    char* genres;
-    Texture cover;
-    Image cover_image;
-    int year;
-    char** playlist;
-} Album;
-
-Album* albums;
-
-char* utf162utf8(char* utf16str) {
-    uc_utf16_to_utf8_buffered(utf16str, utf8str, 1024, 0, UC_BYTE_ORDER_BOM, false);
-    return utf8str;
-}
-
-void pop_album() {
-    int index = da_length(albums)-1;
-    for (size_t i = 0; i < da_length(albums[index].playlist); i++) free(albums[index].playlist[i]);
-    da_free(albums[index].playlist);
-    free(albums[index].name);
-    free(albums[index].genres);
-    free(albums[index].artists);
-    UnloadTexture(albums[index].cover);
-    UnloadImage(albums[index].cover_image);
-    da_pop(albums, NULL);
-}
-
-char* music_string_from_textframe(ID3v2_TextFrame* data) {
-    if (data == NULL) return "";
-    char* str;
-    if (data->data->encoding == 1) str = utf162utf8(data->data->text);    else str = data->data->text;
-    return str;
-}
-
-char* music_get_artist_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return "";
-    char* str = music_string_from_textframe(ID3v2_Tag_get_artist_frame(tag));
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-char* music_get_album_artists_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return "";
-    char* str = music_string_from_textframe(ID3v2_Tag_get_album_artist_frame(tag));
-    ID3v2_Tag_free(tag);
-    if (*str == 0) return music_get_artist_from_path(path);
-    return str;
-}
-
-char* music_get_title_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return "";
-    char* str = music_string_from_textframe(ID3v2_Tag_get_title_frame(tag));
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-int music_get_no_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return 0;
-    char* str = music_string_from_textframe(ID3v2_Tag_get_track_frame(tag));
-    ID3v2_Tag_free(tag);
-    while (*str == '0') str++;
-    return atoi(str);
-}
-
-char* music_get_album_name_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return "";
-    char* str = music_string_from_textframe(ID3v2_Tag_get_album_frame(tag));
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-char* music_get_genres_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return "";
-    char* str = music_string_from_textframe(ID3v2_Tag_get_genre_frame(tag));
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-int music_get_year_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return 0;
-    char* str = music_string_from_textframe(ID3v2_Tag_get_year_frame(tag));
-    ID3v2_Tag_free(tag);
-    int num = atoi(str);
-    return num;
-}
-
-Image music_get_cover_from_path(char* path) {
-    ID3v2_Tag* tag = ID3v2_read_tag(path);
-    if (tag == NULL) return GenImageColor(64, 64, theme.mg_off);
-    ID3v2_ApicFrame* data = ID3v2_Tag_get_album_cover_frame(tag);
-    if (data == NULL) return GenImageColor(64, 64, theme.mg_off);
-    if (strcmp(data->data->mime_type, ID3v2_MIME_TYPE_JPG) == 0) {
-        return LoadImageFromMemory(".jpg", (const unsigned char*) data->data->data, data->data->picture_size);
-    } return LoadImageFromMemory(".png", (const unsigned char*) data->data->data, data->data->picture_size);
-}
-
-void album_new(char* name, char* path) {
-    char* mname    = malloc(strlen(name)    + 1); memcpy(mname,    name,    strlen(name)    + 1);
-    char* artists  = music_get_album_artists_from_path(path);
-    char* martists = malloc(strlen(artists) + 1); memcpy(martists, artists, strlen(artists) + 1);
-    char* genres   = music_get_genres_from_path(path);
-    char* mgenres  = malloc(strlen(name)    + 1); memcpy(mgenres,  genres,  strlen(genres)  + 1);
-    Image cover = music_get_cover_from_path(path);
-    //Image cover = GenImageColor(64, 64, theme.fg);
-    Image cover_copy = ImageCopy(cover);
-    ImageResize(&cover, font_size*6.f, font_size*6.f);
-    Album a = {.name = mname, .artists = martists, .genres = mgenres, .cover_image = cover_copy, .cover = LoadTextureFromImage(cover), .year = music_get_year_from_path(path), .playlist = da_new(char*)};
-    UnloadImage(cover);
-    da_push(albums, a);
-}
-
-void album_add_song(char* path) {
-    char* name = music_get_album_name_from_path(path);
-    if (*name == 0) { da_push(albums[0].playlist, path); return; }
-    size_t index = 0;
-    bool found = false;
-    for (size_t i = 0; i < da_length(albums); i++) {
-        if (strcmp(albums[i].name, name) == 0) { found = true; index = i; break; }
-    }
-    char* mpath = malloc(strlen(path)+1); memcpy(mpath, path, strlen(path)+1);
-    if (!found) {
-        album_new(name, path);
-        index = da_length(albums)-1;
+    const char* name;
+    float period_ms;  // device period
+    float buffer_ms;  // each of the stream's two halves
+    int fps;          // main loop rate, the stream is refilled once a frame
+    AudioStats stats; // device counters while this profile was applied
+} MusicProfile;
+
+enum { MUSIC_PROFILE_LOW_LATENCY, MUSIC_PROFILE_LOW_WAKEUP };
+
+MusicProfile music_profiles[] = {
+    {"low latency", 5, 25, 60, {0}},     // while the window is in use
+    {"low wakeup", 100, 2000, 4, {0}},   // in the background: seconds of audio, a few wakeups a second
+};
+
+#define MUSIC_BACKGROUND_DELAY 10.0 // seconds without focus before going low wakeup
+
+int music_profile = -1;
+int music_profile_wanted = MUSIC_PROFILE_LOW_LATENCY;
+AudioStats music_stats_mark; // device counters when music_profile was applied
+double music_focus_time = 0;
+
+// Counters of a profile, including the time since it was applied if it is the current one
+AudioStats music_profile_stats(int profile) {
+    AudioStats stats = music_profiles[profile].stats;
+    if (profile != music_profile) return stats;
+    AudioStats now = GetAudioDeviceStats();
+    stats.callbacks += now.callbacks - music_stats_mark.callbacks;
+    stats.frames += now.frames - music_stats_mark.frames;
+    stats.interval += now.interval - music_stats_mark.interval;
+    stats.refills += now.refills - music_stats_mark.refills;
+    stats.underruns += now.underruns - music_stats_mark.underruns;
+    return stats;
+}
+
+// Takes effect for the next stream, see music_open
+void music_apply_profile(int profile) {
+    if (music_profile != -1) music_profiles[music_profile].stats = music_profile_stats(music_profile);
+    music_profile = profile;
+    MusicProfile* p = &music_profiles[profile];
+    SetAudioDevicePeriodSize(GetAudioDeviceSampleRate()*p->period_ms/1000);
+    SetAudioStreamBufferSizeDefault(GetAudioDeviceSampleRate()*p->buffer_ms/1000);
+    SetTargetFPS(p->fps);
+    music_stats_mark = GetAudioDeviceStats();
+}
+
+// Plays from data when the file was prefetched
+Music music_open(char* filename, unsigned char* data, size_t data_size) {
+    Music stream;
+    if (data != NULL) stream = LoadMusicStreamFromMemory(".mp3", data, data_size);
+    else stream = LoadMusicStream(filename);
+    SetMusicVolume(stream, loudness_gain(filename)); // music_volume stays the master volume
+    SetMusicStreamCacheKey(stream, library_file_key(filename)); // a rewritten file is decoded anew
+    stream.looping = music_repeat == 2;
+    return stream;
+}
+
+// Only the track being heard feeds the spectrum, the two of a crossfade would
+// interleave in its ring. The next one takes over once music has stopped
+void music_attach_spectrum() {
+    if (music_spectrum && music.stream.buffer != NULL) AttachAudioStreamProcessor(music.stream, spectrum_push);
+}
+
+// Only a change of rate reopens the device, so a run of same-rate tracks (an album,
+// usually) plays through one device and raylib never resamples it
+void music_follow_rate() {
+    if (music_native_rate && music.stream.sampleRate != 0) SetAudioDeviceSampleRate(music.stream.sampleRate);
+}
+
+// raylib does not free the processors of a stream it unloads
+void music_close(Music stream) {
+    if (music_spectrum && stream.stream.buffer != NULL) DetachAudioStreamProcessor(stream.stream, spectrum_push);
+    UnloadMusicStream(stream);
+}
+
+// Back to the current track alone, at its own volume
+void music_cancel_next() {
+    if (music_next_position == -1) return;
+    CancelMusicStreamCrossfade(music);
+    music_close(music_next);
+    free(music_next_data);
+    music_next_data = NULL;
+    music_next_position = -1;
+    music_next_scheduled = false;
+}
+
+// Filled before it plays, the main loop may not come around for a whole frame
+void music_start(float time) {
+    if (time > 0) SeekMusicStream(music, time);
+    UpdateMusicStream(music);
+    PlayMusicStream(music);
+    if (!music_playing) PauseMusicStream(music);
+}
+
+// Rebuilds the stream with the wanted profile, playing from time
+void music_reopen(float time) {
+    music_cancel_next();
+    music_close(music);
+    music_apply_profile(music_profile_wanted);
+    music = music_open(playlist[playlist_position], music_data, music_data_size);
+    music_attach_spectrum();
+    music_follow_rate();
+    music_start(time);
+}
+
+// The track that plays after the current one (see music_playlist_next), -1 for none
+int music_next_index() {
+    if (playlist_position < 0) return -1;
+    int next = playlist_position + 1;
+    if (next == (int) da_length(playlist)) next = music_repeat == 1 ? 0 : -1;
+    if (music_repeat == 2 || next == playlist_position) next = -1; // the same file plays again, from the open stream
+    return next;
+}
+
+// A current track that was not prefetched plays from disk until it is read, then the next one
+void music_prefetch_next() {
+    char* paths[2];
+    size_t count = 0;
+    if (music_loaded && music_data == NULL && !music_from_disk) paths[count++] = playlist[playlist_position];
+    int next = music_next_index();
+    if (next != -1 && next != music_next_position) paths[count++] = playlist[next]; // an open next track has its data already
+    prefetch_request(paths, count);
+}
+
+// Moves the current track from disk to memory once it is read: the decoder is
+// swapped between two refills, so what is queued plays on and nothing is heard
+void music_take_data() {
+    if (music_data != NULL || music_from_disk) return;
+    size_t size = 0;
+    unsigned char* data = prefetch_take(playlist[playlist_position], &size);
+    if (data == NULL) return;
+    if (SetMusicStreamData(&music, ".mp3", data, size)) {
+        music_data = data;
+        music_data_size = size;
+    } else {
+        free(data);
+        music_from_disk = true;
     }
-    da_push(albums[index].playlist, mpath);
+    music_prefetch_next();
 }
 
-void music_scan(char* path) {
-    char* epath = get_path(path);
-    FilePathList list = LoadDirectoryFilesEx(epath, ".mp3", true);
-    for (size_t i = 0; i < list.count; i++) {        
-        char* mpath = get_path(norm_text(list.paths[i]));
-        TraceLog(LOG_INFO, "Scanning %s", mpath);
-        album_add_song(mpath);
-    }
-    UnloadDirectoryFiles(list);
+// Playlist or repeat changes may make another track the next one
+void music_next_changed() {
+    if (music_next_position != -1 && music_next_index() != music_next_position) music_cancel_next();
+    music_prefetch_next();
 }
 
-void music_load(char* filename) {
-    music = LoadMusicStream(filename);
-    PlayMusicStream(music);
-    music.looping = music_repeat == 2;
-    tag = ID3v2_read_tag(filename);
+// What goes with the track at playlist_position once music plays it
+void music_show(char* filename) {
+    tag = ID3v2_read_tag_view(filename);
+    wave_request(filename);
     music_loaded = true;
+    music_from_disk = false;
+    music_prefetch_next();
+}
+
+void music_load(char* filename) {
+    if (music_profile != music_profile_wanted) music_apply_profile(music_profile_wanted);
+    music_data = prefetch_take(filename, &music_data_size);
+    music = music_open(filename, music_data, music_data_size);
+    music_attach_spectrum();
+    music_follow_rate();
     music_playing = true;
+    music_start(0);
+    music_show(filename);
 }
 
 void music_unload() {
-    UnloadMusicStream(music);
+    music_cancel_next();
+    music_close(music);
+    free(music_data);
+    music_data = NULL;
     music_loaded = false;
-    ID3v2_Tag_free(tag);
-    tag = ID3v2_Tag_new_empty();
+    ID3v2_TagView_free(tag);
+    tag = NULL;
 }
 
 void music_add_to_playlist(char* path) {
-    char* realloced_path = malloc(strlen(path) + 1);
-    memcpy(realloced_path, path, strlen(path) + 1);
-    da_push(playlist, realloced_path);
+    playlist_add(path);
     if (!music_loaded) {
         playlist_position = da_length(playlist) - 1;
         music_load(path);
-    }
+    } else music_next_changed();
 }
 
 void music_remove_from_playlist(size_t indice) {
-    if (playlist_position > (int) indice) playlist_position--;
-    else if ((int) indice == playlist_position) {
-        music_unload();
-        playlist_position = -1;
-    }
-    free(playlist[indice]);
-    memcpy(playlist + indice, playlist + indice + 1, da_stride(playlist) * (da_length(playlist) - indice));
-    da_pop(playlist, 0);
-}
-
-bool music_ismusic(char* path) {
-    FILE* f = fopen(path, "rb");
-    if (f == NULL) return false;
-    char magic[3] = {0};
-    if (fread(magic, 1, 3, f) != 3) {
-        fclose(f); return false;
-    }
-    fclose(f);
-    return memcmp(magic, "\xFF\xFB", 2) == 0 || memcmp(magic, "\xFF\xF3", 2) == 0 || memcmp(magic, "\xFF\xF2", 2) == 0 || memcmp(magic, "ID3", 3) == 0; // only mp3s are supported
+    music_cancel_next(); // its index may shift
+    if ((int) indice == playlist_position) music_unload();
+    playlist_remove(indice);
+    music_prefetch_next();
 }
 
 char* music_get_name() {
     if (!music_loaded || tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_title_frame(tag);
-    if (data == NULL) return "";
-    char* str = utf162utf8(data->data->text);
-    return str;
+    return music_string_from_frame_view(ID3v2_TagView_get_frame(tag, ID3v2_TITLE_FRAME_ID));
 }
 
 char* music_get_artist() {
     if (!music_loaded || tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_artist_frame(tag);
-    if (data == NULL) return "";
-    char* str = utf162utf8(data->data->text);
-    return str;
+    return music_string_from_frame_view(ID3v2_TagView_get_frame(tag, ID3v2_ARTIST_FRAME_ID));
 }
 
 char* music_get_album() {
     if (!music_loaded || tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_album_frame(tag);
-    if (data == NULL) return "";
-    char* str = utf162utf8(data->data->text);
-    return str;
-}
-
-char* music_get_name_playlist(size_t indice) {
-    ID3v2_Tag* tag = ID3v2_read_tag(playlist[indice]);
-    if (tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_title_frame(tag);
-    if (data == NULL) return "";
-    char* str = utf162utf8(data->data->text);
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-char* music_get_artist_playlist(size_t indice) {
-    ID3v2_Tag* tag = ID3v2_read_tag(playlist[indice]);
-    if (tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_artist_frame(tag);
-    if (data == NULL) return "";
-    char* str = utf162utf8(data->data->text);
-    ID3v2_Tag_free(tag);
-    return str;
-}
-
-char* music_get_album_playlist(size_t indice) {
-    ID3v2_Tag* tag = ID3v2_read_tag(playlist[indice]);
-    if (tag == NULL) return "";
-    ID3v2_TextFrame* data = ID3v2_Tag_get_album_frame(tag);
-    if (data == NULL) return "";    
-    char* str = utf162utf8(data->data->text);
-    ID3v2_Tag_free(tag);
-    return str;
+    return music_string_from_frame_view(ID3v2_TagView_get_frame(tag, ID3v2_ALBUM_FRAME_ID));
 }
 
 void music_play_pause() {
     if (!music_loaded) return;
-    if (music_playing) PauseMusicStream(music);
-    else ResumeMusicStream(music);
+    if (music_playing) {
+        music_cancel_next(); // scheduled on the device clock, which keeps going
+        PauseMusicStream(music);
+    } else ResumeMusicStream(music);
     music_playing = !music_playing;
 }
 
@@ -274,6 +261,25 @@ void music_toggle_repeat() {
     if (!music_loaded) return;
     music_repeat = (music_repeat + 1) % 3;
     music.looping = music_repeat == 2;
+    music_next_changed();
+}
+
+void music_toggle_native_rate() {
+    music_cancel_next();
+    music_native_rate = !music_native_rate;
+    if (music_native_rate && music_loaded) SetAudioDeviceSampleRate(music.stream.sampleRate);
+    else if (!music_native_rate) SetAudioDeviceSampleRate(0);
+}
+
+// Hidden, the spectrum costs nothing: no copy in the audio callback and no analysis thread
+void music_toggle_spectrum() {
+    if (!music_spectrum) spectrum_start();
+    if (music_loaded && music.stream.buffer != NULL) {
+        if (music_spectrum) DetachAudioStreamProcessor(music.stream, spectrum_push);
+        else AttachAudioStreamProcessor(music.stream, spectrum_push);
+    }
+    if (music_spectrum) spectrum_stop();
+    music_spectrum = !music_spectrum;
 }
 
 float music_get_current_time() {
@@ -283,7 +289,13 @@ float music_get_current_time() {
 
 void music_seek(float time) {
     if (!music_loaded) return;
+    music_cancel_next();
+    if (music_profile != music_profile_wanted) {
+        music_reopen(time);
+        return;
+    }
     SeekMusicStream(music, time);
+    UpdateMusicStream(music);
 }
 
 float music_get_full_time() {
@@ -312,8 +324,76 @@ void music_playlist_previous() {
     }
 }
 
-void music_update() {
-    if (music_loaded && music_playing && !IsMusicStreamPlaying(music)) {
-        music_playlist_next();
+// Low latency while the window is in use, low wakeup once it has been in the background for a while
+void music_profile_update() {
+    if (IsWindowFocused() && !IsWindowMinimized()) {
+        music_focus_time = GetTime();
+        music_profile_wanted = MUSIC_PROFILE_LOW_LATENCY;
+    } else if (GetTime() - music_focus_time > MUSIC_BACKGROUND_DELAY) {
+        music_profile_wanted = MUSIC_PROFILE_LOW_WAKEUP;
     }
+    if (music_profile == music_profile_wanted) return;
+    // A faster frame rate is safe with any stream, so the UI is smooth again
+    // right away and only the stream waits for a gap to be rebuilt
+    int fps = music_profiles[music_profile_wanted].fps;
+    if (fps > music_profiles[music_profile].fps) SetTargetFPS(fps);
+    if (!music_loaded) music_apply_profile(music_profile_wanted);
+    else if (!music_playing) music_reopen(GetMusicTimePlayed(music));
+}
+
+// Opens the next track once the current one is about to end and hands it to
+// raylib, which starts it where the crossfade begins
+void music_schedule_next() {
+    int next = music_next_index();
+    if (next == -1 || music.stream.buffer == NULL) return;
+    if (music_profile != music_profile_wanted) return; // the profile changes with the next track load instead
+    float fade = music_crossfade_ms/1000.f;
+    if (music_get_full_time() - music_get_current_time() > fade + MUSIC_PREOPEN_LEAD) return;
+    // Consecutive tracks of an album are often one recording split in two, they are never faded
+    if (album_follows(playlist[playlist_position], playlist[next])) fade = 0;
+
+    music_next_data = prefetch_take(playlist[next], &music_next_data_size);
+    music_next = music_open(playlist[next], music_next_data, music_next_data_size);
+    music_next_position = next;
+    if (music_next.stream.buffer == NULL) return;
+    UpdateMusicStream(music_next);
+    // At another rate the device reopens, which cuts anyway: it starts once music has stopped
+    if (music_native_rate && music_next.stream.sampleRate != GetAudioDeviceSampleRate()) return;
+    CrossfadeMusicStream(music, music_next, fade);
+    music_next_scheduled = true;
+    music_prefetch_next();
+}
+
+// music has stopped, the next track takes its place
+void music_advance() {
+    Music next = music_next;
+    unsigned char* next_data = music_next_data;
+    size_t next_data_size = music_next_data_size;
+    int next_position = music_next_position;
+    bool scheduled = music_next_scheduled;
+    music_next_position = -1;
+    music_next_data = NULL;
+    music_next_scheduled = false;
+
+    music_unload();
+    music = next;
+    music_attach_spectrum();
+    music_data = next_data;
+    music_data_size = next_data_size;
+    playlist_position = next_position;
+    if (!scheduled) {
+        music_follow_rate();
+        music_start(0);
+    }
+    music_show(playlist[playlist_position]);
+}
+
+void music_update() {
+    if (!music_loaded) return;
+    music_take_data();
+    if (music_next_position != -1) UpdateMusicStream(music_next);
+    if (music_playing && !IsMusicStreamPlaying(music)) {
+        if (music_next_position != -1) music_advance();
+        else music_playlist_next();
+    } else if (music_playing && music_next_position == -1) music_schedule_next();
 }
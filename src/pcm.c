@@ -0,0 +1,49 @@
+// Decoded audio.
+// The analyses that need the samples of a whole track (waveform overviews,
+// loudness) decode it themselves as float frames, with a private copy of the
+// decoder raudio uses: raylib's own is not exported, and this way they never
+// touch the stream the audio device plays from.
+
+#include <stdlib.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#define DRMP3_API static
+#define DR_MP3_IMPLEMENTATION
+#include "external/dr_mp3.h"
+#pragma GCC diagnostic pop
+
+#include "library.h"
+
+bool pcm_open(Pcm* pcm, char* path) {
+    drmp3* mp3 = malloc(sizeof(drmp3));
+    if (!drmp3_init_file(mp3, get_path(path), NULL)) {
+        free(mp3);
+        return false;
+    }
+    pcm->decoder = mp3;
+    pcm->channels = mp3->channels;
+    pcm->sample_rate = mp3->sampleRate;
+    if (pcm->channels == 0 || pcm->sample_rate == 0) {
+        pcm_close(pcm);
+        return false;
+    }
+    return true;
+}
+
+// Walks the frame headers of the whole file, then starts over
+uint64_t pcm_frame_count(Pcm* pcm) {
+    uint64_t frames = drmp3_get_pcm_frame_count(pcm->decoder);
+    if (!drmp3_seek_to_pcm_frame(pcm->decoder, 0)) return 0;
+    return frames;
+}
+
+uint64_t pcm_read(Pcm* pcm, float* out, uint64_t frames) {
+    return drmp3_read_pcm_frames_f32(pcm->decoder, frames, out);
+}
+
+void pcm_close(Pcm* pcm) {
+    drmp3_uninit(pcm->decoder);
+    free(pcm->decoder);
+    pcm->decoder = NULL;
+}
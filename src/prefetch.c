@@ -0,0 +1,209 @@
+// Prefetching.
+// A track streamed from disk is read a little at a time while it plays, and on
+// network mounts or a spun-down disk one slow read is a dropout. The tracks
+// that play next are instead read whole, by a thread of its own, in large
+// sequential reads, and handed to the player as memory. prefetch_window caps
+// the bytes held: a track that does not fit is left to stream from disk.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "library.h"
+
+size_t prefetch_window = PREFETCH_WINDOW;
+
+typedef struct {
+    char* path;          // NULL for a free slot
+    unsigned char* data; // the whole file once it is read
+    size_t size;
+    bool failed;         // unreadable, or larger than what is left of the window
+} PrefetchFile;
+
+pthread_t prefetch_thread;
+bool prefetch_running = false;
+pthread_mutex_t prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t prefetch_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by prefetch_lock
+bool prefetch_quit = false;
+PrefetchFile prefetch_files[PREFETCH_SLOTS]; // wanted files, in the order they play
+
+char* prefetch_strdup(const char* str) {
+    char* copy = malloc(strlen(str)+1);
+    memcpy(copy, str, strlen(str)+1);
+    return copy;
+}
+
+void prefetch_clear(PrefetchFile* file) {
+    free(file->path);
+    free(file->data);
+    *file = (PrefetchFile) {0};
+}
+
+// With prefetch_lock held
+PrefetchFile* prefetch_find(const char* path) {
+    for (size_t i = 0; i < PREFETCH_SLOTS; i++) {
+        if (prefetch_files[i].path != NULL && strcmp(prefetch_files[i].path, path) == 0) return &prefetch_files[i];
+    }
+    return NULL;
+}
+
+bool prefetch_wanted(const char* path) {
+    pthread_mutex_lock(&prefetch_lock);
+    bool wanted = !prefetch_quit && prefetch_find(path) != NULL;
+    pthread_mutex_unlock(&prefetch_lock);
+    return wanted;
+}
+
+// Reads at most limit bytes, gives up once path is no longer wanted
+unsigned char* prefetch_read(char* path, size_t limit, size_t* size, bool* too_large) {
+    *too_large = false;
+    FILE* f = fopen(get_path(path), "rb");
+    if (f == NULL) return NULL;
+    setvbuf(f, NULL, _IONBF, 0); // every read is already large, stdio would only add a copy
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (length <= 0 || (size_t) length > limit) {
+        *too_large = length > 0;
+        fclose(f);
+        return NULL;
+    }
+
+    unsigned char* data = malloc(length);
+    size_t done = 0;
+    while (done < (size_t) length) {
+        size_t want = (size_t) length - done;
+        if (want > PREFETCH_CHUNK) want = PREFETCH_CHUNK;
+        size_t got = fread(data + done, 1, want, f);
+        done += got;
+        if (got < want || !prefetch_wanted(path)) break;
+    }
+    fclose(f);
+    if (done < (size_t) length) { // cut short: an error, a truncated file, or no longer wanted
+        free(data);
+        return NULL;
+    }
+    *size = done;
+    return data;
+}
+
+void* prefetch_main(void* arg) {
+    (void) arg;
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+    while (true) {
+        pthread_mutex_lock(&prefetch_lock);
+        PrefetchFile* next = NULL;
+        size_t held = 0;
+        while (!prefetch_quit) {
+            held = 0;
+            next = NULL;
+            for (size_t i = 0; i < PREFETCH_SLOTS; i++) {
+                PrefetchFile* file = &prefetch_files[i];
+                if (file->path == NULL) continue;
+                held += file->size;
+                if (next == NULL && file->data == NULL && !file->failed) next = file;
+            }
+            if (next != NULL) break;
+            pthread_cond_wait(&prefetch_wake, &prefetch_lock);
+        }
+        if (prefetch_quit) {
+            pthread_mutex_unlock(&prefetch_lock);
+            break;
+        }
+        char* path = prefetch_strdup(next->path);
+        size_t limit = prefetch_window > held ? prefetch_window - held : 0;
+        pthread_mutex_unlock(&prefetch_lock);
+
+        size_t size = 0;
+        bool too_large = false;
+        unsigned char* data = prefetch_read(path, limit, &size, &too_large);
+        if (data == NULL) library_log("prefetch: %s %s\n", too_large ? "no room for" : "could not read", path);
+
+        pthread_mutex_lock(&prefetch_lock);
+        PrefetchFile* file = prefetch_find(path);
+        if (file != NULL && file->data == NULL) {
+            file->data = data;
+            file->size = size;
+            file->failed = data == NULL;
+            data = NULL;
+        }
+        pthread_mutex_unlock(&prefetch_lock);
+        free(data);
+        free(path);
+    }
+    return NULL;
+}
+
+void prefetch_start() {
+    if (prefetch_window == 0) return;
+    prefetch_running = pthread_create(&prefetch_thread, NULL, prefetch_main, NULL) == 0;
+}
+
+void prefetch_stop() {
+    if (prefetch_running) {
+        pthread_mutex_lock(&prefetch_lock);
+        prefetch_quit = true;
+        pthread_cond_broadcast(&prefetch_wake);
+        pthread_mutex_unlock(&prefetch_lock);
+        pthread_join(prefetch_thread, NULL);
+        prefetch_running = false;
+    }
+    for (size_t i = 0; i < PREFETCH_SLOTS; i++) prefetch_clear(&prefetch_files[i]);
+}
+
+// Files already read and still wanted are kept, the rest are dropped
+void prefetch_request(char** paths, size_t count) {
+    if (!prefetch_running) return;
+    if (count > PREFETCH_SLOTS) count = PREFETCH_SLOTS;
+    PrefetchFile files[PREFETCH_SLOTS] = {0};
+    pthread_mutex_lock(&prefetch_lock);
+    for (size_t i = 0; i < count; i++) {
+        PrefetchFile* old = prefetch_find(paths[i]);
+        if (old != NULL) {
+            files[i] = *old;
+            *old = (PrefetchFile) {0};
+        } else files[i].path = prefetch_strdup(paths[i]);
+    }
+    for (size_t i = 0; i < PREFETCH_SLOTS; i++) {
+        prefetch_clear(&prefetch_files[i]);
+        prefetch_files[i] = files[i];
+    }
+    pthread_cond_signal(&prefetch_wake);
+    pthread_mutex_unlock(&prefetch_lock);
+}
+
+// Wanted files that are neither read nor given up on yet
+size_t prefetch_pending() {
+    size_t pending = 0;
+    pthread_mutex_lock(&prefetch_lock);
+    for (size_t i = 0; i < PREFETCH_SLOTS; i++) {
+        if (prefetch_files[i].path != NULL && prefetch_files[i].data == NULL && !prefetch_files[i].failed) pending++;
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+    return pending;
+}
+
+// The caller owns what it gets, NULL until the whole file is in memory
+unsigned char* prefetch_take(const char* path, size_t* size) {
+    if (!prefetch_running) return NULL;
+    unsigned char* data = NULL;
+    pthread_mutex_lock(&prefetch_lock);
+    PrefetchFile* file = prefetch_find(path);
+    if (file != NULL && file->data != NULL) {
+        data = file->data;
+        *size = file->size;
+        file->data = NULL;
+        prefetch_clear(file);
+    }
+    pthread_mutex_unlock(&prefetch_lock);
+    return data;
+}
@@ -0,0 +1,272 @@
+// Spectrum analysis.
+// The status bar can show what plays as a spectrum and a level meter. The audio
+// callback must never wait, so all it does for them is spectrum_push: a copy
+// of the frames it mixes into a ring, published with a single atomic store. A
+// thread of its own transforms the latest SPECTRUM_SIZE frames whenever the UI
+// takes a picture, and hands the next one back double-buffered: the renderer
+// reads one snapshot while the other is being written. Hidden, the UI neither
+// attaches the copy to the stream nor runs the thread.
+
+#include <pthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "library.h"
+
+#define SPECTRUM_RING (SPECTRUM_SIZE*4) // frames, a power of two so that the frame counter may wrap
+#define SPECTRUM_LOW 40.f    // Hz, lower edge of the first band
+#define SPECTRUM_HIGH 16000.f // Hz, upper edge of the last band
+#define SPECTRUM_FALL 1.5f   // how fast bars drop, in their full height per second
+
+// Written by spectrum_push only, on the audio thread
+float spectrum_ring[SPECTRUM_RING*2];
+uint32_t spectrum_written = 0; // frames ever pushed, read by the analysis thread with acquire loads
+// Frames the analysis thread has copied, stored with release after every copy.
+// The callback's acquire load of it orders overwriting a slot after reading it.
+uint32_t spectrum_copied = 0;
+
+// Tables of the transform, made once
+bool spectrum_tables = false;
+float spectrum_window[SPECTRUM_SIZE];
+float spectrum_twiddles[2][SPECTRUM_SIZE]; // real and imaginary, the stage of half size h at [h, 2h)
+uint16_t spectrum_reverse[SPECTRUM_SIZE];
+
+pthread_t spectrum_thread;
+bool spectrum_running = false;
+pthread_mutex_t spectrum_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t spectrum_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by spectrum_lock
+bool spectrum_quit = false;
+bool spectrum_wanted = false; // the renderer took the last snapshot and wants the next one
+bool spectrum_ready = false;  // the back snapshot is done
+uint32_t spectrum_rate = 48000;
+Spectrum spectrum_snapshots[2];
+int spectrum_front = 0; // read by the renderer, the other one is written by the thread
+
+double spectrum_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void spectrum_init_tables() {
+    if (spectrum_tables) return;
+    int bits = 0;
+    while ((1 << bits) < SPECTRUM_SIZE) bits++;
+    for (int i = 0; i < SPECTRUM_SIZE; i++) {
+        spectrum_window[i] = 0.5f - 0.5f*cosf(2*M_PI*i/SPECTRUM_SIZE); // Hann
+        int r = 0;
+        for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+        spectrum_reverse[i] = r;
+    }
+    for (int h = 1; h < SPECTRUM_SIZE; h <<= 1) {
+        for (int k = 0; k < h; k++) {
+            spectrum_twiddles[0][h + k] = cos(-M_PI*k/h);
+            spectrum_twiddles[1][h + k] = sin(-M_PI*k/h);
+        }
+    }
+    spectrum_tables = true;
+}
+
+// In place, radix-2, the input in bit-reversed order. Stages of at least four
+// butterflies per block run four at a time, only the first two are scalar.
+void spectrum_fft(float* re, float* im) {
+    for (size_t h = 1; h < SPECTRUM_SIZE; h <<= 1) {
+        const float* wr = spectrum_twiddles[0] + h;
+        const float* wi = spectrum_twiddles[1] + h;
+        for (size_t start = 0; start < SPECTRUM_SIZE; start += 2*h) {
+            float* ar = re + start;
+            float* ai = im + start;
+            float* br = ar + h;
+            float* bi = ai + h;
+            size_t k = 0;
+#if defined(__SSE2__)
+            for (; k + 4 <= h; k += 4) {
+                __m128 xr = _mm_loadu_ps(br + k), xi = _mm_loadu_ps(bi + k);
+                __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+                __m128 yr = _mm_loadu_ps(ar + k), yi = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+            }
+#elif defined(__ARM_NEON)
+            for (; k + 4 <= h; k += 4) {
+                float32x4_t xr = vld1q_f32(br + k), xi = vld1q_f32(bi + k);
+                float32x4_t cr = vld1q_f32(wr + k), ci = vld1q_f32(wi + k);
+                float32x4_t tr = vmlsq_f32(vmulq_f32(xr, cr), xi, ci);
+                float32x4_t ti = vmlaq_f32(vmulq_f32(xr, ci), xi, cr);
+                float32x4_t yr = vld1q_f32(ar + k), yi = vld1q_f32(ai + k);
+                vst1q_f32(br + k, vsubq_f32(yr, tr));
+                vst1q_f32(bi + k, vsubq_f32(yi, ti));
+                vst1q_f32(ar + k, vaddq_f32(yr, tr));
+                vst1q_f32(ai + k, vaddq_f32(yi, ti));
+            }
+#endif
+            for (; k < h; k++) {
+                float tr = br[k]*wr[k] - bi[k]*wi[k];
+                float ti = br[k]*wi[k] + bi[k]*wr[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
+
+// Decibels below full scale to a bar height, SPECTRUM_RANGE dB is empty
+float spectrum_height(float db) {
+    float height = 1 + db/SPECTRUM_RANGE;
+    return height < 0 ? 0 : height > 1 ? 1 : height;
+}
+
+void spectrum_compute(const float* frames, uint32_t sample_rate, Spectrum* out) {
+    spectrum_init_tables();
+    float re[SPECTRUM_SIZE], im[SPECTRUM_SIZE];
+    float sums[2] = {0};
+    for (size_t i = 0; i < SPECTRUM_SIZE; i++) {
+        float left = frames[i*2], right = frames[i*2 + 1];
+        sums[0] += left*left;
+        sums[1] += right*right;
+        size_t j = spectrum_reverse[i];
+        re[j] = (left + right)*0.5f*spectrum_window[i];
+        im[j] = 0;
+    }
+    for (int c = 0; c < 2; c++) out->levels[c] = spectrum_height(10*log10f(sums[c]/SPECTRUM_SIZE*2 + 1e-12f)); // a full scale sine is 0 dB
+    spectrum_fft(re, im);
+
+    // A full scale sine peaks at SPECTRUM_SIZE/4 through the Hann window
+    float scale = 1.f/((SPECTRUM_SIZE/4.f)*(SPECTRUM_SIZE/4.f));
+    float high = fminf(SPECTRUM_HIGH, sample_rate*0.5f);
+    size_t first = SPECTRUM_LOW*SPECTRUM_SIZE/sample_rate;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        size_t last = SPECTRUM_LOW*powf(high/SPECTRUM_LOW, (b + 1.f)/SPECTRUM_BANDS)*SPECTRUM_SIZE/sample_rate;
+        if (last > SPECTRUM_SIZE/2) last = SPECTRUM_SIZE/2;
+        if (last <= first) last = first + 1; // the low bands are narrower than a bin
+        float power = 0;
+        for (size_t k = first; k < last; k++) power = fmaxf(power, re[k]*re[k] + im[k]*im[k]);
+        out->bands[b] = spectrum_height(10*log10f(power*scale + 1e-12f));
+        first = last;
+    }
+}
+
+// The latest SPECTRUM_SIZE frames, false if nothing was pushed since seen or
+// the callback went round the ring while they were copied
+bool spectrum_latest(float* frames, uint32_t* seen) {
+    uint32_t end = __atomic_load_n(&spectrum_written, __ATOMIC_ACQUIRE);
+    if (end == *seen) return false;
+    uint32_t start = end - SPECTRUM_SIZE;
+    size_t at = start % SPECTRUM_RING;
+    size_t first = SPECTRUM_SIZE < SPECTRUM_RING - at ? SPECTRUM_SIZE : SPECTRUM_RING - at;
+    memcpy(frames, spectrum_ring + at*2, first*2*sizeof(float));
+    memcpy(frames + first*2, spectrum_ring, (SPECTRUM_SIZE - first)*2*sizeof(float));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&spectrum_written, __ATOMIC_RELAXED) - start > SPECTRUM_RING) return false;
+    __atomic_store_n(&spectrum_copied, end, __ATOMIC_RELEASE);
+    *seen = end;
+    return true;
+}
+
+void spectrum_push(void* frames, unsigned int count) {
+    const float* in = frames;
+    __atomic_load_n(&spectrum_copied, __ATOMIC_ACQUIRE);
+    uint32_t end = __atomic_load_n(&spectrum_written, __ATOMIC_RELAXED) + count;
+    if (count > SPECTRUM_RING) {
+        in += (count - SPECTRUM_RING)*2;
+        count = SPECTRUM_RING;
+    }
+    size_t at = (end - count) % SPECTRUM_RING;
+    size_t first = count < SPECTRUM_RING - at ? count : SPECTRUM_RING - at;
+    memcpy(spectrum_ring + at*2, in, first*2*sizeof(float));
+    memcpy(spectrum_ring, in + first*2, (count - first)*2*sizeof(float));
+    __atomic_store_n(&spectrum_written, end, __ATOMIC_RELEASE);
+}
+
+void* spectrum_main(void* arg) {
+    (void) arg;
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+    float* frames = malloc(SPECTRUM_SIZE*2*sizeof(float));
+    uint32_t seen = __atomic_load_n(&spectrum_written, __ATOMIC_ACQUIRE);
+    Spectrum shown = {0};
+    double last = spectrum_now();
+    while (true) {
+        pthread_mutex_lock(&spectrum_lock);
+        // One picture per frame drawn, and never into the snapshot the renderer is about to take
+        while (!spectrum_quit && (!spectrum_wanted || spectrum_ready)) pthread_cond_wait(&spectrum_wake, &spectrum_lock);
+        if (spectrum_quit) {
+            pthread_mutex_unlock(&spectrum_lock);
+            break;
+        }
+        spectrum_wanted = false;
+        uint32_t rate = spectrum_rate;
+        Spectrum* back = &spectrum_snapshots[!spectrum_front];
+        pthread_mutex_unlock(&spectrum_lock);
+
+        // Without new frames (paused, or between tracks) the bars fall as if it were silent
+        Spectrum fresh = {0};
+        if (spectrum_latest(frames, &seen)) spectrum_compute(frames, rate, &fresh);
+        double now = spectrum_now();
+        float fall = SPECTRUM_FALL*(now - last);
+        last = now;
+        for (int b = 0; b < SPECTRUM_BANDS; b++) shown.bands[b] = fmaxf(fresh.bands[b], fmaxf(shown.bands[b] - fall, 0));
+        for (int c = 0; c < 2; c++) shown.levels[c] = fmaxf(fresh.levels[c], fmaxf(shown.levels[c] - fall, 0));
+        *back = shown;
+
+        pthread_mutex_lock(&spectrum_lock);
+        spectrum_ready = true;
+        pthread_mutex_unlock(&spectrum_lock);
+    }
+    free(frames);
+    return NULL;
+}
+
+void spectrum_start() {
+    if (spectrum_running) return;
+    spectrum_init_tables();
+    spectrum_running = pthread_create(&spectrum_thread, NULL, spectrum_main, NULL) == 0;
+}
+
+void spectrum_stop() {
+    if (!spectrum_running) return;
+    pthread_mutex_lock(&spectrum_lock);
+    spectrum_quit = true;
+    pthread_cond_broadcast(&spectrum_wake);
+    pthread_mutex_unlock(&spectrum_lock);
+    pthread_join(spectrum_thread, NULL);
+    spectrum_running = false;
+    // Shown again later, it starts from empty bars
+    spectrum_quit = spectrum_wanted = spectrum_ready = false;
+    memset(spectrum_snapshots, 0, sizeof(spectrum_snapshots));
+}
+
+const Spectrum* spectrum_get(uint32_t sample_rate) {
+    pthread_mutex_lock(&spectrum_lock);
+    if (spectrum_ready) {
+        spectrum_front = !spectrum_front;
+        spectrum_ready = false;
+    }
+    if (sample_rate != 0) spectrum_rate = sample_rate;
+    spectrum_wanted = true;
+    pthread_cond_signal(&spectrum_wake);
+    const Spectrum* spectrum = &spectrum_snapshots[spectrum_front];
+    pthread_mutex_unlock(&spectrum_lock);
+    return spectrum;
+}
@@ -0,0 +1,225 @@
+// Thumbnail cache.
+// Album cards need the same few hundred pixels of every cover on each start,
+// so once decoded and sized they are kept on disk as raw RGBA, one file per
+// cover hash and size. Loading one is a single read into the buffer that is
+// then uploaded, no decoding and no resizing. Files are written under a
+// temporary name and renamed, so a thumbnail is either complete or missing.
+// The UI never waits for one: thumb_request hands the cover to a background
+// thread and thumb_take picks up the pixels once they are ready. The newest
+// request is served first, so the covers on screen come before the ones
+// scrolled past, and asking for a new size drops the queued old ones.
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "library.h"
+
+#define THUMB_MAGIC "MUST"
+
+char* thumb_dir = THUMBS_PATH;
+
+typedef struct {
+    unsigned char* data; // a copy, the cover may be released while it waits
+    uint32_t data_size;
+    uint64_t hash;
+    int size;
+    unsigned char* pixels; // once done, NULL if it could not be decoded
+} ThumbRequest;
+
+pthread_t thumb_thread;
+bool thumb_running = false;
+pthread_mutex_t thumb_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t thumb_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by thumb_lock
+bool thumb_quit = false;
+ThumbRequest* thumb_queue = 0;
+ThumbRequest thumb_busy = {0}; // the one being decoded, data is NULL when idle
+ThumbRequest* thumb_done = 0;
+int thumb_size = 0; // of the latest request
+
+void thumb_path(char* path, size_t path_size, uint64_t hash, int size) {
+    snprintf(path, path_size, "%s/%016llx-%d.rgba", thumb_dir, (unsigned long long) hash, size);
+}
+
+unsigned char* thumb_read(uint64_t hash, int size) {
+    char path[1024];
+    thumb_path(path, sizeof(path), hash, size);
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+    char magic[4] = {0};
+    int32_t stored_size = 0;
+    size_t bytes = (size_t) size*size*4;
+    unsigned char* pixels = NULL;
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, THUMB_MAGIC, 4) == 0 &&
+        fread(&stored_size, sizeof(stored_size), 1, f) == 1 && stored_size == size) {
+        pixels = malloc(bytes);
+        if (fread(pixels, 1, bytes, f) != bytes) { free(pixels); pixels = NULL; }
+    }
+    fclose(f);
+    return pixels;
+}
+
+void thumb_write(uint64_t hash, int size, unsigned char* pixels) {
+#ifdef _WIN32
+    mkdir(thumb_dir);
+#else
+    mkdir(thumb_dir, 0755);
+#endif
+    char path[1024], temp[1040];
+    thumb_path(path, sizeof(path), hash, size);
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* f = fopen(temp, "wb");
+    if (f == NULL) return;
+    int32_t stored_size = size;
+    bool ok = fwrite(THUMB_MAGIC, 1, 4, f) == 4 && fwrite(&stored_size, sizeof(stored_size), 1, f) == 1 &&
+              fwrite(pixels, 1, (size_t) size*size*4, f) == (size_t) size*size*4;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(temp, path) != 0) remove(temp);
+}
+
+// Stretches to size x size like ImageResize does for the cards, averaging the
+// source pixels that fall into every output pixel
+unsigned char* thumb_resize(unsigned char* src, int width, int height, int size) {
+    unsigned char* pixels = malloc((size_t) size*size*4);
+    for (int y = 0; y < size; y++) {
+        int y0 = y*height/size, y1 = (y + 1)*height/size;
+        if (y1 <= y0) y1 = y0 + 1;
+        for (int x = 0; x < size; x++) {
+            int x0 = x*width/size, x1 = (x + 1)*width/size;
+            if (x1 <= x0) x1 = x0 + 1;
+            uint32_t sum[4] = {0};
+            for (int sy = y0; sy < y1; sy++) {
+                const unsigned char* p = src + ((size_t) sy*width + x0)*4;
+                for (int sx = x0; sx < x1; sx++, p += 4) {
+                    sum[0] += p[0]; sum[1] += p[1]; sum[2] += p[2]; sum[3] += p[3];
+                }
+            }
+            uint32_t count = (y1 - y0)*(x1 - x0);
+            unsigned char* out = pixels + ((size_t) y*size + x)*4;
+            for (int c = 0; c < 4; c++) out[c] = (sum[c] + count/2)/count;
+        }
+    }
+    return pixels;
+}
+
+unsigned char* thumb_get(const unsigned char* data, uint32_t data_size, uint64_t hash, int size) {
+    if (data == NULL || size <= 0) return NULL;
+    unsigned char* pixels = thumb_read(hash, size);
+    if (pixels != NULL) return pixels;
+
+    int width = 0, height = 0;
+    unsigned char* cover = cover_decode(data, data_size, size, &width, &height);
+    if (cover == NULL) return NULL;
+    pixels = thumb_resize(cover, width, height, size);
+    free(cover);
+    thumb_write(hash, size, pixels);
+    return pixels;
+}
+
+void* thumb_main(void* arg) {
+    (void) arg;
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10); // see wave_main
+#endif
+    while (true) {
+        pthread_mutex_lock(&thumb_lock);
+        while (!thumb_quit && da_length(thumb_queue) == 0) pthread_cond_wait(&thumb_wake, &thumb_lock);
+        if (thumb_quit) {
+            pthread_mutex_unlock(&thumb_lock);
+            break;
+        }
+        da_pop(thumb_queue, &thumb_busy);
+        ThumbRequest request = thumb_busy;
+        pthread_mutex_unlock(&thumb_lock);
+
+        request.pixels = thumb_get(request.data, request.data_size, request.hash, request.size);
+        free(request.data);
+        request.data = NULL;
+
+        pthread_mutex_lock(&thumb_lock);
+        da_push(thumb_done, request);
+        thumb_busy.data = NULL;
+        pthread_mutex_unlock(&thumb_lock);
+    }
+    return NULL;
+}
+
+void thumb_start() {
+    thumb_queue = da_new(ThumbRequest);
+    thumb_done = da_new(ThumbRequest);
+    thumb_running = pthread_create(&thumb_thread, NULL, thumb_main, NULL) == 0;
+}
+
+void thumb_stop() {
+    if (thumb_queue == NULL) return;
+    if (thumb_running) {
+        pthread_mutex_lock(&thumb_lock);
+        thumb_quit = true;
+        pthread_cond_broadcast(&thumb_wake);
+        pthread_mutex_unlock(&thumb_lock);
+        pthread_join(thumb_thread, NULL);
+        thumb_running = false;
+    }
+    for (size_t i = 0; i < da_length(thumb_queue); i++) free(thumb_queue[i].data);
+    for (size_t i = 0; i < da_length(thumb_done); i++) free(thumb_done[i].pixels);
+    da_free(thumb_queue);
+    da_free(thumb_done);
+    thumb_queue = thumb_done = NULL;
+}
+
+// Keeps only the entries of requests of the given size
+void thumb_drop_sizes(ThumbRequest* requests, int size) {
+    size_t kept = 0;
+    for (size_t i = 0; i < da_length(requests); i++) {
+        if (requests[i].size == size) requests[kept++] = requests[i];
+        else { free(requests[i].data); free(requests[i].pixels); }
+    }
+    _da_set(requests, DA_LENGTH, kept);
+}
+
+// Does nothing if the thumbnail is already queued, being made or waiting to be taken
+void thumb_request(const unsigned char* data, uint32_t data_size, uint64_t hash, int size) {
+    if (!thumb_running || data == NULL || size <= 0) return;
+    pthread_mutex_lock(&thumb_lock);
+    bool known = thumb_busy.data != NULL && thumb_busy.hash == hash && thumb_busy.size == size;
+    for (size_t i = 0; !known && i < da_length(thumb_queue); i++) known = thumb_queue[i].hash == hash && thumb_queue[i].size == size;
+    for (size_t i = 0; !known && i < da_length(thumb_done); i++) known = thumb_done[i].hash == hash && thumb_done[i].size == size;
+    if (!known) {
+        if (size != thumb_size) {
+            thumb_drop_sizes(thumb_queue, size);
+            thumb_drop_sizes(thumb_done, size);
+            thumb_size = size;
+        }
+        ThumbRequest request = {.data = malloc(data_size), .data_size = data_size, .hash = hash, .size = size};
+        memcpy(request.data, data, data_size);
+        da_push(thumb_queue, request);
+        pthread_cond_signal(&thumb_wake);
+    }
+    pthread_mutex_unlock(&thumb_lock);
+}
+
+// True once the request is done, pixels is then NULL if the cover could not
+// be decoded and is otherwise the caller's to free
+bool thumb_take(uint64_t hash, int size, unsigned char** pixels) {
+    if (!thumb_running) return false;
+    bool found = false;
+    pthread_mutex_lock(&thumb_lock);
+    for (size_t i = 0; i < da_length(thumb_done); i++) {
+        if (thumb_done[i].hash != hash || thumb_done[i].size != size) continue;
+        *pixels = thumb_done[i].pixels;
+        thumb_done[i] = thumb_done[da_length(thumb_done)-1];
+        da_pop(thumb_done, NULL);
+        found = true;
+        break;
+    }
+    pthread_mutex_unlock(&thumb_lock);
+    return found;
+}
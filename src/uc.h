@@ -9,6 +9,8 @@
 #ifndef UC_H_
 #define UC_H_
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define UC_BYTE_ORDER_LITTLE 0
@@ -166,7 +168,7 @@ uint32_t uc_read_utf16_codepoint(char* src, char* read_bytes, char byteorder) {
 
 uint32_t uc_read_utf8_codepoint(char* src, char* read_bytes) {
     *read_bytes = 1;
-    if (src[0] < 0x7F) return (uint32_t) src[0];
+    if ((unsigned char) src[0] < 0x80) return (uint32_t) src[0];
     *read_bytes = 2;
     if ((src[0] & 0b11100000) == 0b11000000)
         return ((uint32_t) (src[0] & 0b11111) << 6) | ((uint32_t) (src[1] & 0b111111));
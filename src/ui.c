@@ -1,6 +1,29 @@
 
 Font font;
-Texture play, pause, back, forward, repeat, repeat_one, tdelete, go_back;
+Shader sdf_shader;
+float ui_scale = 1;
+
+// The atlas holds distance fields (see bake.c): 0.5 is the outline, and the
+// screen space derivative keeps the antialiased edge one pixel wide at any scale.
+// It stays bound for the whole frame, so it has to draw everything else too:
+// the atlas is uploaded with a zero alpha channel, any other texel (shapes use
+// raylib's white one, covers are opaque) is drawn as the default shader would
+#define SDF_SHADER \
+    "#version 330\n" \
+    "in vec2 fragTexCoord;\n" \
+    "in vec4 fragColor;\n" \
+    "uniform sampler2D texture0;\n" \
+    "uniform vec4 colDiffuse;\n" \
+    "out vec4 finalColor;\n" \
+    "void main() {\n" \
+    "    vec4 texel = texture(texture0, fragTexCoord);\n" \
+    "    float dist = texel.r - 0.5;\n" \
+    "    float width = length(vec2(dFdx(dist), dFdy(dist)));\n" \
+    "    float alpha = smoothstep(-width, width, dist);\n" \
+    "    vec4 sdf = vec4(fragColor.rgb, fragColor.a*alpha);\n" \
+    "    finalColor = (texel.a > 0.0 ? texel*fragColor : sdf)*colDiffuse;\n" \
+    "}\n"
+Rectangle play, tpause, back, forward, repeat, repeat_one, tdelete, go_back; // icons in the font atlas
 float font_spacing = 0;
 int cursor = MOUSE_CURSOR_ARROW;
 
@@ -10,11 +33,22 @@ Rectangle draw_stack[100] = {0};
 size_t draw_stack_size = 0;
 
 bool seeking_music = false;
+bool ui_show_audio_stats = false; // Ctrl+I, the latency profile and its counters in the menu bar
 
 int main_tab = 0;
 
 int album_selected = -1;
 
+// Album edit form, album_editing is the index of the album it belongs to
+int album_editing = -1;
+int album_edit_focus = -1; // field receiving the keyboard, -1 for none
+char album_edit_fields[3][256] = {0}; // album artist, genres, year
+unsigned char* album_edit_cover = NULL;
+uint32_t album_edit_cover_size = 0;
+Texture album_edit_cover_texture = {0};
+
+Texture album_cover_view = {0}; // full size cover of the selected album, while it is open
+
 float scroll_factor = 0;
 
 float clamp(float x, float a, float b) {
@@ -23,6 +57,12 @@ float clamp(float x, float a, float b) {
     return x;
 }
 
+// Everything is laid out in font_size units, so this is all a zoom takes
+void ui_set_scale(float scale) {
+    ui_scale = clamp(scale, 0.5f, 4.f);
+    font_size = roundf(UI_FONT_SIZE*ui_scale);
+}
+
 Rectangle get_draw_box() {
     Rectangle draw_box = {.x = 0, .y = 0, .width = GetScreenWidth(), .height = GetScreenHeight()};
     for (size_t i = 0; i < draw_stack_size; i++) {
@@ -34,16 +74,100 @@ Rectangle get_draw_box() {
     return draw_box;
 }
 
+// Everything is clipped on the CPU against the top of this stack instead of
+// using BeginScissorMode, which flushes the whole render batch every time.
+// draw_box() pushes the new box intersected with its parents.
+Rectangle clip_stack[100] = {0};
+size_t clip_stack_size = 0;
+
+Rectangle rect_intersect(Rectangle a, Rectangle b) {
+    float x1 = fmaxf(a.x, b.x), y1 = fmaxf(a.y, b.y);
+    float x2 = fminf(a.x + a.width, b.x + b.width), y2 = fminf(a.y + a.height, b.y + b.height);
+    return (Rectangle) {x1, y1, fmaxf(x2 - x1, 0), fmaxf(y2 - y1, 0)};
+}
+
+Rectangle get_clip() {
+    if (clip_stack_size == 0) return (Rectangle) {0, 0, GetScreenWidth(), GetScreenHeight()};
+    return clip_stack[clip_stack_size - 1];
+}
+
+void push_clip(Rectangle rect) {
+    clip_stack[clip_stack_size] = rect_intersect(get_clip(), rect);
+    clip_stack_size++;
+}
+
+void pop_clip() {
+    clip_stack_size--;
+}
+
 void draw_box(Rectangle rect) {
     draw_stack[draw_stack_size++] = rect;
+    push_clip(get_draw_box());
 }
 
 void drop_draw_box() {
     draw_stack_size--;
+    pop_clip();
+}
+
+// Draws the part of SRC inside the clip rect, DEST is in screen coordinates
+void draw_texture_clipped(Texture texture, Rectangle src, Rectangle dest, Color tint) {
+    Rectangle clip = get_clip();
+    Rectangle visible = rect_intersect(dest, clip);
+    if (visible.width <= 0 || visible.height <= 0) return;
+    float sx = src.width/dest.width, sy = src.height/dest.height;
+    src.x += (visible.x - dest.x)*sx;
+    src.y += (visible.y - dest.y)*sy;
+    src.width = visible.width*sx;
+    src.height = visible.height*sy;
+    DrawTexturePro(texture, src, visible, (Vector2) {0, 0}, 0, tint);
+}
+
+// Covers are square, whatever the size of their texture
+void draw_cover_at(Texture texture, float x, float y) {
+    draw_texture_clipped(texture, (Rectangle) {0, 0, texture.width, texture.height}, (Rectangle) {x, y, font_size*6.f, font_size*6.f}, (Color) {0xff, 0xff, 0xff, 0xff});
+}
+
+void draw_rectangle_clipped(Rectangle rect, Color color) {
+    Rectangle visible = rect_intersect(rect, get_clip());
+    if (visible.width > 0 && visible.height > 0) DrawRectangleRec(visible, color);
+}
+
+// Horizontal gradients are linear, so cutting one only needs the colors at the new edges
+void draw_gradient_h_clipped(Rectangle rect, Color left, Color right) {
+    Rectangle visible = rect_intersect(rect, get_clip());
+    if (visible.width <= 0 || visible.height <= 0) return;
+    float t1 = (visible.x - rect.x)/rect.width, t2 = (visible.x + visible.width - rect.x)/rect.width;
+    DrawRectangleGradientH(visible.x, visible.y, visible.width, visible.height, ColorLerp(left, right, t1), ColorLerp(left, right, t2));
+}
+
+// Same as DrawTextEx, but every glyph quad is cut to the clip rect
+void draw_text_clipped(char* text, Vector2 pos, Color color) {
+    Rectangle clip = get_clip();
+    if (pos.y >= clip.y + clip.height || pos.y + font_size <= clip.y) return;
+
+    float scale = (float) font_size/font.baseSize;
+    float padding = font.glyphPadding;
+    float x = 0, y = 0;
+    for (int i = 0; text[i] != 0;) {
+        int bytes = 0;
+        int codepoint = GetCodepointNext(&text[i], &bytes);
+        int index = GetGlyphIndex(font, codepoint);
+        i += bytes;
+        if (codepoint == '\n') { y += font_size + 2; x = 0; continue; } // 2 is raylib's default line spacing
+        if (pos.x + x >= clip.x + clip.width) continue; // the rest of the line is cut off
+        if (codepoint != ' ' && codepoint != '\t') {
+            Rectangle rec = font.recs[index];
+            Rectangle dest = {pos.x + x + (font.glyphs[index].offsetX - padding)*scale, pos.y + y + (font.glyphs[index].offsetY - padding)*scale, (rec.width + 2*padding)*scale, (rec.height + 2*padding)*scale};
+            Rectangle src = {rec.x - padding, rec.y - padding, rec.width + 2*padding, rec.height + 2*padding};
+            draw_texture_clipped(font.texture, src, dest, color);
+        }
+        x += (font.glyphs[index].advanceX == 0 ? font.recs[index].width : font.glyphs[index].advanceX)*scale + font_spacing;
+    }
 }
 
 void clear_box(Color color) {
-    DrawRectangleRec(get_draw_box(), color);
+    draw_rectangle_clipped(get_draw_box(), color);
 }
 
 int measure_text(char* text) {
@@ -52,18 +176,16 @@ int measure_text(char* text) {
 
 int draw_text_box_anchor_sized(char* text, int max_size, Vector2 pos, Color color, Color bg_color, Vector2 anchor) {
     Rectangle draw_box = get_draw_box();
-    if (pos.x - measure_text(text)*anchor.x > draw_box.width) return measure_text(text);
-    
-    BeginScissorMode(draw_box.x, draw_box.y, draw_box.width, draw_box.height);
+    int text_size = measure_text(text);
+    if (pos.x - text_size*anchor.x > draw_box.width) return text_size;
 
-    int text_size = MeasureTextEx(font, text, font_size, font_spacing).x;
-    if (max_size) BeginScissorMode(draw_box.x + pos.x - text_size*anchor.x, draw_box.y + pos.y - font_size*anchor.y, max_size, font_size);
-    DrawTextEx(font, text, (Vector2) {draw_box.x + pos.x - text_size*anchor.x, draw_box.y + pos.y - font_size*anchor.y}, font_size, font_spacing, color);
+    Vector2 text_pos = {draw_box.x + pos.x - text_size*anchor.x, draw_box.y + pos.y - font_size*anchor.y};
+    if (max_size) push_clip((Rectangle) {text_pos.x, text_pos.y, max_size, font_size});
+    draw_text_clipped(text, text_pos, color);
+    if (max_size) pop_clip();
     if (max_size && text_size > max_size) {
-        EndScissorMode(); DrawRectangleGradientH(draw_box.x + pos.x - text_size*anchor.x + max_size - font_size, draw_box.y + pos.y - font_size*anchor.y, font_size, font_size, (Color) {bg_color.r, bg_color.g, bg_color.b, 0}, bg_color);
+        draw_gradient_h_clipped((Rectangle) {text_pos.x + max_size - font_size, text_pos.y, font_size, font_size}, (Color) {bg_color.r, bg_color.g, bg_color.b, 0}, bg_color);
     }
-    
-    EndScissorMode();
 
     return text_size;
 }
@@ -76,7 +198,7 @@ int draw_text_box(char* text, Vector2 pos, Color color) {
     return draw_text_box_anchor(text, pos, color, (Vector2) {0.5, 0.5});
 }
 
-bool draw_button_bg(Rectangle rect, Texture texture, Color color, Color bg_col, Color hov_col, bool active) {
+bool draw_button_bg(Rectangle rect, Rectangle icon, Color color, Color bg_col, Color hov_col, bool active) {
     draw_box(rect);
 
     Rectangle draw_box = get_draw_box();
@@ -90,31 +212,40 @@ bool draw_button_bg(Rectangle rect, Texture texture, Color color, Color bg_col,
     Color fg = is_hovered && active && mouse_pressed ? bg_col : color;
     
     clear_box(bg);
-    DrawTexture(texture, draw_box.x, draw_box.y, fg);
+    draw_texture_clipped(font.texture, icon, (Rectangle) {draw_box.x, draw_box.y, font_size, font_size}, fg);
 
     drop_draw_box();
 
     return is_hovered && IsMouseButtonPressed(0) && active;
 }
 
-bool draw_button(Rectangle rect, Texture texture, Color color) {
-    return draw_button_bg(rect, texture, color, theme.mg_off, theme.mg_on, music_loaded);
+bool draw_button(Rectangle rect, Rectangle icon, Color color) {
+    return draw_button_bg(rect, icon, color, theme.mg_off, theme.mg_on, music_loaded);
 }
 
 void draw_rectangle_box(Rectangle rect, Color color) {
     Rectangle draw_box = get_draw_box();
-
-    BeginScissorMode(draw_box.x, draw_box.y, draw_box.width, draw_box.height);
-    DrawRectangle(rect.x + draw_box.x, rect.y + draw_box.y, rect.width, rect.height, color);
-    EndScissorMode();
+    draw_rectangle_clipped((Rectangle) {rect.x + draw_box.x, rect.y + draw_box.y, rect.width, rect.height}, color);
 }
 
 void draw_circle_box(Vector2 pos, float radius, Color color) {
     Rectangle draw_box = get_draw_box();
-
-    BeginScissorMode(draw_box.x, draw_box.y, draw_box.width, draw_box.height);
-    DrawCircle(pos.x + draw_box.x, pos.y + draw_box.y, radius, color);
-    EndScissorMode();
+    Rectangle clip = get_clip();
+    Vector2 center = {pos.x + draw_box.x, pos.y + draw_box.y};
+    Rectangle bounds = {center.x - radius, center.y - radius, radius*2, radius*2};
+    Rectangle visible = rect_intersect(bounds, clip);
+    if (visible.width <= 0 || visible.height <= 0) return;
+    if (visible.width == bounds.width && visible.height == bounds.height) {
+        DrawCircleV(center, radius, color);
+        return;
+    }
+    // Partly cut off: fill it one pixel row at a time
+    for (float y = floorf(bounds.y); y < bounds.y + bounds.height; y++) {
+        float dy = y + 0.5f - center.y;
+        if (dy*dy >= radius*radius) continue;
+        float half = sqrtf(radius*radius - dy*dy);
+        draw_rectangle_clipped((Rectangle) {center.x - half, y, half*2, 1}, color);
+    }
 }
 
 int draw_volume_scrollbox() {
@@ -135,15 +266,6 @@ int draw_volume_scrollbox() {
     return margin/2 + w;
 }
 
-void begin_drawbox_scissor_mode() {
-    Rectangle draw_box = get_draw_box();
-    BeginScissorMode(draw_box.x, draw_box.y, draw_box.width, draw_box.height);
-}
-
-void end_drawbox_scissor_mode() {
-    EndScissorMode();
-}
-
 void draw_menu_bar() {
     clear_box(theme.mg_off);
 
@@ -158,6 +280,13 @@ void draw_menu_bar() {
 
     int x2 = draw_volume_scrollbox();
 
+    if (ui_show_audio_stats && music_profile != -1) {
+        AudioStats stats = music_profile_stats(music_profile);
+        double period = stats.callbacks ? stats.interval*1000/stats.callbacks : 0;
+        char* text = (char*) TextFormat("%s: %.1f ms, %u refills, %u underruns", music_profiles[music_profile].name, period, stats.refills, stats.underruns);
+        x2 += draw_text_box_anchor(text, (Vector2) {drawbox.width - x2 - margin/2, margin}, theme.fg_off, (Vector2) {1, 0.5}) + margin/2;
+    }
+
     draw_box((Rectangle) {margin*1.5f + w1, 0, drawbox.width - w1 - x2 - margin*2.5f, drawbox.height});
 
     drawbox = get_draw_box();
@@ -177,6 +306,66 @@ void draw_menu_bar() {
     drop_draw_box();
 }
 
+void waveform_quad(float x, float top, float bottom, Color color) {
+    rlColor4ub(color.r, color.g, color.b, color.a);
+    rlVertex2f(x, top);
+    rlVertex2f(x, bottom);
+    rlVertex2f(x + 1, bottom);
+    rlVertex2f(x + 1, top);
+}
+
+// The whole overview goes out as one run of quads in the shapes batch, a peak
+// and an RMS bar for every pixel column, brighter left of the play position
+void draw_waveform(unsigned char* wave, Rectangle rect, float position) {
+    Rectangle draw_box = get_draw_box(), clip = get_clip();
+    int columns = rect.width;
+    if (columns <= 0) return;
+    Texture shapes = GetShapesTexture();
+    Rectangle source = GetShapesTextureRectangle();
+    float mid = draw_box.y + rect.y + rect.height/2, half = rect.height/2;
+    Color peak_colors[2] = {theme.mg_on, theme.fg_off};
+    Color rms_colors[2] = {ColorLerp(theme.mg_on, theme.fg_off, 0.4f), theme.fg};
+
+    rlSetTexture(shapes.id);
+    rlBegin(RL_QUADS);
+    rlNormal3f(0.0f, 0.0f, 1.0f);
+    rlTexCoord2f((source.x + source.width/2)/shapes.width, (source.y + source.height/2)/shapes.height);
+    for (int i = 0; i < columns; i++) {
+        float x = draw_box.x + rect.x + i;
+        if (x < clip.x || x + 1 > clip.x + clip.width) continue;
+        size_t first = (size_t) i*WAVE_BUCKETS/columns, last = (size_t) (i + 1)*WAVE_BUCKETS/columns;
+        if (last <= first) last = first + 1;
+        int peak = 0, rms = 0;
+        for (size_t b = first; b < last; b++) {
+            if (wave[b*2] > peak) peak = wave[b*2];
+            if (wave[b*2 + 1] > rms) rms = wave[b*2 + 1];
+        }
+        bool played = i < position*columns;
+        float peak_height = fmaxf(half*peak/255.f, 0.5f), rms_height = half*rms/255.f;
+        waveform_quad(x, mid - peak_height, mid + peak_height, peak_colors[played]);
+        if (rms_height >= 0.5f) waveform_quad(x, mid - rms_height, mid + rms_height, rms_colors[played]);
+    }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+// The bands along rect, then a gap and the level of each channel
+void draw_spectrum(const Spectrum* spectrum, Rectangle rect) {
+    float step = rect.width/(SPECTRUM_BANDS + 3);
+    float bottom = rect.y + rect.height;
+    draw_rectangle_box((Rectangle) {rect.x, bottom - 1, step*SPECTRUM_BANDS, 1}, theme.mg_on);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+        float height = rect.height*spectrum->bands[b];
+        if (height >= 1) draw_rectangle_box((Rectangle) {rect.x + step*b, bottom - height, step*0.75f, height}, theme.fg_off);
+    }
+    for (int c = 0; c < 2; c++) {
+        float x = rect.x + step*(SPECTRUM_BANDS + 1 + c);
+        draw_rectangle_box((Rectangle) {x, rect.y, step*0.75f, rect.height}, theme.mg_on);
+        float height = rect.height*spectrum->levels[c];
+        if (height >= 1) draw_rectangle_box((Rectangle) {x, bottom - height, step*0.75f, height}, theme.fg);
+    }
+}
+
 void draw_status_bar() {
     clear_box(theme.mg_off);
 
@@ -184,14 +373,22 @@ void draw_status_bar() {
     int margin_x = font_size/2;
     int margin_y = margin_x;
 
+    // Ctrl+S, the spectrum takes the right end of the title line
+    int spectrum_size = 0;
+    if (music_spectrum) {
+        spectrum_size = font_size*6 + margin_x;
+        draw_spectrum(spectrum_get(GetAudioDeviceSampleRate()), (Rectangle) {draw_box.width - font_size*6 - margin_x, margin_y, font_size*6, font_size});
+    }
+    int text_width = draw_box.x + draw_box.width - margin_x*2 - spectrum_size;
+
     if (!music_loaded) {
-        draw_text_box_anchor_sized("no music playing", draw_box.x + draw_box.width - margin_x*2, (Vector2) {margin_x, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
+        draw_text_box_anchor_sized("no music playing", text_width, (Vector2) {margin_x, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
     } else if (tag == NULL || *(music_get_artist()) == 0) {
-        draw_text_box_anchor_sized(playlist[playlist_position], draw_box.x + draw_box.width - margin_x*2, (Vector2) {margin_x, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
+        draw_text_box_anchor_sized(playlist[playlist_position], text_width, (Vector2) {margin_x, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
     } else {
-        int artist_size = draw_text_box_anchor_sized((char*) TextFormat("%s - ", music_get_artist()), draw_box.x + draw_box.width - margin_x*2, (Vector2) {margin_x, margin_y}, theme.fg_off, theme.mg_off, (Vector2) {0, 0});
-        int title_size = draw_text_box_anchor_sized(music_get_name(), draw_box.x + draw_box.width - margin_x*2 - artist_size, (Vector2) {margin_x + artist_size, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
-        if (draw_box.width - margin_x - measure_text(music_get_album()) > margin_x*2 + artist_size + title_size) draw_text_box_anchor(music_get_album(), (Vector2) {draw_box.width - margin_x, margin_y}, theme.fg, (Vector2) {1, 0});
+        int artist_size = draw_text_box_anchor_sized((char*) TextFormat("%s - ", music_get_artist()), text_width, (Vector2) {margin_x, margin_y}, theme.fg_off, theme.mg_off, (Vector2) {0, 0});
+        int title_size = draw_text_box_anchor_sized(music_get_name(), text_width - artist_size, (Vector2) {margin_x + artist_size, margin_y}, theme.fg, theme.mg_off, (Vector2) {0, 0});
+        if (draw_box.width - margin_x - spectrum_size - measure_text(music_get_album()) > margin_x*2 + artist_size + title_size) draw_text_box_anchor(music_get_album(), (Vector2) {draw_box.width - margin_x - spectrum_size, margin_y}, theme.fg, (Vector2) {1, 0});
     }
 
     margin_y = draw_box.height - font_size/2;
@@ -210,7 +407,7 @@ void draw_status_bar() {
 
     if (draw_button((Rectangle) {draw_box.width - margin_x - font_size*4.f, margin_y - font_size, font_size, font_size}, back, music_loaded ? theme.fg : theme.fg_off) && music_loaded)
         music_playlist_previous();
-    if (draw_button((Rectangle) {draw_box.width - margin_x - font_size*3.f, margin_y - font_size, font_size, font_size}, music_playing ? pause : play, music_loaded ? theme.fg : theme.fg_off) && music_loaded)
+    if (draw_button((Rectangle) {draw_box.width - margin_x - font_size*3.f, margin_y - font_size, font_size, font_size}, music_playing ? tpause : play, music_loaded ? theme.fg : theme.fg_off) && music_loaded)
         music_play_pause();
     if (draw_button((Rectangle) {draw_box.width - margin_x - font_size*2.f, margin_y - font_size, font_size, font_size}, forward, music_loaded ? theme.fg : theme.fg_off) && music_loaded)
         music_playlist_next();
@@ -239,8 +436,13 @@ void draw_status_bar() {
     if (seeking_music)
         music_seek_temp = (clamp((GetMouseX() - bar_start)/bar_width, 0.001f, 0.999f)*music_full);
 
-    draw_rectangle_box((Rectangle) {bar_start, bar_y - bar_height/2, bar_width, bar_height}, theme.mg_on);
-    if (music_loaded) draw_rectangle_box((Rectangle) {bar_start, bar_y - bar_height/2, bar_width*play_bar_pos, bar_height}, theme.fg);
+    unsigned char* wave = music_loaded ? wave_overview(playlist[playlist_position]) : NULL;
+    if (wave != NULL) {
+        draw_waveform(wave, (Rectangle) {bar_start, bar_y - font_size/2, bar_width, font_size}, play_bar_pos);
+    } else {
+        draw_rectangle_box((Rectangle) {bar_start, bar_y - bar_height/2, bar_width, bar_height}, theme.mg_on);
+        if (music_loaded) draw_rectangle_box((Rectangle) {bar_start, bar_y - bar_height/2, bar_width*play_bar_pos, bar_height}, theme.fg);
+    }
     if (music_loaded) draw_circle_box((Vector2) {bar_start + bar_width*play_bar_pos, bar_y}, bar_hovered ? font_size/4 : font_size/6, theme.fg);
 
     if (music_loaded && seeking_music) {
@@ -258,6 +460,66 @@ bool is_mouse_in_rect_drawbox(Rectangle r) { Rectangle d = get_draw_box(); retur
 
 bool is_mouse_in_rect(Rectangle d) { return GetMouseX() >= d.x && GetMouseX() < d.x + d.width && GetMouseY() >= d.y && GetMouseY() < d.y + d.height; }
 
+// Same as draw_button_bg, with a label instead of an icon. rect.width is ignored, returns the width used in *width
+bool draw_text_button(Rectangle rect, char* text, bool active, int* width) {
+    rect.width = measure_text(text) + font_size/2;
+    *width = rect.width;
+    draw_box(rect);
+
+    bool is_hovered = is_mouse_in_rect(get_draw_box());
+    if (is_hovered && active) cursor = MOUSE_CURSOR_POINTING_HAND;
+    bool mouse_pressed = IsMouseButtonDown(0);
+
+    clear_box(is_hovered && active ? mouse_pressed ? theme.fg : theme.mg_on : theme.mg_off);
+    draw_text_box_anchor_sized(text, 0, (Vector2) {font_size/4, 0}, !active ? theme.mg_on : is_hovered && mouse_pressed ? theme.mg_off : theme.fg, theme.mg_off, (Vector2) {0, 0});
+
+    drop_draw_box();
+
+    return is_hovered && IsMouseButtonPressed(0) && active;
+}
+
+// Single line text field bound to album_edit_fields[field], clicking it takes the keyboard
+void draw_text_input(Rectangle rect, int field, char* placeholder, bool digits) {
+    char* text = album_edit_fields[field];
+    size_t size = sizeof(album_edit_fields[field]);
+    draw_box(rect);
+
+    bool hovered = is_mouse_in_rect(get_draw_box());
+    if (hovered) cursor = MOUSE_CURSOR_IBEAM;
+    if (IsMouseButtonPressed(0)) {
+        if (hovered) album_edit_focus = field;
+        else if (album_edit_focus == field) album_edit_focus = -1;
+    }
+    bool focused = album_edit_focus == field;
+
+    if (focused) {
+        int codepoint;
+        while ((codepoint = GetCharPressed()) != 0) {
+            if (digits && (codepoint < '0' || codepoint > '9')) continue;
+            int bytes = 0;
+            const char* utf8 = CodepointToUTF8(codepoint, &bytes);
+            size_t length = strlen(text);
+            if (length + bytes >= size) continue;
+            memcpy(text + length, utf8, bytes);
+            text[length + bytes] = 0;
+        }
+        if (IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) {
+            size_t length = strlen(text);
+            while (length > 0 && (text[length-1] & 0xC0) == 0x80) length--; // continuation bytes
+            if (length > 0) length--;
+            text[length] = 0;
+        }
+    }
+
+    clear_box(focused ? theme.mg_off : theme.bg);
+    draw_rectangle_box((Rectangle) {0, rect.height - 2, rect.width, 2}, focused ? theme.fg_off : theme.mg_off);
+    int w = draw_text_box_anchor_sized(*text == 0 ? placeholder : text, rect.width - font_size/2, (Vector2) {font_size/4, 0}, *text == 0 ? theme.mg_on : theme.fg, focused ? theme.mg_off : theme.bg, (Vector2) {0, 0});
+    if (focused && *text != 0 && w < rect.width - font_size/2) draw_rectangle_box((Rectangle) {font_size/4 + w + 1, font_size/8, 2, font_size*0.75f}, theme.fg);
+    else if (focused && *text == 0) draw_rectangle_box((Rectangle) {font_size/4, font_size/8, 2, font_size*0.75f}, theme.fg);
+
+    drop_draw_box();
+}
+
 int playlist_scroll = 0;
 
 void draw_playlist() {
@@ -295,6 +557,84 @@ void draw_playlist() {
     }
 }
 
+// A fully transparent texel reads as a distance field in SDF_SHADER, black
+// keeps it below the outline and so still invisible
+void cover_clear_transparent(unsigned char* pixels, int width, int height) {
+    for (int i = 0; i < width*height; i++) {
+        if (pixels[i*4 + 3] == 0) pixels[i*4] = pixels[i*4 + 1] = pixels[i*4 + 2] = 0;
+    }
+}
+
+#define COVER_UPLOADS_PER_FRAME 4
+int cover_uploads = 0; // this frame, reset by the main loop
+
+// Decodes at the smallest scale still covering min_size, see cover_decode
+Image album_decode_cover(unsigned char* data, uint32_t size, int min_size) {
+    int width = 0, height = 0;
+    unsigned char* pixels = data == NULL ? NULL : cover_decode(data, size, min_size, &width, &height);
+    if (pixels == NULL) return (Image) {0};
+    cover_clear_transparent(pixels, width, height);
+    return (Image) {pixels, width, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+}
+
+void cover_unload_texture(Cover* cover) {
+    if (cover->texture.id != 0) UnloadTexture(cover->texture);
+    cover->texture = (Texture) {0};
+}
+
+// Covers are kept compressed in the library, cards fetch their thumbnail once
+// they are drawn. Slot 0 ends up holding the placeholder of every album without one.
+// Thumbnails come in power of two sizes with mipmaps, so shrinking the UI draws
+// from a smaller level and only growing past the loaded size fetches a new one.
+// They are made by the thumbnail thread: until one arrives the card keeps the
+// smaller one it had, or the placeholder, and only a few are uploaded per frame
+Texture cover_texture(size_t id) {
+    Cover* cover = &covers[id];
+    int size = 64;
+    while (size < font_size*6) size *= 2;
+    if (cover->texture.id != 0 && cover->texture.width >= size) return cover->texture;
+    unsigned char* pixels = NULL;
+    if (cover->data != NULL) {
+        if (cover_uploads >= COVER_UPLOADS_PER_FRAME || !thumb_take(cover->hash, size, &pixels)) {
+            thumb_request(cover->data, cover->size, cover->hash, size);
+            return cover->texture.id != 0 ? cover->texture : cover_texture(0);
+        }
+        cover_uploads++;
+    }
+    cover_unload_texture(cover);
+    Image image = {pixels, size, size, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+    if (pixels == NULL) image = GenImageColor(size, size, theme.mg_off);
+    else cover_clear_transparent(pixels, size, size);
+    cover->texture = LoadTextureFromImage(image);
+    GenTextureMipmaps(&cover->texture);
+    SetTextureFilter(cover->texture, TEXTURE_FILTER_TRILINEAR);
+    UnloadImage(image);
+    return cover->texture;
+}
+
+// Only as big as the draw box needs, so the full resolution is decoded for big windows alone
+void album_cover_view_open(Album* album) {
+    Rectangle draw_box = get_draw_box();
+    Image cover = album_decode_cover(covers[album->cover].data, covers[album->cover].size, fmaxf(draw_box.width, draw_box.height));
+    if (cover.data == NULL) return;
+    album_cover_view = LoadTextureFromImage(cover);
+    UnloadImage(cover);
+}
+
+void album_cover_view_close() {
+    if (album_cover_view.id != 0) UnloadTexture(album_cover_view);
+    album_cover_view = (Texture) {0};
+}
+
+void draw_album_cover_view() {
+    Rectangle draw_box = get_draw_box();
+    float scale = fminf((draw_box.width - font_size)/album_cover_view.width, (draw_box.height - font_size)/album_cover_view.height);
+    Rectangle dest = {draw_box.x + (draw_box.width - album_cover_view.width*scale)/2, draw_box.y + (draw_box.height - album_cover_view.height*scale)/2, album_cover_view.width*scale, album_cover_view.height*scale};
+    draw_texture_clipped(album_cover_view, (Rectangle) {0, 0, album_cover_view.width, album_cover_view.height}, dest, (Color) {0xff, 0xff, 0xff, 0xff});
+    if (is_mouse_in_drawbox()) cursor = MOUSE_CURSOR_POINTING_HAND;
+    if ((is_mouse_in_drawbox() && IsMouseButtonPressed(0)) || IsKeyPressed(KEY_ESCAPE)) album_cover_view_close();
+}
+
 void draw_album_card(int album_indice, Rectangle original_drawbox) {
     Rectangle draw_box = get_draw_box();
     clear_box(theme.bg);
@@ -305,7 +645,7 @@ void draw_album_card(int album_indice, Rectangle original_drawbox) {
         cursor = MOUSE_CURSOR_POINTING_HAND;
     }
     if (hovered && IsMouseButtonPressed(0)) album_selected = album_indice;
-    DrawTexture(album.cover, draw_box.x + font_size/4, draw_box.y + font_size/4, (Color) {0xff, 0xff, 0xff, 255});
+    draw_cover_at(cover_texture(album.cover), draw_box.x + font_size/4, draw_box.y + font_size/4);
     draw_text_box_anchor_sized(album.name, draw_box.width-font_size/2, (Vector2) {font_size/4, font_size*6.75f}, theme.fg, hovered ? theme.mg_off : theme.bg, (Vector2) {0, 0});
     if (album.year == 0)
         draw_text_box_anchor_sized((char*) TextFormat("%s", album.artists), draw_box.width-font_size/2, (Vector2) {font_size/4, font_size*7.75f}, hovered ? theme.fg_off : theme.mg_off, hovered ? theme.mg_off : theme.bg, (Vector2) {0, 0});
@@ -315,19 +655,121 @@ void draw_album_card(int album_indice, Rectangle original_drawbox) {
 
 int album_scroll = 0;
 
+void album_edit_end() {
+    free(album_edit_cover);
+    album_edit_cover = NULL;
+    album_edit_cover_size = 0;
+    if (album_edit_cover_texture.id != 0) UnloadTexture(album_edit_cover_texture);
+    album_edit_cover_texture = (Texture) {0};
+    album_editing = -1;
+    album_edit_focus = -1;
+}
+
+// Called before an album goes away, the ones after it move down one
+void album_removed(size_t index) {
+    if (album_editing == (int) index) album_edit_end();
+    else if (album_editing > (int) index) album_editing--;
+    if (album_selected == (int) index) {
+        album_selected = -1;
+        album_cover_view_close();
+    } else if (album_selected > (int) index) album_selected--;
+}
+
+void album_edit_begin(int index) {
+    album_edit_end();
+    Album album = albums[index];
+    snprintf(album_edit_fields[0], sizeof(album_edit_fields[0]), "%s", album.artists);
+    snprintf(album_edit_fields[1], sizeof(album_edit_fields[1]), "%s", album.genres);
+    if (album.year != 0) snprintf(album_edit_fields[2], sizeof(album_edit_fields[2]), "%d", album.year);
+    else album_edit_fields[2][0] = 0;
+    album_editing = index;
+}
+
+// Only PNG and JPEG, the tag has to name the format
+void album_edit_set_cover(char* path) {
+    int size = 0;
+    unsigned char* data = LoadFileData(path, &size);
+    if (data == NULL) return;
+    bool png = size >= 4 && memcmp(data, "\x89PNG", 4) == 0;
+    bool jpg = size >= 3 && memcmp(data, "\xFF\xD8\xFF", 3) == 0;
+    Image cover = png || jpg ? album_decode_cover(data, size, font_size*6) : (Image) {0};
+    if (cover.data == NULL) { UnloadFileData(data); return; }
+    ImageResize(&cover, font_size*6.f, font_size*6.f);
+    if (album_edit_cover_texture.id != 0) UnloadTexture(album_edit_cover_texture);
+    album_edit_cover_texture = LoadTextureFromImage(cover);
+    UnloadImage(cover);
+
+    free(album_edit_cover);
+    album_edit_cover = malloc(size);
+    memcpy(album_edit_cover, data, size);
+    album_edit_cover_size = size;
+    UnloadFileData(data);
+}
+
+// Hands whatever changed over to the tag writers
+void album_edit_submit() {
+    Album album = albums[album_editing];
+    AlbumEdit edit = {0};
+    if (strcmp(album_edit_fields[0], album.artists) != 0) edit.artists = strdup(album_edit_fields[0]);
+    if (strcmp(album_edit_fields[1], album.genres) != 0) edit.genres = strdup(album_edit_fields[1]);
+    if (atoi(album_edit_fields[2]) != album.year) edit.year = atoi(album_edit_fields[2]);
+    edit.cover_data = album_edit_cover;
+    edit.cover_size = album_edit_cover_size;
+    album_edit_cover = NULL;
+    if (edit.artists != NULL || edit.genres != NULL || edit.year != 0 || edit.cover_data != NULL) edit_album(album_editing, edit);
+    album_edit_end();
+}
+
+void draw_album_edit_form() {
+    Rectangle draw_box = get_draw_box();
+    float width = draw_box.width - font_size*7.5f;
+    draw_text_input((Rectangle) {font_size*7.f, font_size*1.5f + album_scroll, width, font_size}, 0, "album artist", false);
+    draw_text_input((Rectangle) {font_size*7.f, font_size*2.5f + album_scroll, width, font_size}, 1, "genres", false);
+    draw_text_input((Rectangle) {font_size*7.f, font_size*3.5f + album_scroll, font_size*4.f, font_size}, 2, "year", true);
+    draw_text_box_anchor_sized(album_edit_cover == NULL ? "drop an image here to change the cover" : "new cover", width, (Vector2) {font_size*7.f, font_size*4.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
+
+    int w = 0;
+    bool save = draw_text_button((Rectangle) {font_size*7.f, font_size*5.5f + album_scroll, 0, font_size}, "save", true, &w);
+    bool cancel = draw_text_button((Rectangle) {font_size*7.5f + w, font_size*5.5f + album_scroll, 0, font_size}, "cancel", true, &w);
+
+    if (IsKeyPressed(KEY_TAB)) album_edit_focus = (album_edit_focus + 1) % 3;
+    if (save || IsKeyPressed(KEY_ENTER)) album_edit_submit();
+    else if (cancel || IsKeyPressed(KEY_ESCAPE)) album_edit_end();
+}
+
 void draw_selected_album() {
     Rectangle draw_box = get_draw_box();
+    if (album_editing != -1 && album_editing != album_selected) album_edit_end();
+    if (album_cover_view.id != 0) {
+        draw_album_cover_view();
+        return;
+    }
     Album album = albums[album_selected];
+    bool editing = album_editing == album_selected;
 
     if (is_mouse_in_drawbox() && font_size*7.f + font_size*da_length(album.playlist) > draw_box.height)
         album_scroll = -clamp(-album_scroll - GetMouseWheelMove()*scroll_factor, 0.f, font_size*7.f + font_size*da_length(album.playlist) - draw_box.height + font_size/2);
     
-    DrawTexture(album.cover, draw_box.x + font_size/2, draw_box.y + font_size/2 + album_scroll, (Color) {0xff, 0xff, 0xff, 0xff});
+    draw_cover_at(editing && album_edit_cover_texture.id != 0 ? album_edit_cover_texture : cover_texture(album.cover), draw_box.x + font_size/2, draw_box.y + font_size/2 + album_scroll);
+    Rectangle cover_hitbox = {font_size/2, font_size/2 + album_scroll, font_size*6.f, font_size*6.f};
+    if (!editing && album.cover != 0 && is_mouse_in_drawbox() && is_mouse_in_rect_drawbox(cover_hitbox)) {
+        cursor = MOUSE_CURSOR_POINTING_HAND;
+        if (IsMouseButtonPressed(0)) album_cover_view_open(&albums[album_selected]);
+    }
     
     int w1 = draw_text_box_anchor_sized(album.name, draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*0.5f + album_scroll}, theme.fg, theme.bg, (Vector2) {0, 0});
-    draw_text_box_anchor_sized((char*) TextFormat(" (%d)", album.year), draw_box.width - font_size*7.5f - w1, (Vector2) {font_size*7.f + w1, font_size*0.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
-    draw_text_box_anchor_sized(album.artists, draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*1.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
-    draw_text_box_anchor_sized(album.genres, draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*2.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
+    if (!editing) {
+        draw_text_box_anchor_sized((char*) TextFormat(" (%d)", album.year), draw_box.width - font_size*7.5f - w1, (Vector2) {font_size*7.f + w1, font_size*0.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
+        draw_text_box_anchor_sized(album.artists, draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*1.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
+        draw_text_box_anchor_sized(album.genres, draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*2.5f + album_scroll}, theme.mg_off, theme.bg, (Vector2) {0, 0});
+    }
+
+    size_t done = 0, total = 0;
+    if (edit_album_progress(album.name, &done, &total)) {
+        draw_text_box_anchor_sized((char*) TextFormat("writing tags %zu/%zu", done, total), draw_box.width - font_size*7.5f, (Vector2) {font_size*7.f, font_size*3.5f + album_scroll}, theme.mg_on, theme.bg, (Vector2) {0, 0});
+        draw_rectangle_box((Rectangle) {font_size*7.f, font_size*4.75f + album_scroll, font_size*6.f, font_size/4}, theme.mg_off);
+        draw_rectangle_box((Rectangle) {font_size*7.f, font_size*4.75f + album_scroll, font_size*6.f*done/total, font_size/4}, theme.fg_off);
+    } else if (editing) draw_album_edit_form();
     for (size_t i = 0; i < da_length(album.playlist); i++) {
         char* path = album.playlist[i];
         Rectangle hitbox = {0, font_size*7.f + font_size*i + album_scroll, draw_box.width, font_size};
@@ -349,11 +791,36 @@ void draw_selected_album() {
         w = draw_text_box_anchor_sized(music_get_title_from_path(path), draw_box.width - font_size - w, (Vector2) {font_size/2 + w, font_size*7.f + font_size*i + album_scroll}, theme.fg, theme.bg, (Vector2) {0, 0})+w;
     }
 
-    if (draw_button_bg((Rectangle) {draw_box.width - font_size*1.5f, font_size*0.5f + album_scroll, font_size, font_size}, go_back, theme.fg, theme.bg, theme.mg_off, is_mouse_in_drawbox())) album_selected = -1;
+    if (draw_button_bg((Rectangle) {draw_box.width - font_size*1.5f, font_size*0.5f + album_scroll, font_size, font_size}, go_back, theme.fg, theme.bg, theme.mg_off, is_mouse_in_drawbox())) {
+        album_selected = -1;
+        album_edit_end();
+    }
+    // The tracks without an album have nothing to write
+    int w = measure_text("edit") + font_size/2;
+    if (album_selected > 0 && !editing && total == 0 && draw_text_button((Rectangle) {draw_box.width - font_size*2.f - w, font_size*0.5f + album_scroll, 0, font_size}, "edit", is_mouse_in_drawbox(), &w)) album_edit_begin(album_selected);
 }
 
 int album_cards_scroll = 0;
 
+typedef struct {
+    float width;
+    size_t count;
+    size_t columns, rows;
+    int font_size;
+} AlbumGrid;
+
+AlbumGrid album_grid = {0};
+
+void album_grid_update(float width) {
+    if (album_grid.width == width && album_grid.count == da_length(albums) && album_grid.font_size == font_size) return;
+    album_grid.width = width;
+    album_grid.font_size = font_size;
+    album_grid.count = da_length(albums);
+    album_grid.columns = width / (font_size*7.f);
+    if (album_grid.columns == 0) album_grid.columns = 1;
+    album_grid.rows = (album_grid.count + album_grid.columns - 1) / album_grid.columns;
+}
+
 void draw_albums() {
     Rectangle drawbox = get_draw_box();
     if (da_length(albums) == 1) {
@@ -361,17 +828,28 @@ void draw_albums() {
     }
     else {
         if (album_selected == -1) {
-            size_t row = 0, column = 0;
-            for (size_t i = 0; i < da_length(albums); i++) {
-                if (font_size*7.f*column + font_size*7.f > drawbox.width) { column = 0; row++; }
-                if (font_size/2 + font_size*10.f*row + album_cards_scroll + font_size*9.f < 0) { column++; continue; }
-                if (font_size/2 + font_size*10.f*row + album_cards_scroll > drawbox.height) break;
-                draw_box((Rectangle) {font_size/2 + font_size*7.f*column, font_size/2 + font_size*10.f*row + album_cards_scroll, font_size*6.5f,font_size*9.f});
+            album_grid_update(drawbox.width);
+            float row_height = font_size*10.f;
+            float content_height = row_height*(album_grid.rows - 1) + font_size*9.5f;
+            if (is_mouse_in_drawbox() && content_height > drawbox.height) album_cards_scroll = -clamp(-album_cards_scroll - GetMouseWheelMove()*scroll_factor, 0.f, content_height - drawbox.height);
+            if (content_height <= drawbox.height) album_cards_scroll = 0;
+
+            // Rows are row_height apart starting at font_size/2, each card is font_size*9 tall
+            int first_row = ceilf((-album_cards_scroll - font_size*9.5f)/row_height);
+            int last_row = floorf((drawbox.height - album_cards_scroll - font_size/2)/row_height);
+            if (first_row < 0) first_row = 0;
+            if (last_row >= (int) album_grid.rows) last_row = album_grid.rows - 1;
+
+            size_t first = first_row*album_grid.columns;
+            size_t last = (last_row + 1)*album_grid.columns;
+            if (last > da_length(albums)) last = da_length(albums);
+
+            for (size_t i = first; i < last; i++) {
+                size_t row = i / album_grid.columns, column = i % album_grid.columns;
+                draw_box((Rectangle) {font_size/2 + font_size*7.f*column, font_size/2 + row_height*row + album_cards_scroll, font_size*6.5f, font_size*9.f});
                 draw_album_card(i, drawbox);
                 drop_draw_box();
-                column++;
             }
-            if (is_mouse_in_drawbox() && font_size*10.f*row + font_size*9.5f > drawbox.height) album_cards_scroll = -clamp(-album_cards_scroll - GetMouseWheelMove()*scroll_factor, 0.f, font_size*10.f*row + font_size*9.5f - drawbox.height);
         } else {
             draw_selected_album();
         }
@@ -390,11 +868,14 @@ void draw_main_ui() {
             FilePathList files = LoadDroppedFiles();
             for (size_t i = 0; i < files.count; i++) {
                 if (DirectoryExists(get_path(files.paths[i]))) music_scan(files.paths[i]);
+                else if (album_editing != -1 && album_editing == album_selected) album_edit_set_cover(get_path(files.paths[i]));
             }
             UnloadDroppedFiles(files);
         }
     }
         
+    if (main_tab != 1 || album_selected == -1) album_edit_focus = -1; // the form is not on screen
+
     Rectangle draw_box = get_draw_box();
     if (main_tab == 0) draw_playlist();
     else if (main_tab == 1) draw_albums();
@@ -0,0 +1,386 @@
+// Live library watching.
+// A background thread keeps its own snapshot of every file under the library
+// roots and reports the paths that changed. On Linux changes come from
+// inotify, everywhere else (or when inotify runs out of watches) the roots
+// are walked every WATCH_POLL_INTERVAL seconds. Reported paths are coalesced
+// until they settle and then handed to the main thread, which feeds them to
+// library_update_file a few at a time so the render loop never stalls.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "library.h"
+
+#define WATCH_POLL_INTERVAL 10.0 // seconds between walks in polling mode
+#define WATCH_SETTLE_TIME 0.5    // a path must be quiet this long before it is applied
+#define WATCH_FRAME_BUDGET 0.004 // seconds per frame spent applying changes
+
+typedef struct {
+    char* path;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint32_t generation;
+} WatchFile;
+
+typedef struct {
+    char* path;
+    double time;
+} WatchPending;
+
+typedef struct {
+    int wd;
+    char* path;
+} WatchDir;
+
+pthread_t watch_thread;
+pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+bool watch_running = false;
+
+// Shared between threads, guarded by watch_lock
+bool watch_quit = false;
+char** watch_roots_new = 0;
+char** watch_ready = 0;
+
+// Owned by the watcher thread
+char** watch_roots = 0;
+WatchFile* watch_files = 0;
+Ht watch_files_index;
+uint32_t watch_generation = 0;
+WatchPending* watch_pending = 0;
+Ht watch_pending_index;
+bool watch_polling = true;
+int watch_inotify = -1;
+WatchDir* watch_dirs = 0;
+
+// Owned by the main thread
+size_t watch_roots_synced = 0;
+char** watch_backlog = 0;
+size_t watch_backlog_position = 0;
+double watch_overrun = 0; // seconds the last frames went past their budget
+
+double watch_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+char* watch_strdup(const char* str) {
+    char* copy = malloc(strlen(str)+1);
+    memcpy(copy, str, strlen(str)+1);
+    return copy;
+}
+
+char* watch_join(const char* dir, const char* name) {
+    char* path = malloc(strlen(dir) + strlen(name) + 2);
+#ifdef _WIN32
+    sprintf(path, "%s\\%s", dir, name);
+#else
+    sprintf(path, "%s/%s", dir, name);
+#endif
+    return path;
+}
+
+bool watch_path_in(const char* path, const char* root) {
+    size_t length = strlen(root);
+    if (strncmp(path, root, length) != 0) return false;
+    if (length > 0 && (root[length-1] == '/' || root[length-1] == '\\')) return true;
+    return path[length] == '/' || path[length] == '\\' || path[length] == 0;
+}
+
+void watch_enqueue(const char* path) {
+    size_t index = 0;
+    if (ht_get(&watch_pending_index, path, &index)) {
+        watch_pending[index].time = watch_now();
+        return;
+    }
+    WatchPending pending = {.path = watch_strdup(path), .time = watch_now()};
+    da_push(watch_pending, pending);
+    ht_set(&watch_pending_index, pending.path, da_length(watch_pending)-1);
+}
+
+void watch_forget_file(size_t index) {
+    WatchFile file = watch_files[index];
+    ht_remove(&watch_files_index, file.path);
+    size_t last = da_length(watch_files)-1;
+    if (index != last) {
+        watch_files[index] = watch_files[last];
+        ht_set(&watch_files_index, watch_files[index].path, index);
+    }
+    da_pop(watch_files, NULL);
+    free(file.path);
+}
+
+// Compare a path against the snapshot and report it if it changed
+void watch_check_file(const char* path) {
+    size_t index = 0;
+    bool known = ht_get(&watch_files_index, path, &index);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (!known) return;
+        watch_forget_file(index);
+        watch_enqueue(path);
+        return;
+    }
+    if (!known) {
+        WatchFile file = {.path = watch_strdup(path)};
+        da_push(watch_files, file);
+        index = da_length(watch_files)-1;
+        ht_set(&watch_files_index, file.path, index);
+    }
+    WatchFile* file = &watch_files[index];
+    file->generation = watch_generation;
+    if (known && file->size == (uint64_t) st.st_size && file->mtime == st.st_mtime && file->inode == (uint64_t) st.st_ino) return;
+    file->size = st.st_size;
+    file->mtime = st.st_mtime;
+    file->inode = st.st_ino;
+    watch_enqueue(path);
+}
+
+// Everything that used to live under a removed or moved away directory
+void watch_forget_tree(const char* path) {
+    for (size_t i = da_length(watch_files); i > 0; i--) {
+        if (!watch_path_in(watch_files[i-1].path, path)) continue;
+        watch_enqueue(watch_files[i-1].path);
+        watch_forget_file(i-1);
+    }
+}
+
+#ifdef __linux__
+#define WATCH_EVENTS (IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE | IN_ONLYDIR)
+
+void watch_add_dir(const char* path) {
+    if (watch_polling) return;
+    int wd = inotify_add_watch(watch_inotify, path, WATCH_EVENTS);
+    if (wd < 0) {
+        if (errno != ENOSPC && errno != ENOMEM) return;
+        library_log("Out of inotify watches, falling back to polling");
+        close(watch_inotify);
+        watch_inotify = -1;
+        watch_polling = true;
+        return;
+    }
+    for (size_t i = 0; i < da_length(watch_dirs); i++) {
+        if (watch_dirs[i].wd == wd) return; // already watched
+    }
+    WatchDir dir = {.wd = wd, .path = watch_strdup(path)};
+    da_push(watch_dirs, dir);
+}
+
+void watch_drop_dirs(const char* path, int wd) {
+    for (size_t i = da_length(watch_dirs); i > 0; i--) {
+        WatchDir dir = watch_dirs[i-1];
+        if (path != NULL ? !watch_path_in(dir.path, path) : dir.wd != wd) continue;
+        if (path != NULL) inotify_rm_watch(watch_inotify, dir.wd);
+        free(dir.path);
+        watch_dirs[i-1] = watch_dirs[da_length(watch_dirs)-1];
+        da_pop(watch_dirs, NULL);
+    }
+}
+#else
+void watch_add_dir(const char* path) { (void) path; }
+#endif
+
+void watch_walk(const char* path) {
+    library_walk(path, watch_check_file, watch_add_dir);
+}
+
+void watch_walk_all() {
+    watch_generation++;
+    for (size_t i = 0; i < da_length(watch_roots); i++) watch_walk(watch_roots[i]);
+    // Anything that was not seen is either gone or outside of the roots
+    for (size_t i = da_length(watch_files); i > 0; i--) {
+        if (watch_files[i-1].generation == watch_generation) continue;
+        char* path = watch_strdup(watch_files[i-1].path);
+        watch_check_file(path);
+        free(path);
+    }
+}
+
+#ifdef __linux__
+void watch_read_events() {
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(watch_inotify, buffer, sizeof(buffer))) > 0) {
+        for (char* ptr = buffer; ptr < buffer + length; ptr += sizeof(struct inotify_event) + ((struct inotify_event*) ptr)->len) {
+            struct inotify_event* event = (struct inotify_event*) ptr;
+            if (event->mask & IN_Q_OVERFLOW) { watch_walk_all(); continue; }
+            if (event->mask & IN_IGNORED) { watch_drop_dirs(NULL, event->wd); continue; }
+            if (event->len == 0) continue;
+            char* dir = NULL;
+            for (size_t i = 0; i < da_length(watch_dirs); i++) {
+                if (watch_dirs[i].wd == event->wd) { dir = watch_dirs[i].path; break; }
+            }
+            if (dir == NULL) continue;
+            char* path = watch_join(dir, event->name);
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) watch_walk(path);
+                else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                    watch_forget_tree(path);
+                    watch_drop_dirs(path, -1);
+                }
+            } else if (library_is_mp3(event->name)) watch_check_file(path);
+            free(path);
+            if (watch_polling) return; // ran out of watches while handling this batch
+        }
+    }
+}
+#endif
+
+// Move paths that stopped changing over to the main thread
+void watch_flush(bool force) {
+    double now = watch_now();
+    pthread_mutex_lock(&watch_lock);
+    for (size_t i = da_length(watch_pending); i > 0; i--) {
+        WatchPending pending = watch_pending[i-1];
+        if (!force && now - pending.time < WATCH_SETTLE_TIME) continue;
+        ht_remove(&watch_pending_index, pending.path);
+        da_push(watch_ready, pending.path);
+        size_t last = da_length(watch_pending)-1;
+        if (i-1 != last) {
+            watch_pending[i-1] = watch_pending[last];
+            ht_set(&watch_pending_index, watch_pending[i-1].path, i-1);
+        }
+        da_pop(watch_pending, NULL);
+    }
+    pthread_mutex_unlock(&watch_lock);
+}
+
+void* watch_main(void* arg) {
+    (void) arg;
+    double last_walk = -WATCH_POLL_INTERVAL;
+    while (true) {
+        pthread_mutex_lock(&watch_lock);
+        bool quit = watch_quit;
+        size_t first_new = da_length(watch_roots);
+        while (da_length(watch_roots_new) != 0) {
+            char* root = NULL;
+            da_pop(watch_roots_new, &root);
+            da_push(watch_roots, root);
+        }
+        pthread_mutex_unlock(&watch_lock);
+        if (quit) break;
+
+        if (watch_polling) {
+            if (watch_now() - last_walk >= WATCH_POLL_INTERVAL) {
+                watch_walk_all();
+                last_walk = watch_now();
+            } else {
+                watch_generation++;
+                for (size_t i = first_new; i < da_length(watch_roots); i++) watch_walk(watch_roots[i]);
+            }
+            watch_flush(true);
+            struct timespec ts = {0, 100 * 1000 * 1000};
+            nanosleep(&ts, NULL);
+            continue;
+        }
+
+#ifdef __linux__
+        // First pass over a root both sets up the watches and catches
+        // whatever changed while mus was not running
+        if (first_new != da_length(watch_roots)) {
+            if (first_new == 0) watch_walk_all();
+            else {
+                watch_generation++;
+                for (size_t i = first_new; i < da_length(watch_roots); i++) watch_walk(watch_roots[i]);
+            }
+        }
+        struct pollfd pfd = {.fd = watch_inotify, .events = POLLIN};
+        if (!watch_polling && poll(&pfd, 1, 100) > 0) watch_read_events();
+        watch_flush(false);
+        if (watch_polling) last_walk = -WATCH_POLL_INTERVAL; // fell back, walk everything right away
+#endif
+    }
+    return NULL;
+}
+
+void watch_start() {
+    watch_roots = da_new(char*);
+    watch_roots_new = da_new(char*);
+    watch_ready = da_new(char*);
+    watch_backlog = da_new(char*);
+    watch_files = da_new(WatchFile);
+    watch_files_index = ht_new();
+    watch_pending = da_new(WatchPending);
+    watch_pending_index = ht_new();
+    watch_dirs = da_new(WatchDir);
+
+    // Start from what the library already knows, so only real changes get reported
+    for (size_t i = 0; i < da_length(library_files); i++) {
+        LibraryFile lf = library_files[i];
+        WatchFile file = {.path = watch_strdup(lf.path), .size = lf.size, .mtime = lf.mtime, .inode = lf.inode};
+        da_push(watch_files, file);
+        ht_set(&watch_files_index, file.path, da_length(watch_files)-1);
+    }
+
+#ifdef __linux__
+    watch_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watch_polling = watch_inotify < 0;
+#endif
+
+    watch_running = pthread_create(&watch_thread, NULL, watch_main, NULL) == 0;
+}
+
+void watch_stop() {
+    if (!watch_running) return;
+    pthread_mutex_lock(&watch_lock);
+    watch_quit = true;
+    pthread_mutex_unlock(&watch_lock);
+    pthread_join(watch_thread, NULL);
+    watch_running = false;
+
+#ifdef __linux__
+    if (watch_inotify >= 0) close(watch_inotify);
+    for (size_t i = 0; i < da_length(watch_dirs); i++) free(watch_dirs[i].path);
+#endif
+    for (size_t i = 0; i < da_length(watch_files); i++) free(watch_files[i].path);
+    for (size_t i = 0; i < da_length(watch_pending); i++) free(watch_pending[i].path);
+    for (size_t i = 0; i < da_length(watch_roots); i++) free(watch_roots[i]);
+    for (size_t i = 0; i < da_length(watch_roots_new); i++) free(watch_roots_new[i]);
+    for (size_t i = 0; i < da_length(watch_ready); i++) free(watch_ready[i]);
+    for (size_t i = watch_backlog_position; i < da_length(watch_backlog); i++) free(watch_backlog[i]);
+    da_free(watch_dirs);
+    da_free(watch_files);
+    da_free(watch_pending);
+    da_free(watch_roots);
+    da_free(watch_roots_new);
+    da_free(watch_ready);
+    da_free(watch_backlog);
+    ht_free(&watch_files_index);
+    ht_free(&watch_pending_index);
+}
+
+void watch_update() {
+    if (!watch_running) return;
+
+    // A stat and a parse cannot be cut short, so what one that ran long took
+    // past the budget is taken from the budget of the next frames
+    double budget = WATCH_FRAME_BUDGET - watch_overrun;
+    double start = watch_now();
+    pthread_mutex_lock(&watch_lock);
+    while (watch_roots_synced < da_length(library_roots)) da_push(watch_roots_new, watch_strdup(library_roots[watch_roots_synced++]));
+    for (size_t i = 0; i < da_length(watch_ready); i++) da_push(watch_backlog, watch_ready[i]);
+    _da_set(watch_ready, DA_LENGTH, 0);
+    pthread_mutex_unlock(&watch_lock);
+
+    while (watch_backlog_position < da_length(watch_backlog) && watch_now() - start < budget) {
+        char* path = watch_backlog[watch_backlog_position++];
+        library_update_file(get_path(norm_text(path)));
+        free(path);
+    }
+    double spent = watch_now() - start;
+    watch_overrun = spent > budget ? spent - budget : 0;
+    if (watch_backlog_position == da_length(watch_backlog)) {
+        _da_set(watch_backlog, DA_LENGTH, 0);
+        watch_backlog_position = 0;
+    }
+}
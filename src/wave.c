@@ -0,0 +1,301 @@
+// Waveform overviews.
+// The seek bar shows the loudness of the whole track, so the track is decoded
+// once more from start to end on a thread of its own (see pcm.c), and every
+// stretch of it is reduced to a peak and an RMS byte. WAVE_BUCKETS of those
+// pairs are 4 KB per track, kept on disk under the file's path and
+// fingerprint, so after the first play a track's overview is a single small
+// read. The worker only ever works on the latest request:
+// skipping through the playlist drops the tracks that are no longer playing.
+
+#include <pthread.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "library.h"
+
+#define WAVE_MAGIC "MUSW"
+#define WAVE_CHUNK 4096 // frames decoded at once
+
+char* wave_dir = WAVES_PATH;
+
+pthread_t wave_thread;
+bool wave_running = false;
+pthread_mutex_t wave_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t wave_wake = PTHREAD_COND_INITIALIZER;
+
+// Shared between threads, guarded by wave_lock
+bool wave_quit = false;
+char* wave_wanted = NULL;      // next track to make an overview of
+uint32_t wave_generation = 0;  // bumped by every request, older work is dropped
+char* wave_done_path = NULL;   // finished overview, waiting for the main thread
+unsigned char* wave_done = NULL;
+
+// Owned by the main thread
+char* wave_shown_path = NULL;
+unsigned char* wave_shown = NULL;
+
+char* wave_strdup(const char* str) {
+    char* copy = malloc(strlen(str)+1);
+    memcpy(copy, str, strlen(str)+1);
+    return copy;
+}
+
+// Tracks are cached by path and fingerprint, a rewritten file gets a new overview
+bool wave_path(char* out, size_t out_size, char* path) {
+    uint64_t key = library_file_key(path);
+    if (key == 0) return false;
+    snprintf(out, out_size, "%s/%016llx.wave", wave_dir, (unsigned long long) key);
+    return true;
+}
+
+unsigned char* wave_read(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return NULL;
+    char magic[4] = {0};
+    uint32_t buckets = 0;
+    unsigned char* wave = NULL;
+    if (fread(magic, 1, 4, f) == 4 && memcmp(magic, WAVE_MAGIC, 4) == 0 &&
+        fread(&buckets, sizeof(buckets), 1, f) == 1 && buckets == WAVE_BUCKETS) {
+        wave = malloc(WAVE_BUCKETS*2);
+        if (fread(wave, 1, WAVE_BUCKETS*2, f) != WAVE_BUCKETS*2) { free(wave); wave = NULL; }
+    }
+    fclose(f);
+    return wave;
+}
+
+// Written under a temporary name and renamed, like the thumbnails
+void wave_write(const char* path, unsigned char* wave) {
+#ifdef _WIN32
+    mkdir(wave_dir);
+#else
+    mkdir(wave_dir, 0755);
+#endif
+    char temp[1040];
+    snprintf(temp, sizeof(temp), "%s.tmp", path);
+    FILE* f = fopen(temp, "wb");
+    if (f == NULL) return;
+    uint32_t buckets = WAVE_BUCKETS;
+    bool ok = fwrite(WAVE_MAGIC, 1, 4, f) == 4 && fwrite(&buckets, sizeof(buckets), 1, f) == 1 &&
+              fwrite(wave, 1, WAVE_BUCKETS*2, f) == WAVE_BUCKETS*2;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(temp, path) != 0) remove(temp);
+}
+
+// Largest magnitude and sum of squares of count samples, added to peak and sum
+void wave_reduce(const float* samples, size_t count, float* peak, float* sum) {
+    float p = *peak, s = 0;
+    size_t i = 0;
+#if defined(__SSE2__)
+    __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 vp = _mm_set1_ps(p), vs = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(samples + i);
+        vp = _mm_max_ps(vp, _mm_and_ps(x, magnitude));
+        vs = _mm_add_ps(vs, _mm_mul_ps(x, x));
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, vp);
+    p = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+    _mm_storeu_ps(lanes, vs);
+    s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__ARM_NEON)
+    float32x4_t vp = vdupq_n_f32(p), vs = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(samples + i);
+        vp = vmaxq_f32(vp, vabsq_f32(x));
+        vs = vmlaq_f32(vs, x, x);
+    }
+    float lanes[4];
+    vst1q_f32(lanes, vp);
+    p = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+    vst1q_f32(lanes, vs);
+    s = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+    for (; i < count; i++) {
+        float x = samples[i];
+        if (fabsf(x) > p) p = fabsf(x);
+        s += x*x;
+    }
+    *peak = p;
+    *sum += s;
+}
+
+unsigned char wave_byte(float x) {
+    return x >= 1 ? 255 : (unsigned char) (x*255 + 0.5f);
+}
+
+bool wave_cancelled(uint32_t generation) {
+    if (generation == 0) return false;
+    pthread_mutex_lock(&wave_lock);
+    bool cancelled = wave_quit || generation != wave_generation;
+    pthread_mutex_unlock(&wave_lock);
+    return cancelled;
+}
+
+// Bucket b covers frames [b*frames/WAVE_BUCKETS, (b+1)*frames/WAVE_BUCKETS),
+// every channel of them. Gives up once the request of the given generation
+// is replaced, generation 0 never is.
+unsigned char* wave_decode(char* path, uint32_t generation) {
+    Pcm pcm;
+    if (!pcm_open(&pcm, path)) return NULL;
+    uint64_t frames = pcm_frame_count(&pcm);
+    uint32_t channels = pcm.channels;
+    if (frames == 0) {
+        pcm_close(&pcm);
+        return NULL;
+    }
+
+    unsigned char* wave = calloc(WAVE_BUCKETS, 2);
+    float* chunk = malloc(WAVE_CHUNK*channels*sizeof(float));
+    uint64_t frame = 0;
+    size_t bucket = 0, chunks = 0;
+    uint64_t bucket_end = frames/WAVE_BUCKETS;
+    float peak = 0, sum = 0;
+    uint64_t bucket_samples = 0;
+    bool cancelled = false;
+    while (bucket < WAVE_BUCKETS) {
+        if (++chunks % 16 == 0 && wave_cancelled(generation)) { cancelled = true; break; }
+        uint64_t read = pcm_read(&pcm, chunk, WAVE_CHUNK);
+        if (read == 0) break;
+        uint64_t done = 0;
+        while (done < read && bucket < WAVE_BUCKETS) {
+            uint64_t take = bucket_end - frame;
+            if (take > read - done) take = read - done;
+            wave_reduce(chunk + done*channels, take*channels, &peak, &sum);
+            bucket_samples += take*channels;
+            frame += take;
+            done += take;
+            while (frame >= bucket_end && bucket < WAVE_BUCKETS) {
+                wave[bucket*2] = wave_byte(peak);
+                wave[bucket*2 + 1] = bucket_samples ? wave_byte(sqrtf(sum/bucket_samples)) : 0;
+                peak = sum = 0;
+                bucket_samples = 0;
+                bucket++;
+                bucket_end = (bucket + 1)*frames/WAVE_BUCKETS;
+            }
+        }
+    }
+    if (!cancelled && bucket < WAVE_BUCKETS && bucket_samples > 0) { // the frame count was an estimate
+        wave[bucket*2] = wave_byte(peak);
+        wave[bucket*2 + 1] = wave_byte(sqrtf(sum/bucket_samples));
+    }
+    free(chunk);
+    pcm_close(&pcm);
+    if (cancelled) { free(wave); return NULL; }
+    return wave;
+}
+
+unsigned char* wave_compute(char* path) {
+    return wave_decode(path, 0);
+}
+
+unsigned char* wave_load(char* path, uint32_t generation) {
+    char cache[1024];
+    bool cached = wave_path(cache, sizeof(cache), path);
+    unsigned char* wave = cached ? wave_read(cache) : NULL;
+    if (wave != NULL) return wave;
+    wave = wave_decode(path, generation);
+    if (wave != NULL && cached) wave_write(cache, wave);
+    return wave;
+}
+
+unsigned char* wave_get(char* path) {
+    return wave_load(path, 0);
+}
+
+void* wave_main(void* arg) {
+    (void) arg;
+#ifdef __linux__
+    // Linux takes a thread id here, so only this thread yields to the audio and the UI
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 10);
+#endif
+    while (true) {
+        pthread_mutex_lock(&wave_lock);
+        while (!wave_quit && wave_wanted == NULL) pthread_cond_wait(&wave_wake, &wave_lock);
+        if (wave_quit) {
+            pthread_mutex_unlock(&wave_lock);
+            break;
+        }
+        char* path = wave_wanted;
+        uint32_t generation = wave_generation;
+        wave_wanted = NULL;
+        pthread_mutex_unlock(&wave_lock);
+
+        unsigned char* wave = wave_load(path, generation);
+
+        pthread_mutex_lock(&wave_lock);
+        if (wave != NULL && generation == wave_generation) {
+            free(wave_done_path);
+            free(wave_done);
+            wave_done_path = path;
+            wave_done = wave;
+        } else {
+            free(path);
+            free(wave);
+        }
+        pthread_mutex_unlock(&wave_lock);
+    }
+    return NULL;
+}
+
+void wave_start() {
+    wave_running = pthread_create(&wave_thread, NULL, wave_main, NULL) == 0;
+}
+
+void wave_stop() {
+    if (wave_running) {
+        pthread_mutex_lock(&wave_lock);
+        wave_quit = true;
+        pthread_cond_broadcast(&wave_wake);
+        pthread_mutex_unlock(&wave_lock);
+        pthread_join(wave_thread, NULL);
+        wave_running = false;
+    }
+    free(wave_wanted);
+    free(wave_done_path);
+    free(wave_done);
+    free(wave_shown_path);
+    free(wave_shown);
+    wave_wanted = wave_done_path = wave_shown_path = NULL;
+    wave_done = wave_shown = NULL;
+}
+
+void wave_request(char* path) {
+    if (!wave_running) return;
+    pthread_mutex_lock(&wave_lock);
+    free(wave_wanted);
+    wave_wanted = wave_strdup(path);
+    wave_generation++;
+    if (wave_generation == 0) wave_generation++;
+    pthread_cond_signal(&wave_wake);
+    pthread_mutex_unlock(&wave_lock);
+}
+
+// Only takes the lock until the overview of path has arrived
+unsigned char* wave_overview(const char* path) {
+    if (wave_shown_path != NULL && strcmp(wave_shown_path, path) == 0) return wave_shown;
+    pthread_mutex_lock(&wave_lock);
+    if (wave_done != NULL) {
+        free(wave_shown_path);
+        free(wave_shown);
+        wave_shown_path = wave_done_path;
+        wave_shown = wave_done;
+        wave_done_path = NULL;
+        wave_done = NULL;
+    }
+    pthread_mutex_unlock(&wave_lock);
+    if (wave_shown_path != NULL && strcmp(wave_shown_path, path) == 0) return wave_shown;
+    return NULL;
+}